@@ -15,4 +15,14 @@
 
 #define NFFT_INC_DIR "@NFFT_INC_DIR@"
 
+/* Whether or not OpenMP is used for on-node parallelism */
+#cmakedefine RTLPSMRI_HAVE_OPENMP
+
+/* Whether or not FFTW's single-precision interface is available */
+#cmakedefine RTLPSMRI_HAVE_FFTWF
+
+/* Whether or not MPI-3 (non-blocking collectives and one-sided 
+   communication) is available */
+#cmakedefine RTLPSMRI_HAVE_MPI3
+
 #endif /* RTLPSMRI_CONFIG_H */
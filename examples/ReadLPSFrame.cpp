@@ -0,0 +1,81 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "rt-lps-mri.hpp"
+using namespace mri;
+using std::string;
+
+// Reconstructs a single frame of L and S from a file written with 
+// WriteLPSCompressed (e.g., by Reconstruct with --output=2)
+int 
+main( int argc, char* argv[] )
+{
+    Initialize( argc, argv );
+    mpi::Comm comm = mpi::COMM_WORLD;
+    const Int commRank = mpi::Rank( comm );
+
+    try
+    {
+        const string filename = 
+            Input("--file","compressed L+S file",string("LPSC-0-tv.bin"));
+        const int t = Input("--t","frame to reconstruct",0);
+        const bool display = Input("--display","display the frame?",false);
+        const bool write = Input("--write","write the frame?",true);
+#ifdef HAVE_QT5
+        const int formatInt = Input("--format","format to store matrices",7);
+#else
+        const int formatInt = Input("--format","format to store matrices",1);
+#endif
+        ProcessInput();
+        PrintInputReport();
+
+        if( formatInt < 1 || formatInt >= FileFormat_MAX )
+            LogicError("Format integer must be in [1,",FileFormat_MAX,")");
+        const auto format = static_cast<El::FileFormat>(formatInt);
+
+        if( commRank == 0 )
+        {
+            const auto header = ReadLPSCompressedHeader( filename );
+            std::cout << "Plane " << header.plane << ": " 
+                      << header.N0 << " x " << header.N1 << " x " 
+                      << header.numTimesteps << ", rank(L)=" << header.rank
+                      << ", nnz(TS)=" << header.numNonzeros << std::endl;
+
+            Matrix<Complex<double>> L, S;
+            ReadLPSCompressedFrame( filename, t, L, S );
+            std::ostringstream os;
+            os << "-" << header.plane << ( header.tv ? "-tv-" : "-temporal-" )
+               << t;
+            if( display )
+            {
+                Display( L, "L"+os.str() );
+                Display( S, "S"+os.str() );
+            }
+            if( write )
+            {
+                Write( L, "L"+os.str(), format );
+                Write( S, "S"+os.str(), format );
+            }
+        }
+    }
+    catch( std::exception& e ) { ReportException(e); }
+
+    Finalize();
+    return 0;
+}
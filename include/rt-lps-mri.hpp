@@ -28,24 +28,50 @@
 
 #include "rt-lps-mri/config.h"
 
+#ifdef RTLPSMRI_HAVE_OPENMP
+# include <omp.h>
+#endif
+
+// Request vectorization of a loop (when OpenMP 4 is available)
+#if defined(RTLPSMRI_HAVE_OPENMP) && defined(_OPENMP) && _OPENMP >= 201307
+# define RTLPSMRI_SIMD _Pragma("omp simd")
+#else
+# define RTLPSMRI_SIMD
+#endif
+
 // The core of the library
+#include "rt-lps-mri/core/fftw.hpp"
 #include "rt-lps-mri/core/environment_decl.hpp"
 #include "rt-lps-mri/core/environment_impl.hpp"
+#include "rt-lps-mri/core/fused_reduction.hpp"
+#include "rt-lps-mri/core/replicated_eig.hpp"
 #include "rt-lps-mri/core/nfft.hpp"
 #include "rt-lps-mri/core/nft.hpp"
 #include "rt-lps-mri/core/coil_aware_nfft.hpp"
+#include "rt-lps-mri/core/coil_batched_nfft.hpp"
+#include "rt-lps-mri/core/native_nfft.hpp"
 #include "rt-lps-mri/core/coil_aware_nft.hpp"
 #include "rt-lps-mri/core/temporal_fft.hpp"
+#include "rt-lps-mri/core/mpi_io.hpp"
+#include "rt-lps-mri/core/parallel_read.hpp"
 #include "rt-lps-mri/core/load_data.hpp"
 #include "rt-lps-mri/core/load_density.hpp"
 #include "rt-lps-mri/core/load_paths.hpp"
 #include "rt-lps-mri/core/load_sensitivity.hpp"
+#include "rt-lps-mri/core/workspace.hpp"
 
 // Applying the acquisition operator and its adjoint
 #include "rt-lps-mri/acquisition/forward.hpp"
 #include "rt-lps-mri/acquisition/adjoint.hpp"
+#include "rt-lps-mri/acquisition/normal.hpp"
 
+#include "rt-lps-mri/partial_svt.hpp"
 #include "rt-lps-mri/lps.hpp"
+#include "rt-lps-mri/streaming_lps.hpp"
+#include "rt-lps-mri/compressed_lps.hpp"
 #include "rt-lps-mri/write_lps.hpp"
+#include "rt-lps-mri/async_writer.hpp"
+#include "rt-lps-mri/plane_scheduler.hpp"
+#include "rt-lps-mri/plane_prefetcher.hpp"
 
 #endif // ifndef RTLPSMRI_HPP
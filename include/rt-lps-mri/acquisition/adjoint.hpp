@@ -28,10 +28,86 @@ namespace mri {
 
 namespace acquisition {
 
+// Apply the adjoint of the type of local NFFT selected via SetNFFTType
 inline void
-ScaleByDensities
+AdjointNFFT
+( const DistMatrix<Complex<double>,STAR,VR>& F,
+        DistMatrix<Complex<double>,STAR,VR>& FHat )
+{
+    DEBUG_ONLY(CallStackEntry cse("acquisition::AdjointNFFT"))
+    switch( GetNFFTType() )
+    {
+    case COIL_BATCHED_NFFT: CoilBatchedAdjointNFFT2D( F, FHat ); break;
+    case NATIVE_NFFT:       NativeAdjointNFFT2D( F, FHat ); break;
+    default:                CoilAwareAdjointNFFT2D( F, FHat );
+    }
+}
+
+// Only the native engine runs in single precision; the NFFT3 paths convert
+// to and from double precision
+template<typename Real>
+inline void
+AdjointNFFT
+( const DistMatrix<Complex<Real>,STAR,VR>& F,
+        DistMatrix<Complex<Real>,STAR,VR>& FHat )
+{
+    DEBUG_ONLY(CallStackEntry cse("acquisition::AdjointNFFT"))
+    if( GetNFFTType() == NATIVE_NFFT )
+    {
+        NativeAdjointNFFT2D( F, FHat );
+    }
+    else
+    {
+        DistMatrix<Complex<double>,STAR,VR> FDouble( F.Grid() ),
+                                            FHatDouble( F.Grid() );
+        Convert( F, FDouble );
+        AdjointNFFT( FDouble, FHatDouble );
+        Convert( FHatDouble, FHat );
+    }
+}
+
+// Apply the adjoint of the selected type of local NFFT to the local columns
+// [jLocBeg,jLocEnd) of F, where FHat has already been sized and aligned with
+// F
+inline void
+AdjointNFFT
 ( const DistMatrix<Complex<double>,STAR,VR>& F,
-        DistMatrix<Complex<double>,STAR,VR>& scaledF )
+        DistMatrix<Complex<double>,STAR,VR>& FHat, int jLocBeg, int jLocEnd )
+{
+    DEBUG_ONLY(CallStackEntry cse("acquisition::AdjointNFFT"))
+    switch( GetNFFTType() )
+    {
+    case COIL_BATCHED_NFFT: 
+        CoilBatchedAdjointNFFT2D( F, FHat, jLocBeg, jLocEnd ); break;
+    case NATIVE_NFFT:       
+        NativeAdjointNFFT2D( F, FHat, jLocBeg, jLocEnd ); break;
+    default:                
+        CoilAwareAdjointNFFT2D( F, FHat, jLocBeg, jLocEnd );
+    }
+}
+
+// Only the native engine can transform a range of single-precision columns
+// in place
+template<typename Real>
+inline void
+AdjointNFFT
+( const DistMatrix<Complex<Real>,STAR,VR>& F,
+        DistMatrix<Complex<Real>,STAR,VR>& FHat, int jLocBeg, int jLocEnd )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("acquisition::AdjointNFFT");
+        if( GetNFFTType() != NATIVE_NFFT )
+            LogicError("Only the native NFFT supports column ranges of this "
+                       "precision");
+    )
+    NativeAdjointNFFT2D( F, FHat, jLocBeg, jLocEnd );
+}
+
+template<typename Real>
+inline void
+ScaleByDensities
+( const DistMatrix<Complex<Real>,STAR,VR>& F,
+        DistMatrix<Complex<Real>,STAR,VR>& scaledF )
 {
     DEBUG_ONLY(CallStackEntry cse("acquisition::ScaleByDensities"))
     const int numCoils = NumCoils();
@@ -45,14 +121,16 @@ ScaleByDensities
         const int j = rowShift + jLoc*rowStride;
         const int time = j / numCoils; // TODO: use mapping jLoc -> time?
         auto fImage = scaledF.Buffer(0,jLoc);
-        const auto density = DensityComp().LockedBuffer(0,time);
+        const auto density = 
+            DensityComp<Real>().LockedBuffer(0,PathOfTimestep(time));
         for( int i=0; i<height; ++i )
             fImage[i] *= density[i];
     }
 }
 
+template<typename Real>
 inline void
-ContractionPrescaling( DistMatrix<Complex<double>,STAR,VR>& FHat )
+ContractionPrescaling( DistMatrix<Complex<Real>,STAR,VR>& FHat )
 {
     DEBUG_ONLY(CallStackEntry cse("acquisition::ContractionPrescaling"))
     const int numCoils = NumCoils();
@@ -60,8 +138,8 @@ ContractionPrescaling( DistMatrix<Complex<double>,STAR,VR>& FHat )
     const int localWidth = FHat.LocalWidth();
     const int rowShift = FHat.RowShift();
     const int rowStride = FHat.RowStride();
-    const auto& sensitivity = Sensitivity();
-    const auto senseScaleCol = SensitivityScalings().LockedBuffer();
+    const auto& sensitivity = Sensitivity<Real>();
+    const auto senseScaleCol = SensitivityScalings<Real>().LockedBuffer();
     for( int jLoc=0; jLoc<localWidth; ++jLoc )
     {
         const int j = rowShift + jLoc*rowStride;
@@ -73,21 +151,22 @@ ContractionPrescaling( DistMatrix<Complex<double>,STAR,VR>& FHat )
     }
 }
 
+template<typename Real>
 inline void
 CoilContraction
-( const DistMatrix<Complex<double>,STAR,VR>& FHat,
-        DistMatrix<Complex<double>,VC,STAR>& images,
+( const DistMatrix<Complex<Real>,STAR,VR>& FHat,
+        DistMatrix<Complex<Real>,VC,STAR>& images,
+        DistMatrix<Complex<Real>,VC,STAR>& FHat_VC_STAR,
   bool progress=false )
 {
     DEBUG_ONLY(CallStackEntry cse("acquisition::CoilContraction"))
-    typedef Complex<double> F;
+    typedef Complex<Real> F;
     const int height = FHat.Height();
     const int numCoils = NumCoils();
-    const int numTimesteps = NumTimesteps();
+    const int numTimesteps = FHat.Width() / numCoils;
 
     El::Timer timer("");
     timer.Start();
-    DistMatrix<Complex<double>,VC,STAR> FHat_VC_STAR( images.Grid() );
     FHat_VC_STAR.AlignWith( images ); 
     FHat_VC_STAR = FHat;
     const double redistTime = timer.Stop();
@@ -112,45 +191,395 @@ CoilContraction
                   << std::endl;
 }
 
+template<typename Real>
+inline void
+CoilContraction
+( const DistMatrix<Complex<Real>,STAR,VR>& FHat,
+        DistMatrix<Complex<Real>,VC,STAR>& images,
+  bool progress=false )
+{
+    DEBUG_ONLY(CallStackEntry cse("acquisition::CoilContraction"))
+    DistMatrix<Complex<Real>,VC,STAR> FHat_VC_STAR( images.Grid() );
+    CoilContraction( FHat, images, FHat_VC_STAR, progress );
+}
+
+// Overwrite columns [kBeg,kEnd) of frames with the sums of the prescaled 
+// local (coil,time) columns of FHat for timesteps myTimesteps[k]
+template<typename Real>
+inline void
+PrescaleAndReduce
+( const DistMatrix<Complex<Real>,STAR,VR>& FHat,
+  const std::vector<int>& myTimesteps, int kBeg, int kEnd,
+        Matrix<Complex<Real>>& frames )
+{
+    DEBUG_ONLY(CallStackEntry cse("acquisition::PrescaleAndReduce"))
+    typedef Complex<Real> F;
+    const int height = FHat.Height();
+    const int numCoils = NumCoils();
+    const int rowShift = FHat.RowShift();
+    const int rowStride = FHat.RowStride();
+    const auto& sensitivity = Sensitivity<Real>();
+    const Real* senseScaleCol = SensitivityScalings<Real>().LockedBuffer();
+    const int numThreads = NumNFFTThreads();
+#ifdef RTLPSMRI_HAVE_OPENMP
+    // Each thread owns the partial image of a set of timesteps
+    #pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+#endif
+    for( int k=kBeg; k<kEnd; ++k )
+    {
+        const int t = myTimesteps[k];
+        F* frame = frames.Buffer(0,k);
+        El::MemZero( frame, height );
+        for( int coil=0; coil<numCoils; ++coil )
+        {
+            const int j = coil + t*numCoils;
+            if( (j-rowShift) % rowStride != 0 )
+                continue;
+            const int jLoc = (j-rowShift) / rowStride;
+            const F* fHat = FHat.LockedBuffer(0,jLoc);
+            const F* senseCol = sensitivity.LockedBuffer(0,coil);
+            for( int i=0; i<height; ++i )
+                frame[i] += fHat[i]*(Conj(senseCol[i])/senseScaleCol[i]);
+        }
+    }
+}
+
+// A fused version of
+//
+//    ContractionPrescaling( FHat ),
+//    CoilContraction( FHat, images ),
+//
+// which leaves FHat unchanged. Each process first sums the prescaled 
+// (coil,time) columns it owns into one partial image per timestep, and the
+// partial images are then exchanged in a reduce-scatter fashion (each 
+// process receives the rows it owns of every partial image and sums them).
+// The communication volume thus scales with the number of timesteps owned by
+// each process rather than with the number of (coil,time) pairs.
+template<typename Real>
+inline void
+PrescaleAndContract
+( const DistMatrix<Complex<Real>,STAR,VR>& FHat,
+        DistMatrix<Complex<Real>,VC,STAR>& images,
+  AcquisitionWorkspace<Real>& work,
+  bool progress=false )
+{
+    DEBUG_ONLY(CallStackEntry cse("acquisition::PrescaleAndContract"))
+    typedef Complex<Real> F;
+    const int height = FHat.Height();
+    const int numTimesteps = FHat.Width() / NumCoils();
+    const El::Grid& g = FHat.Grid();
+    const int commSize = g.Size();
+    const int rowAlign = FHat.RowAlign();
+
+    El::Timer timer("");
+    timer.Start();
+    // Sum the prescaled local columns of each owned timestep
+    const std::vector<int> myTimesteps = 
+        OwnedTimesteps( g.VRRank(), rowAlign, commSize, numTimesteps );
+    const int numMyTimesteps = myTimesteps.size();
+    auto& frames = work.localFrames;
+    frames.Resize( height, numMyTimesteps );
+    PrescaleAndReduce( FHat, myTimesteps, 0, numMyTimesteps, frames );
+    const double reduceTime = timer.Stop();
+
+    timer.Start();
+    // Pack the rows owned by each process of each partial image
+    Zeros( images, height, numTimesteps );
+    const int colAlign = images.ColAlign();
+    const int localHeight = images.LocalHeight();
+    std::vector<int> sendCounts(commSize), sendDispls(commSize);
+    int totalSend = 0;
+    for( int q=0; q<commSize; ++q )
+    {
+        const int qHeight = Length( height, Shift(q,colAlign,commSize), 
+                                    commSize );
+        sendCounts[q] = numMyTimesteps*qHeight;
+        sendDispls[q] = totalSend;
+        totalSend += sendCounts[q];
+    }
+    auto& sendBuf = work.sendBuffers[0];
+    sendBuf.resize( totalSend );
+    for( int q=0; q<commSize; ++q )
+    {
+        const int qShift = Shift( q, colAlign, commSize );
+        const int qHeight = Length( height, qShift, commSize );
+        for( int k=0; k<numMyTimesteps; ++k )
+        {
+            const F* frame = frames.LockedBuffer(0,k);
+            F* sendCol = &sendBuf[sendDispls[q]+k*qHeight];
+            for( int iLoc=0; iLoc<qHeight; ++iLoc )
+                sendCol[iLoc] = frame[qShift+iLoc*commSize];
+        }
+    }
+    std::vector<int> recvCounts(commSize), recvDispls(commSize);
+    std::vector<std::vector<int>> sourceTimesteps(commSize);
+    int totalRecv = 0;
+    for( int q=0; q<commSize; ++q )
+    {
+        sourceTimesteps[q] = 
+            OwnedTimesteps( g.VCToVR(q), rowAlign, commSize, numTimesteps );
+        recvCounts[q] = sourceTimesteps[q].size()*localHeight;
+        recvDispls[q] = totalRecv;
+        totalRecv += recvCounts[q];
+    }
+    auto& recvBuf = work.recvBuffers[0];
+    recvBuf.resize( totalRecv );
+    const double packTime = timer.Stop();
+
+    timer.Start();
+    mpi::AllToAll
+    ( sendBuf.data(), sendCounts.data(), sendDispls.data(),
+      recvBuf.data(), recvCounts.data(), recvDispls.data(), g.VCComm() );
+    const double redistTime = timer.Stop();
+
+    // Sum the received partial images
+    timer.Start();
+    for( int q=0; q<commSize; ++q )
+    {
+        const int numSourceTimesteps = sourceTimesteps[q].size();
+        for( int k=0; k<numSourceTimesteps; ++k )
+            blas::Axpy
+            ( localHeight, F(1), &recvBuf[recvDispls[q]+k*localHeight], 1,
+              images.Buffer(0,sourceTimesteps[q][k]), 1 );
+    }
+    const double sumTime = timer.Stop();
+
+    if( progress && g.Rank() == 0 )
+        std::cout << "      Contract reduce: " << reduceTime << " seconds\n"
+                  << "      Contract pack:   " << packTime << " seconds\n"
+                  << "      Contract redist: " << redistTime << " seconds\n"
+                  << "      Contract sum:    " << sumTime << " seconds"
+                  << std::endl;
+}
+
+#ifdef RTLPSMRI_HAVE_MPI3
+// A pipelined version of the local adjoint NFFTs followed by 
+// PrescaleAndContract. The (coil,time) columns are split into chunks of 
+// consecutive timesteps and, once the partial images of a chunk have been
+// formed, their (non-blocking) exchange proceeds while the next chunk is 
+// transformed. See PipelinedScatterAndNFFT for the caveat on MPI progress.
+template<typename Real>
+inline void
+PipelinedAdjointNFFTAndContract
+( const DistMatrix<Complex<Real>,STAR,VR>& F,
+        DistMatrix<Complex<Real>,VC,STAR>& images,
+  AcquisitionWorkspace<Real>& work,
+  bool progress=false )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("acquisition::PipelinedAdjointNFFTAndContract")
+    )
+    typedef Complex<Real> C;
+    const int height = FirstBandwidth()*SecondBandwidth();
+    const int numCoils = NumCoils();
+    const int numTimesteps = F.Width() / numCoils;
+    const El::Grid& g = F.Grid();
+    const int commSize = g.Size();
+    const int rowAlign = F.RowAlign();
+    const int rowShift = F.RowShift();
+    const int rowStride = F.RowStride();
+    const int numChunks = std::min( NumPipelineChunks(), numTimesteps );
+
+    auto& FHat = work.coilImages_STAR_VR;
+    if( &FHat.Grid() != &g )
+        FHat.SetGrid( g );
+    FHat.AlignWith( F );
+    FHat.Resize( height, F.Width() );
+    Zeros( images, height, numTimesteps );
+    const int colAlign = images.ColAlign();
+    const int localHeight = images.LocalHeight();
+
+    std::vector<std::vector<int>> sourceTimesteps(commSize);
+    std::vector<int> qShifts(commSize), qHeights(commSize);
+    for( int q=0; q<commSize; ++q )
+    {
+        sourceTimesteps[q] = 
+            OwnedTimesteps( g.VCToVR(q), rowAlign, commSize, numTimesteps );
+        qShifts[q] = Shift( q, colAlign, commSize );
+        qHeights[q] = Length( height, qShifts[q], commSize );
+    }
+    const std::vector<int> myTimesteps = 
+        OwnedTimesteps( g.VRRank(), rowAlign, commSize, numTimesteps );
+    auto& frames = work.localFrames;
+    frames.Resize( height, myTimesteps.size() );
+
+    // The indices of a sorted list of timesteps which lie in chunk c
+    auto chunkRange = [&]( const std::vector<int>& ts, int c, int& kBeg, 
+                           int& kEnd )
+    {
+        const int tBeg = ChunkBegin( c, numChunks, numTimesteps );
+        const int tEnd = ChunkBegin( c+1, numChunks, numTimesteps );
+        kBeg = std::lower_bound( ts.begin(), ts.end(), tBeg ) - ts.begin();
+        kEnd = std::lower_bound( ts.begin(), ts.end(), tEnd ) - ts.begin();
+    };
+
+    // Two chunks are in flight at a time, and MPI requires the counts and 
+    // displacements to remain valid until each transfer completes
+    MPI_Request requests[2];
+    std::vector<int> sendCounts[2], sendDispls[2], recvCounts[2], 
+                     recvDispls[2];
+    auto post = [&]( int c )
+    {
+        const int slot = c % 2;
+        sendCounts[slot].resize( commSize );
+        sendDispls[slot].resize( commSize );
+        recvCounts[slot].resize( commSize );
+        recvDispls[slot].resize( commSize );
+        int totalSend=0, totalRecv=0, myBeg, myEnd;
+        chunkRange( myTimesteps, c, myBeg, myEnd );
+        for( int q=0; q<commSize; ++q )
+        {
+            int kBeg, kEnd;
+            chunkRange( sourceTimesteps[q], c, kBeg, kEnd );
+            sendCounts[slot][q] = (myEnd-myBeg)*qHeights[q];
+            sendDispls[slot][q] = totalSend;
+            totalSend += sendCounts[slot][q];
+            recvCounts[slot][q] = (kEnd-kBeg)*localHeight;
+            recvDispls[slot][q] = totalRecv;
+            totalRecv += recvCounts[slot][q];
+        }
+        auto& sendBuf = work.sendBuffers[slot];
+        sendBuf.resize( totalSend );
+        work.recvBuffers[slot].resize( totalRecv );
+        for( int q=0; q<commSize; ++q )
+        {
+            for( int k=myBeg; k<myEnd; ++k )
+            {
+                const C* frame = frames.LockedBuffer(0,k);
+                C* sendCol = 
+                    &sendBuf[sendDispls[slot][q]+(k-myBeg)*qHeights[q]];
+                for( int iLoc=0; iLoc<qHeights[q]; ++iLoc )
+                    sendCol[iLoc] = frame[qShifts[q]+iLoc*commSize];
+            }
+        }
+        MPI_Ialltoallv
+        ( sendBuf.data(), sendCounts[slot].data(), sendDispls[slot].data(),
+          MpiComplexType<Real>(), 
+          work.recvBuffers[slot].data(), recvCounts[slot].data(), 
+          recvDispls[slot].data(), MpiComplexType<Real>(),
+          g.VCComm().comm, &requests[slot] );
+    };
+
+    // Sum the received partial images of chunk c
+    El::Timer timer("");
+    double waitTime=0, computeTime=0;
+    auto finish = [&]( int c )
+    {
+        const int slot = c % 2;
+        timer.Start();
+        MPI_Wait( &requests[slot], MPI_STATUS_IGNORE );
+        waitTime += timer.Stop();
+
+        timer.Start();
+        const auto& recvBuf = work.recvBuffers[slot];
+        for( int q=0; q<commSize; ++q )
+        {
+            int kBeg, kEnd;
+            chunkRange( sourceTimesteps[q], c, kBeg, kEnd );
+            for( int k=kBeg; k<kEnd; ++k )
+                blas::Axpy
+                ( localHeight, C(1), 
+                  &recvBuf[recvDispls[slot][q]+(k-kBeg)*localHeight], 1,
+                  images.Buffer(0,sourceTimesteps[q][k]), 1 );
+        }
+        computeTime += timer.Stop();
+    };
+
+    for( int c=0; c<numChunks; ++c )
+    {
+        // Transform and pre-reduce the local columns of this chunk
+        timer.Start();
+        const int tBeg = ChunkBegin( c, numChunks, numTimesteps );
+        const int tEnd = ChunkBegin( c+1, numChunks, numTimesteps );
+        const int jLocBeg = Length( tBeg*numCoils, rowShift, rowStride );
+        const int jLocEnd = Length( tEnd*numCoils, rowShift, rowStride );
+        AdjointNFFT( F, FHat, jLocBeg, jLocEnd );
+        int myBeg, myEnd;
+        chunkRange( myTimesteps, c, myBeg, myEnd );
+        PrescaleAndReduce( FHat, myTimesteps, myBeg, myEnd, frames );
+        computeTime += timer.Stop();
+
+        post( c );
+        if( c > 0 )
+            finish( c-1 );
+    }
+    finish( numChunks-1 );
+
+    if( progress && g.Rank() == 0 )
+        std::cout << "      Pipeline chunks:  " << numChunks << "\n"
+                  << "      Pipeline waits:   " << waitTime << " seconds\n"
+                  << "      Pipeline compute: " << computeTime << " seconds"
+                  << std::endl;
+}
+#endif // ifdef RTLPSMRI_HAVE_MPI3
+
 } // namespace acquisition
 
+template<typename Real>
 inline void
 AdjointAcquisition
-( const DistMatrix<Complex<double>,STAR,VR>& F, 
-        DistMatrix<Complex<double>,VC,STAR>& images, 
+( const DistMatrix<Complex<Real>,STAR,VR>& F, 
+        DistMatrix<Complex<Real>,VC,STAR>& images, 
+  AcquisitionWorkspace<Real>& work,
   bool progress=false )
 {
     DEBUG_ONLY(CallStackEntry cse("AdjointAcquisition"))
+    work.SetGrid( F.Grid() );
+
     // Pre-scale the k-space data by the coil sensitivities
     El::Timer timer("");
     timer.Start();
-    DistMatrix<Complex<double>,STAR,VR> scaledF( F.Grid() );
+    auto& scaledF = work.kSpace_STAR_VR;
     acquisition::ScaleByDensities( F, scaledF );
     const double scaleTime = timer.Stop();
 
+#ifdef RTLPSMRI_HAVE_MPI3
+    if( acquisition::UsePipeline<Real>() )
+    {
+        timer.Start();
+        acquisition::PipelinedAdjointNFFTAndContract
+        ( scaledF, images, work, progress );
+        const double pipelineTime = timer.Stop();
+        if( progress && F.Grid().Rank() == 0 ) 
+            std::cout << "    scale:                   " << scaleTime 
+                      << " seconds\n"
+                      << "    pipelined NFFT/contract: " << pipelineTime 
+                      << " seconds\n" << std::endl;
+        return;
+    }
+#endif
+
     // Transform each k-space vector into the image domain
     timer.Start();
-    DistMatrix<Complex<double>,STAR,VR> FHat( F.Grid() );
-    CoilAwareAdjointNFFT2D( scaledF, FHat );
+    auto& FHat = work.coilImages_STAR_VR;
+    acquisition::AdjointNFFT( scaledF, FHat );
     const double adjNfftTime = timer.Stop();
 
     // Perform a contraction over the coils with a weighting related to 
     // their sensitivities
     timer.Start();
-    acquisition::ContractionPrescaling( FHat );
-    const double prescaleTime = timer.Stop();
-    timer.Start();
-    acquisition::CoilContraction( FHat, images, progress );
+    acquisition::PrescaleAndContract( FHat, images, work, progress );
     const double contractTime = timer.Stop();
 
     if( progress && F.Grid().Rank() == 0 ) 
         std::cout << "    scale:    " << scaleTime << " seconds\n"
                   << "    adjNFFT:  " << adjNfftTime << " seconds\n"
-                  << "    prescale: " << prescaleTime << " seconds\n"
                   << "    contract: " << contractTime << " seconds\n"
                   << std::endl;
 }
 
+template<typename Real>
+inline void
+AdjointAcquisition
+( const DistMatrix<Complex<Real>,STAR,VR>& F, 
+        DistMatrix<Complex<Real>,VC,STAR>& images, 
+  bool progress=false )
+{
+    DEBUG_ONLY(CallStackEntry cse("AdjointAcquisition"))
+    AcquisitionWorkspace<Real> work( F.Grid() );
+    AdjointAcquisition( F, images, work, progress );
+}
+
 } // namespace mri
 
 #endif // ifndef RTLPSMRI_ACQUISITION_ADJOINT_HPP
@@ -37,23 +37,121 @@ namespace mri {
 
 namespace acquisition {
 
-// TODO: Exploit redundancy in coil data to reduce amount of communication
+// Apply the type of local NFFT selected via SetNFFTType
+inline void
+NFFT
+( const DistMatrix<Complex<double>,STAR,VR>& FHat,
+        DistMatrix<Complex<double>,STAR,VR>& F )
+{
+    DEBUG_ONLY(CallStackEntry cse("acquisition::NFFT"))
+    switch( GetNFFTType() )
+    {
+    case COIL_BATCHED_NFFT: CoilBatchedNFFT2D( FHat, F ); break;
+    case NATIVE_NFFT:       NativeNFFT2D( FHat, F ); break;
+    default:                CoilAwareNFFT2D( FHat, F );
+    }
+}
+
+// Only the native engine runs in single precision; the NFFT3 paths convert
+// to and from double precision
+template<typename Real>
+inline void
+NFFT
+( const DistMatrix<Complex<Real>,STAR,VR>& FHat,
+        DistMatrix<Complex<Real>,STAR,VR>& F )
+{
+    DEBUG_ONLY(CallStackEntry cse("acquisition::NFFT"))
+    if( GetNFFTType() == NATIVE_NFFT )
+    {
+        NativeNFFT2D( FHat, F );
+    }
+    else
+    {
+        DistMatrix<Complex<double>,STAR,VR> FHatDouble( FHat.Grid() ),
+                                            FDouble( FHat.Grid() );
+        Convert( FHat, FHatDouble );
+        NFFT( FHatDouble, FDouble );
+        Convert( FDouble, F );
+    }
+}
+
+// Apply the selected type of local NFFT to the local columns 
+// [jLocBeg,jLocEnd) of FHat, where F has already been sized and aligned with
+// FHat
+inline void
+NFFT
+( const DistMatrix<Complex<double>,STAR,VR>& FHat,
+        DistMatrix<Complex<double>,STAR,VR>& F, int jLocBeg, int jLocEnd )
+{
+    DEBUG_ONLY(CallStackEntry cse("acquisition::NFFT"))
+    switch( GetNFFTType() )
+    {
+    case COIL_BATCHED_NFFT: 
+        CoilBatchedNFFT2D( FHat, F, jLocBeg, jLocEnd ); break;
+    case NATIVE_NFFT:       
+        NativeNFFT2D( FHat, F, jLocBeg, jLocEnd ); break;
+    default:                
+        CoilAwareNFFT2D( FHat, F, jLocBeg, jLocEnd );
+    }
+}
+
+// Only the native engine can transform a range of single-precision columns
+// in place
+template<typename Real>
+inline void
+NFFT
+( const DistMatrix<Complex<Real>,STAR,VR>& FHat,
+        DistMatrix<Complex<Real>,STAR,VR>& F, int jLocBeg, int jLocEnd )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("acquisition::NFFT");
+        if( GetNFFTType() != NATIVE_NFFT )
+            LogicError("Only the native NFFT supports column ranges of this "
+                       "precision");
+    )
+    NativeNFFT2D( FHat, F, jLocBeg, jLocEnd );
+}
+
+// Whether or not the pipelined versions of the acquisition operator and its
+// adjoint should be used
+template<typename Real>
+inline bool
+UsePipeline()
+{
+#ifdef RTLPSMRI_HAVE_MPI3
+    return NumPipelineChunks() > 1 && NumTimesteps() > 1 &&
+           ( GetNFFTType() == NATIVE_NFFT || 
+             std::is_same<Real,double>::value );
+#else
+    return false;
+#endif
+}
+
+// The first timestep of the c'th of numChunks (nearly) equal chunks of the
+// (possibly stacked) timesteps
+inline int
+ChunkBegin( int c, int numChunks, int numTimesteps )
+{ return (c*numTimesteps) / numChunks; }
+
+// Redundantly copy each image into the columns of all of its (coil,time) 
+// pairs and then redistribute. See ScatterAndScale for a version which only 
+// communicates one copy of each image.
+template<typename Real>
 inline void
 Scatter
-( const DistMatrix<Complex<double>,VC,STAR>& images,
-        DistMatrix<Complex<double>,STAR,VR>& scatteredImages,
+( const DistMatrix<Complex<Real>,VC,STAR>& images,
+        DistMatrix<Complex<Real>,STAR,VR>& scatteredImages,
+        DistMatrix<Complex<Real>,VC,STAR>& scatteredImages_VC_STAR,
   bool progress=false )
 {
     DEBUG_ONLY(CallStackEntry cse("acquisition::Scatter"))
     const int height = images.Height();
     const int localHeight = images.LocalHeight();
     const int numCoils = NumCoils();
-    const int numTimesteps = NumTimesteps();
+    const int numTimesteps = images.Width();
 
     El::Timer timer("");
     timer.Start();
-    DistMatrix<Complex<double>,VC,STAR> 
-        scatteredImages_VC_STAR( images.Grid() );
     scatteredImages_VC_STAR.AlignWith( images );
     Zeros( scatteredImages_VC_STAR, height, numCoils*numTimesteps );
     for( int t=0; t<numTimesteps; ++t )
@@ -78,8 +176,22 @@ Scatter
                   << std::endl;
 }
 
+template<typename Real>
 inline void
-ScaleBySensitivities( DistMatrix<Complex<double>,STAR,VR>& scatteredImages )
+Scatter
+( const DistMatrix<Complex<Real>,VC,STAR>& images,
+        DistMatrix<Complex<Real>,STAR,VR>& scatteredImages,
+  bool progress=false )
+{
+    DEBUG_ONLY(CallStackEntry cse("acquisition::Scatter"))
+    DistMatrix<Complex<Real>,VC,STAR> 
+        scatteredImages_VC_STAR( images.Grid() );
+    Scatter( images, scatteredImages, scatteredImages_VC_STAR, progress );
+}
+
+template<typename Real>
+inline void
+ScaleBySensitivities( DistMatrix<Complex<Real>,STAR,VR>& scatteredImages )
 {
     DEBUG_ONLY(CallStackEntry cse("acquisition::ScaleBySensitivities"))
     const int numCoils = NumCoils();
@@ -92,45 +204,389 @@ ScaleBySensitivities( DistMatrix<Complex<double>,STAR,VR>& scatteredImages )
         const int j = rowShift + jLoc*rowStride;
         const int coil = j % numCoils; // TODO: use mapping jLoc -> coil?
         auto image = scatteredImages.Buffer(0,jLoc);
-        const auto senseCol = Sensitivity().LockedBuffer(0,coil);
+        const auto senseCol = Sensitivity<Real>().LockedBuffer(0,coil);
         for( int i=0; i<height; ++i )
             image[i] *= senseCol[i];
     }
 }
 
+// Returns the (sorted) timesteps with at least one (coil,time) column 
+// assigned to the given VR rank of an image x (coil,time) [STAR,VR] matrix
+// with numTimesteps (possibly stacked) timesteps
+inline std::vector<int>
+OwnedTimesteps( int vrRank, int rowAlign, int numProcs, int numTimesteps )
+{
+    const int numCoils = NumCoils();
+    const int width = numCoils*numTimesteps;
+    std::vector<int> timesteps;
+    for( int j=Shift(vrRank,rowAlign,numProcs); j<width; j+=numProcs )
+    {
+        const int t = j / numCoils;
+        if( timesteps.empty() || timesteps.back() != t )
+            timesteps.push_back( t );
+    }
+    return timesteps;
+}
+
+// Fill the local columns [jLocBeg,jLocEnd) of the image x (coil,time) 
+// matrix with the full images of their timesteps (the k'th column of frames 
+// holds timestep myTimesteps[k]) scaled by the sensitivities of their coils
+template<typename Real>
+inline void
+FanOutAndScale
+( const Matrix<Complex<Real>>& frames, const std::vector<int>& myTimesteps,
+  DistMatrix<Complex<Real>,STAR,VR>& scatteredImages, 
+  int jLocBeg, int jLocEnd )
+{
+    DEBUG_ONLY(CallStackEntry cse("acquisition::FanOutAndScale"))
+    typedef Complex<Real> F;
+    const int height = scatteredImages.Height();
+    const int numCoils = NumCoils();
+    const int rowShift = scatteredImages.RowShift();
+    const int rowStride = scatteredImages.RowStride();
+    const int numThreads = NumNFFTThreads();
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp parallel for schedule(static) num_threads(numThreads)
+#endif
+    for( int jLoc=jLocBeg; jLoc<jLocEnd; ++jLoc )
+    {
+        const int j = rowShift + jLoc*rowStride;
+        const int coil = j % numCoils;
+        const int k = 
+            std::lower_bound
+            ( myTimesteps.begin(), myTimesteps.end(), j/numCoils ) - 
+            myTimesteps.begin();
+        const F* frame = frames.LockedBuffer(0,k);
+        const F* senseCol = Sensitivity<Real>().LockedBuffer(0,coil);
+        F* image = scatteredImages.Buffer(0,jLoc);
+        RTLPSMRI_SIMD
+        for( int i=0; i<height; ++i )
+            image[i] = frame[i]*senseCol[i];
+    }
+}
+
+// A fused version of
+//
+//    Scatter( images, scatteredImages ),
+//    ScaleBySensitivities( scatteredImages ),
+//
+// which sends each image (once) to the processes which own any of its
+// (coil,time) columns and then fans the image out to those columns while 
+// scaling by the coil sensitivities. When there are fewer processes than 
+// coils, this reduces the communication volume by a factor of up to 
+// numCoils/numProcs.
+template<typename Real>
+inline void
+ScatterAndScale
+( const DistMatrix<Complex<Real>,VC,STAR>& images,
+        DistMatrix<Complex<Real>,STAR,VR>& scatteredImages,
+  AcquisitionWorkspace<Real>& work,
+  bool progress=false )
+{
+    DEBUG_ONLY(CallStackEntry cse("acquisition::ScatterAndScale"))
+    typedef Complex<Real> F;
+    const int height = images.Height();
+    const int localHeight = images.LocalHeight();
+    const int numCoils = NumCoils();
+    const int numTimesteps = images.Width();
+    const El::Grid& g = images.Grid();
+    const int commSize = g.Size();
+    const int colAlign = images.ColAlign();
+    if( &scatteredImages.Grid() != &g )
+        scatteredImages.SetGrid( g );
+    scatteredImages.Resize( height, numCoils*numTimesteps );
+    const int rowAlign = scatteredImages.RowAlign();
+
+    El::Timer timer("");
+    timer.Start();
+
+    // Pack the local rows of each timestep needed by each process
+    std::vector<int> sendCounts(commSize), sendDispls(commSize);
+    std::vector<std::vector<int>> destTimesteps(commSize);
+    int totalSend = 0;
+    for( int q=0; q<commSize; ++q )
+    {
+        destTimesteps[q] = 
+            OwnedTimesteps( g.VCToVR(q), rowAlign, commSize, numTimesteps );
+        sendCounts[q] = destTimesteps[q].size()*localHeight;
+        sendDispls[q] = totalSend;
+        totalSend += sendCounts[q];
+    }
+    auto& sendBuf = work.sendBuffers[0];
+    sendBuf.resize( totalSend );
+    for( int q=0; q<commSize; ++q )
+    {
+        const int numDestTimesteps = destTimesteps[q].size();
+        for( int k=0; k<numDestTimesteps; ++k )
+            El::MemCopy
+            ( &sendBuf[sendDispls[q]+k*localHeight], 
+              images.LockedBuffer(0,destTimesteps[q][k]), localHeight );
+    }
+    const std::vector<int> myTimesteps = 
+        OwnedTimesteps( g.VRRank(), rowAlign, commSize, numTimesteps );
+    const int numMyTimesteps = myTimesteps.size();
+    std::vector<int> recvCounts(commSize), recvDispls(commSize);
+    int totalRecv = 0;
+    for( int q=0; q<commSize; ++q )
+    {
+        const int qHeight = Length( height, Shift(q,colAlign,commSize), 
+                                    commSize );
+        recvCounts[q] = numMyTimesteps*qHeight;
+        recvDispls[q] = totalRecv;
+        totalRecv += recvCounts[q];
+    }
+    auto& recvBuf = work.recvBuffers[0];
+    recvBuf.resize( totalRecv );
+    const double packTime = timer.Stop();
+
+    timer.Start();
+    mpi::AllToAll
+    ( sendBuf.data(), sendCounts.data(), sendDispls.data(),
+      recvBuf.data(), recvCounts.data(), recvDispls.data(), g.VCComm() );
+    const double redistTime = timer.Stop();
+
+    timer.Start();
+    // Unpack the full images of the needed timesteps
+    auto& frames = work.localFrames;
+    frames.Resize( height, numMyTimesteps );
+    for( int q=0; q<commSize; ++q )
+    {
+        const int qShift = Shift( q, colAlign, commSize );
+        const int qHeight = Length( height, qShift, commSize );
+        for( int k=0; k<numMyTimesteps; ++k )
+        {
+            const F* recvCol = &recvBuf[recvDispls[q]+k*qHeight];
+            F* frame = frames.Buffer(0,k);
+            for( int iLoc=0; iLoc<qHeight; ++iLoc )
+                frame[qShift+iLoc*commSize] = recvCol[iLoc];
+        }
+    }
+
+    // Fan out to the (coil,time) columns while scaling by the sensitivities
+    FanOutAndScale
+    ( frames, myTimesteps, scatteredImages, 0, scatteredImages.LocalWidth() );
+    const double fanOutTime = timer.Stop();
+
+    if( progress && g.Rank() == 0 )
+        std::cout << "      Scatter pack:    " << packTime << " seconds\n"
+                  << "      Scatter redist:  " << redistTime << " seconds\n"
+                  << "      Scatter fan-out: " << fanOutTime << " seconds"
+                  << std::endl;
+}
+
+#ifdef RTLPSMRI_HAVE_MPI3
+// A pipelined version of ScatterAndScale followed by the local NFFTs. The 
+// (coil,time) columns are split into chunks of consecutive timesteps and, 
+// while the (non-blocking) all-to-all of the next chunk is in flight, the 
+// images of the current chunk are fanned out, scaled, and transformed. 
+// Whether or not the transfers actually progress during the NFFTs depends 
+// upon the MPI implementation (e.g., on asynchronous progress threads or 
+// offloading network hardware).
+template<typename Real>
+inline void
+PipelinedScatterAndNFFT
+( const DistMatrix<Complex<Real>,VC,STAR>& images,
+        DistMatrix<Complex<Real>,STAR,VR>& F,
+  AcquisitionWorkspace<Real>& work,
+  bool progress=false )
+{
+    DEBUG_ONLY(CallStackEntry cse("acquisition::PipelinedScatterAndNFFT"))
+    typedef Complex<Real> C;
+    const int height = images.Height();
+    const int localHeight = images.LocalHeight();
+    const int numCoils = NumCoils();
+    const int numTimesteps = images.Width();
+    const int width = numCoils*numTimesteps;
+    const El::Grid& g = images.Grid();
+    const int commSize = g.Size();
+    const int colAlign = images.ColAlign();
+    const int numChunks = std::min( NumPipelineChunks(), numTimesteps );
+
+    auto& scatteredImages = work.coilImages_STAR_VR;
+    if( &scatteredImages.Grid() != &g )
+        scatteredImages.SetGrid( g );
+    scatteredImages.Resize( height, width );
+    F.AlignWith( scatteredImages );
+    F.Resize( NumNonUniformPoints(), width );
+    const int rowAlign = scatteredImages.RowAlign();
+    const int rowShift = scatteredImages.RowShift();
+    const int rowStride = scatteredImages.RowStride();
+
+    std::vector<std::vector<int>> destTimesteps(commSize);
+    std::vector<int> qShifts(commSize), qHeights(commSize);
+    for( int q=0; q<commSize; ++q )
+    {
+        destTimesteps[q] = 
+            OwnedTimesteps( g.VCToVR(q), rowAlign, commSize, numTimesteps );
+        qShifts[q] = Shift( q, colAlign, commSize );
+        qHeights[q] = Length( height, qShifts[q], commSize );
+    }
+    const std::vector<int> myTimesteps = 
+        OwnedTimesteps( g.VRRank(), rowAlign, commSize, numTimesteps );
+    auto& frames = work.localFrames;
+    frames.Resize( height, myTimesteps.size() );
+
+    // The indices of a sorted list of timesteps which lie in chunk c
+    auto chunkRange = [&]( const std::vector<int>& ts, int c, int& kBeg, 
+                           int& kEnd )
+    {
+        const int tBeg = ChunkBegin( c, numChunks, numTimesteps );
+        const int tEnd = ChunkBegin( c+1, numChunks, numTimesteps );
+        kBeg = std::lower_bound( ts.begin(), ts.end(), tBeg ) - ts.begin();
+        kEnd = std::lower_bound( ts.begin(), ts.end(), tEnd ) - ts.begin();
+    };
+
+    // Two chunks are in flight at a time, and MPI requires the counts and 
+    // displacements to remain valid until each transfer completes
+    MPI_Request requests[2];
+    std::vector<int> sendCounts[2], sendDispls[2], recvCounts[2], 
+                     recvDispls[2];
+    auto post = [&]( int c )
+    {
+        const int slot = c % 2;
+        sendCounts[slot].resize( commSize );
+        sendDispls[slot].resize( commSize );
+        recvCounts[slot].resize( commSize );
+        recvDispls[slot].resize( commSize );
+        int totalSend=0, totalRecv=0, myBeg, myEnd;
+        chunkRange( myTimesteps, c, myBeg, myEnd );
+        for( int q=0; q<commSize; ++q )
+        {
+            int kBeg, kEnd;
+            chunkRange( destTimesteps[q], c, kBeg, kEnd );
+            sendCounts[slot][q] = (kEnd-kBeg)*localHeight;
+            sendDispls[slot][q] = totalSend;
+            totalSend += sendCounts[slot][q];
+            recvCounts[slot][q] = (myEnd-myBeg)*qHeights[q];
+            recvDispls[slot][q] = totalRecv;
+            totalRecv += recvCounts[slot][q];
+        }
+        auto& sendBuf = work.sendBuffers[slot];
+        sendBuf.resize( totalSend );
+        work.recvBuffers[slot].resize( totalRecv );
+        for( int q=0; q<commSize; ++q )
+        {
+            int kBeg, kEnd;
+            chunkRange( destTimesteps[q], c, kBeg, kEnd );
+            for( int k=kBeg; k<kEnd; ++k )
+                El::MemCopy
+                ( &sendBuf[sendDispls[slot][q]+(k-kBeg)*localHeight],
+                  images.LockedBuffer(0,destTimesteps[q][k]), localHeight );
+        }
+        MPI_Ialltoallv
+        ( sendBuf.data(), sendCounts[slot].data(), sendDispls[slot].data(),
+          MpiComplexType<Real>(), 
+          work.recvBuffers[slot].data(), recvCounts[slot].data(), 
+          recvDispls[slot].data(), MpiComplexType<Real>(),
+          g.VCComm().comm, &requests[slot] );
+    };
+
+    El::Timer timer("");
+    double waitTime=0, computeTime=0;
+    post( 0 );
+    for( int c=0; c<numChunks; ++c )
+    {
+        const int slot = c % 2;
+        if( c+1 < numChunks )
+            post( c+1 );
+
+        timer.Start();
+        MPI_Wait( &requests[slot], MPI_STATUS_IGNORE );
+        waitTime += timer.Stop();
+
+        timer.Start();
+        // Unpack the full images of the local timesteps of this chunk
+        int myBeg, myEnd;
+        chunkRange( myTimesteps, c, myBeg, myEnd );
+        const auto& recvBuf = work.recvBuffers[slot];
+        for( int q=0; q<commSize; ++q )
+        {
+            for( int k=myBeg; k<myEnd; ++k )
+            {
+                const C* recvCol = 
+                    &recvBuf[recvDispls[slot][q]+(k-myBeg)*qHeights[q]];
+                C* frame = frames.Buffer(0,k);
+                for( int iLoc=0; iLoc<qHeights[q]; ++iLoc )
+                    frame[qShifts[q]+iLoc*commSize] = recvCol[iLoc];
+            }
+        }
+
+        // Fan out, scale, and transform the local columns of this chunk
+        const int tBeg = ChunkBegin( c, numChunks, numTimesteps );
+        const int tEnd = ChunkBegin( c+1, numChunks, numTimesteps );
+        const int jLocBeg = Length( tBeg*numCoils, rowShift, rowStride );
+        const int jLocEnd = Length( tEnd*numCoils, rowShift, rowStride );
+        FanOutAndScale
+        ( frames, myTimesteps, scatteredImages, jLocBeg, jLocEnd );
+        NFFT( scatteredImages, F, jLocBeg, jLocEnd );
+        computeTime += timer.Stop();
+    }
+
+    if( progress && g.Rank() == 0 )
+        std::cout << "      Pipeline chunks:  " << numChunks << "\n"
+                  << "      Pipeline waits:   " << waitTime << " seconds\n"
+                  << "      Pipeline compute: " << computeTime << " seconds"
+                  << std::endl;
+}
+#endif // ifdef RTLPSMRI_HAVE_MPI3
+
 } // namespace acquisition
 
+template<typename Real>
 inline void
 Acquisition
-( const DistMatrix<Complex<double>,VC,STAR>& images,
-        DistMatrix<Complex<double>,STAR,VR>& F,
+( const DistMatrix<Complex<Real>,VC,STAR>& images,
+        DistMatrix<Complex<Real>,STAR,VR>& F,
+  AcquisitionWorkspace<Real>& work,
   bool progress=false )
 {
     DEBUG_ONLY(CallStackEntry cse("Acquisition"))
-    // Redundantly scatter image x time -> image x (coil,time)
+    work.SetGrid( images.Grid() );
+
     El::Timer timer("");
-    timer.Start();
-    DistMatrix<Complex<double>,STAR,VR> scatteredImages( images.Grid() );
-    acquisition::Scatter( images, scatteredImages, progress );
-    const double scatterTime = timer.Stop();
+#ifdef RTLPSMRI_HAVE_MPI3
+    if( acquisition::UsePipeline<Real>() )
+    {
+        timer.Start();
+        acquisition::PipelinedScatterAndNFFT( images, F, work, progress );
+        const double pipelineTime = timer.Stop();
+        if( progress && F.Grid().Rank() == 0 )
+            std::cout << "    pipelined scatter/NFFT: " << pipelineTime 
+                      << " seconds\n" << std::endl;
+        return;
+    }
+#endif
 
-    // Scale by the coil sensitivities
+    // Scatter image x time -> image x (coil,time) and scale by the coil 
+    // sensitivities
     timer.Start();
-    acquisition::ScaleBySensitivities( scatteredImages ); 
-    const double scaleTime = timer.Stop();
+    auto& scatteredImages = work.coilImages_STAR_VR;
+    acquisition::ScatterAndScale( images, scatteredImages, work, progress );
+    const double scatterTime = timer.Stop();
 
     // Finish the transformation
     timer.Start();
-    CoilAwareNFFT2D( scatteredImages, F );
+    acquisition::NFFT( scatteredImages, F );
     const double nfftTime = timer.Stop();
 
     if( progress && F.Grid().Rank() == 0 )
         std::cout << "    scatter: " << scatterTime << " seconds\n"
-                  << "    scale:   " << scaleTime << " seconds\n"
                   << "    NFFT:    " << nfftTime << " seconds\n"
                   << std::endl;
 }
 
+template<typename Real>
+inline void
+Acquisition
+( const DistMatrix<Complex<Real>,VC,STAR>& images,
+        DistMatrix<Complex<Real>,STAR,VR>& F,
+  bool progress=false )
+{
+    DEBUG_ONLY(CallStackEntry cse("Acquisition"))
+    AcquisitionWorkspace<Real> work( images.Grid() );
+    Acquisition( images, F, work, progress );
+}
+
 } // namespace mri
 
 #endif // ifndef RTLPSMRI_ACQUISITION_FORWARD_HPP
@@ -0,0 +1,171 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#ifndef RTLPSMRI_ACQUISITION_NORMAL_HPP
+#define RTLPSMRI_ACQUISITION_NORMAL_HPP
+
+namespace mri {
+
+// Application of the normal operator E'E, where E is the operator applied by
+// Acquisition and E' is the operator applied by AdjointAcquisition. This maps
+// image x time -> image x time
+//
+// Since the trajectory of each timestep is fixed, each frame is mapped by 
+// E'E to the sum over the coils c of 
+//
+//    conj(S_c) / (sum_c |S_c|^2) .* (A_t' W_t A_t)(S_c .* image_t),
+//
+// where A_t' W_t A_t is a Toeplitz operator which is applied via a circulant
+// embedding on a 2*N0 x 2*N1 grid using the kernels precomputed by 
+// InitializeAcquisition (with normalKernels=true). The non-uniform points are
+// therefore never touched, and only the images (rather than every (coil,time)
+// column) need to be redistributed.
+//
+// The embeddings are always applied in double precision, even when the 
+// images are stored in single precision.
+
+template<typename Real>
+inline void
+NormalAcquisition
+( const DistMatrix<Complex<Real>,VC,STAR>& images,
+        DistMatrix<Complex<Real>,VC,STAR>& normalImages,
+  AcquisitionWorkspace<Real>& work,
+  bool progress=false )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("NormalAcquisition");
+        if( !InitializedNormalKernels() )
+            LogicError("Normal kernels were not initialized");
+        if( images.Width() % NumTimesteps() != 0 )
+            LogicError("Invalid number of timesteps");
+        if( images.Height() != FirstBandwidth()*SecondBandwidth() )
+            LogicError("Invalid image height");
+    )
+    typedef Complex<double> C;
+    typedef Complex<Real> CReal;
+    const int N0 = FirstBandwidth();
+    const int N1 = SecondBandwidth();
+    const int height = images.Height();
+    const int numCoils = NumCoils();
+    const int numTimesteps = images.Width();
+
+    work.SetGrid( images.Grid() );
+
+    // Give each process entire frames
+    El::Timer timer("");
+    timer.Start();
+    auto& frames = work.frames_STAR_VR;
+    auto& normalFrames = work.normalFrames_STAR_VR;
+    frames = images;
+    normalFrames.AlignWith( frames );
+    Zeros( normalFrames, height, numTimesteps );
+    double redistTime = timer.Stop();
+
+    timer.Start();
+    const int localWidth = frames.LocalWidth();
+    const int rowShift = frames.RowShift();
+    const int rowStride = frames.RowStride();
+    const int numThreads = NumNFFTThreads();
+    const CReal* framesBuf = frames.LockedBuffer();
+    CReal* normalBuf = normalFrames.Buffer();
+    const int framesLDim = frames.LDim();
+    const int normalLDim = normalFrames.LDim();
+    const auto& sensitivity = Sensitivity();
+    const C* senseBuf = sensitivity.LockedBuffer();
+    const int senseLDim = sensitivity.LDim();
+    const double* senseScaleCol = SensitivityScalings().LockedBuffer();
+    const auto& kernels = NormalKernels();
+    const double* kernelBuf = kernels.LockedBuffer();
+    const int kernelLDim = kernels.LDim();
+    const fftw_plan forward = NormalPlan( FFTW_FORWARD );
+    const fftw_plan backward = NormalPlan( FFTW_BACKWARD );
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+#endif
+    for( int tLoc=0; tLoc<localWidth; ++tLoc )
+    {
+#ifdef RTLPSMRI_HAVE_OPENMP
+        const int thread = omp_get_thread_num();
+#else
+        const int thread = 0;
+#endif
+        const int t = rowShift + tLoc*rowStride;
+        fftw_complex* gridBuf = NormalGrid( thread );
+        C* grid = reinterpret_cast<C*>(gridBuf);
+        const double* kernelHat = &kernelBuf[PathOfTimestep(t)*kernelLDim];
+        const CReal* frame = &framesBuf[tLoc*framesLDim];
+        CReal* normalFrame = &normalBuf[tLoc*normalLDim];
+        for( int c=0; c<numCoils; ++c )
+        {
+            const C* senseCol = &senseBuf[c*senseLDim];
+
+            // Zero-pad the sensitivity-weighted frame onto the 2x grid
+            El::MemZero( grid, 4*N0*N1 );
+            for( int a0=0; a0<N0; ++a0 )
+                for( int a1=0; a1<N1; ++a1 )
+                    grid[a1+a0*2*N1] = 
+                        senseCol[a1+a0*N1]*C(frame[a1+a0*N1]);
+
+            // Apply the circulant embedding
+            fftw_execute_dft( forward, gridBuf, gridBuf );
+            for( int i=0; i<4*N0*N1; ++i )
+                grid[i] *= kernelHat[i];
+            fftw_execute_dft( backward, gridBuf, gridBuf );
+
+            // Truncate and accumulate the weighted contribution of this coil
+            for( int a0=0; a0<N0; ++a0 )
+            {
+                for( int a1=0; a1<N1; ++a1 )
+                {
+                    const int i = a1 + a0*N1;
+                    normalFrame[i] += CReal
+                      ( Conj(senseCol[i])*grid[a1+a0*2*N1]/senseScaleCol[i] );
+                }
+            }
+        }
+    }
+    const double convTime = timer.Stop();
+
+    timer.Start();
+    normalImages.AlignWith( images );
+    normalImages = normalFrames;
+    redistTime += timer.Stop();
+
+    if( progress && images.Grid().Rank() == 0 )
+        std::cout << "    redist:   " << redistTime << " seconds\n"
+                  << "    convolve: " << convTime << " seconds\n"
+                  << std::endl;
+}
+
+template<typename Real>
+inline void
+NormalAcquisition
+( const DistMatrix<Complex<Real>,VC,STAR>& images,
+        DistMatrix<Complex<Real>,VC,STAR>& normalImages,
+  bool progress=false )
+{
+    DEBUG_ONLY(CallStackEntry cse("NormalAcquisition"))
+    AcquisitionWorkspace<Real> work( images.Grid() );
+    NormalAcquisition( images, normalImages, work, progress );
+}
+
+} // namespace mri
+
+#endif // ifndef RTLPSMRI_ACQUISITION_NORMAL_HPP
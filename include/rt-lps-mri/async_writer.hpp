@@ -0,0 +1,206 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#ifndef RTLPSMRI_ASYNCWRITER_HPP
+#define RTLPSMRI_ASYNCWRITER_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace mri {
+
+// Takes the output of the reconstruction off of its critical path. Each 
+// request (in any of the formats of LPSOutputCtrl) snapshots the matrices 
+// to be written into a bounded queue and returns immediately, and a 
+// background thread performs the writes (in order) while the caller moves 
+// on to its next plane. Once maxPending requests are outstanding (including 
+// the one being written), further requests block until there is room, which
+// bounds the memory held by the snapshots.
+//
+// The snapshots live on a grid over a duplicate of the communicator of the
+// grid passed to the constructor, so that the collectives of the writes 
+// cannot be confused with those of the reconstruction, and so MPI must 
+// provide MPI_THREAD_MULTIPLE. The matrices passed in must be distributed 
+// over a grid with the same processes in the same order, and every process
+// must make the same sequence of requests.
+class AsyncWriter
+{
+public:
+    // Collective over the grid
+    AsyncWriter( const Grid& grid, int maxPending=2 )
+    : maxPending_(maxPending), done_(false)
+    {
+        DEBUG_ONLY(CallStackEntry cse("AsyncWriter::AsyncWriter"))
+        if( maxPending < 1 )
+            LogicError("Must allow at least one pending write");
+        MPI_Comm_dup( grid.Comm().comm, &comm_.comm );
+        grid_.reset( new Grid(comm_) );
+        thread_ = std::thread( [this]() { Run(); } );
+    }
+
+    // Finishes the outstanding writes. Since a destructor cannot throw, any
+    // error which was not already rethrown by Flush is only reported, so 
+    // callers should Flush before destruction.
+    ~AsyncWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock( mutex_ );
+            done_ = true;
+        }
+        ready_.notify_all();
+        thread_.join();
+        if( error_ )
+        {
+            try { std::rethrow_exception( error_ ); }
+            catch( std::exception& e ) { ReportException( e ); }
+            catch( ... ) { }
+        }
+        grid_.reset();
+        mpi::Free( comm_ );
+    }
+
+    template<typename Real>
+    void WriteLPS
+    ( const DistMatrix<Complex<Real>,VC,STAR>& L,
+      const DistMatrix<Complex<Real>,VC,STAR>& S,
+      Int N0, Int N1, Int plane, bool tv, const LPSOutputCtrl& ctrl )
+    {
+        DEBUG_ONLY(CallStackEntry cse("AsyncWriter::WriteLPS"))
+        auto LCopy = Snapshot( L );
+        auto SCopy = Snapshot( S );
+        Push
+        ( [=]() { mri::WriteLPS( *LCopy, *SCopy, N0, N1, plane, tv, ctrl ); } );
+    }
+
+    template<typename T,Dist U,Dist V>
+    void Write
+    ( const DistMatrix<T,U,V>& A, std::string basename, FileFormat format )
+    {
+        DEBUG_ONLY(CallStackEntry cse("AsyncWriter::Write"))
+        auto ACopy = Snapshot( A );
+        Push( [=]() { El::Write( *ACopy, basename, format ); } );
+    }
+
+    // Wait for the outstanding writes and rethrow the first error, if any
+    void Flush()
+    {
+        DEBUG_ONLY(CallStackEntry cse("AsyncWriter::Flush"))
+        std::unique_lock<std::mutex> lock( mutex_ );
+        space_.wait( lock, [this]() { return jobs_.empty(); } );
+        RethrowError();
+    }
+
+private:
+    int maxPending_;
+    mpi::Comm comm_;
+    std::unique_ptr<Grid> grid_;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable ready_, space_;
+    // The front job is the one being written
+    std::deque<std::function<void()>> jobs_;
+    bool done_;
+    std::exception_ptr error_;
+
+    // A copy of A over the writer's grid with the same local data
+    template<typename T,Dist U,Dist V>
+    std::shared_ptr<DistMatrix<T,U,V>> Snapshot( const DistMatrix<T,U,V>& A )
+    {
+        DEBUG_ONLY(
+            CallStackEntry cse("AsyncWriter::Snapshot");
+            if( A.Grid().Size() != grid_->Size() )
+                LogicError("Matrix is not over the writer's processes");
+        )
+        std::shared_ptr<DistMatrix<T,U,V>> B
+        ( new DistMatrix<T,U,V>(*grid_) );
+        B->Align( A.ColAlign(), A.RowAlign() );
+        B->Resize( A.Height(), A.Width() );
+        const int localHeight = A.LocalHeight();
+        const int localWidth = A.LocalWidth();
+        for( int jLoc=0; jLoc<localWidth; ++jLoc )
+            El::MemCopy
+            ( B->Buffer(0,jLoc), A.LockedBuffer(0,jLoc), localHeight );
+        return B;
+    }
+
+    // Must be called while holding the mutex
+    void RethrowError()
+    {
+        if( error_ )
+        {
+            std::exception_ptr error = error_;
+            error_ = std::exception_ptr();
+            std::rethrow_exception( error );
+        }
+    }
+
+    void Push( std::function<void()> job )
+    {
+        DEBUG_ONLY(CallStackEntry cse("AsyncWriter::Push"))
+        {
+            std::unique_lock<std::mutex> lock( mutex_ );
+            space_.wait
+            ( lock, [this]() { return int(jobs_.size()) < maxPending_; } );
+            RethrowError();
+            jobs_.push_back( job );
+        }
+        ready_.notify_one();
+    }
+
+    void Run()
+    {
+        while( true )
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock( mutex_ );
+                ready_.wait
+                ( lock, [this]() { return done_ || !jobs_.empty(); } );
+                if( jobs_.empty() )
+                    return;
+                job = jobs_.front();
+            }
+            try { job(); }
+            catch( ... )
+            {
+                std::lock_guard<std::mutex> lock( mutex_ );
+                if( !error_ )
+                    error_ = std::current_exception();
+            }
+            // Release the snapshots before making room in the queue
+            job = std::function<void()>();
+            {
+                std::lock_guard<std::mutex> lock( mutex_ );
+                jobs_.pop_front();
+            }
+            space_.notify_all();
+        }
+    }
+};
+
+} // namespace mri
+
+#endif // ifndef RTLPSMRI_ASYNCWRITER_HPP
@@ -0,0 +1,602 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#ifndef RTLPSMRI_COMPRESSEDLPS_HPP
+#define RTLPSMRI_COMPRESSEDLPS_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace mri {
+
+// A compressed alternative to WriteLPS/WriteLPSContainer which exploits the
+// structure of the L+S decomposition. The file "LPSC-<plane>-tv.bin" (or 
+// "LPSC-<plane>-temporal.bin") consists of
+//
+//  1. an LPSCompressedHeader,
+//  2. numTimesteps+1 64-bit offsets, where frame k of the sparse 
+//     transform of S consists of entries [offsets[k],offsets[k+1]),
+//  3. rank float64 scales, one per column of W,
+//  4. the numTimesteps x rank matrix V (column-major),
+//  5. the N0*N1 x rank matrix W = U Sigma (column-major), so that L = W V',
+//     with each column divided by its scale,
+//  6. the entries of the sparse transform of S, each of which is a 32-bit 
+//     pixel index followed by a value divided by header.SScale.
+//
+// The sparse transform of S is the temporal FFT when the temporal FFT was 
+// the sparsifying transform and is otherwise (for TV) the first frame 
+// followed by the differences between consecutive frames. Entries whose 
+// magnitude is at most dropTol times the largest are dropped. As in 
+// WriteLPSContainer, pixels are indexed in the row order of L and S, i.e., 
+// pixel (i,j) has index j+i*N1. The values (of V, W, and S) are stored as 
+// complex pairs of float64, float32, or float16.
+//
+// The magnitudes of W and S follow the (arbitrary) scale of the k-space 
+// data, so, in order for float16 to neither overflow (past 65504) nor flush
+// to zero (below about 6e-8), each column of W and the entries of S are 
+// divided by the smallest power of two which is at least their largest 
+// magnitude (which is exact in float64 and float32). V has orthonormal 
+// columns and is stored as is.
+//
+// Since TV frames are recovered by summing the differences, the entries 
+// dropped from frames 0 through t all contribute to the error of frame t of
+// S, which can therefore grow with t.
+
+enum LPSValueType
+{
+    LPS_FLOAT64=0,
+    LPS_FLOAT32,
+    LPS_FLOAT16,
+    LPSValueType_MAX
+};
+
+struct LPSCompressedHeader
+{
+    char magic[8];
+    long long version;
+    long long N0, N1, numTimesteps, plane;
+    long long tv;
+    long long rank;
+    long long valueType;
+    long long numNonzeros;
+    // The scale which the stored entries of S were divided by
+    double SScale;
+    // The byte offsets of the sections following the header
+    long long offsetsOffset, WScalesOffset, VOffset, WOffset, entriesOffset;
+};
+
+const char LPS_COMPRESSED_MAGIC[8] = {'R','T','L','P','S','C','M','P'};
+const long long LPS_COMPRESSED_VERSION = 2;
+
+namespace compressed_lps {
+
+// IEEE half precision with round-to-nearest-even
+inline std::uint16_t
+FloatToHalf( float value )
+{
+    std::uint32_t x;
+    std::memcpy( &x, &value, sizeof(float) );
+    const std::uint16_t sign = (x >> 16) & 0x8000;
+    const std::uint32_t absX = x & 0x7fffffff;
+    if( absX >= 0x7f800000 )
+        return sign | 0x7c00 | ( absX > 0x7f800000 ? 0x200 : 0 );
+    // Values of at least 65520 round to infinity
+    if( absX >= 0x477ff000 )
+        return sign | 0x7c00;
+    // Values below 2^-14 become subnormal, in units of 2^-24
+    if( absX < 0x38800000 )
+    {
+        float absValue;
+        std::memcpy( &absValue, &absX, sizeof(float) );
+        return sign | std::uint16_t(std::nearbyint(absValue*16777216.f));
+    }
+    // Rebias the exponent and round away the 13 extra mantissa bits
+    std::uint32_t h = (absX - 0x38000000) >> 13;
+    const std::uint32_t remainder = absX & 0x1fff;
+    if( remainder > 0x1000 || (remainder == 0x1000 && (h & 1)) )
+        ++h;
+    return sign | std::uint16_t(h);
+}
+
+inline float
+HalfToFloat( std::uint16_t h )
+{
+    const bool negative = h & 0x8000;
+    const std::uint32_t exponent = (h >> 10) & 0x1f;
+    const std::uint32_t mantissa = h & 0x3ff;
+    if( exponent == 0 )
+    {
+        const float value = std::ldexp( float(mantissa), -24 );
+        return ( negative ? -value : value );
+    }
+    std::uint32_t x = ( negative ? 0x80000000u : 0u ) | (mantissa << 13);
+    if( exponent == 31 )
+        x |= 0x7f800000;
+    else
+        x |= (exponent+112) << 23;
+    float value;
+    std::memcpy( &value, &x, sizeof(float) );
+    return value;
+}
+
+// The smallest power of two which is at least maxAbs (or one, if maxAbs is 
+// zero), so that dividing by it is exact and leaves magnitudes of at most one
+inline double
+PowerOfTwoScale( double maxAbs )
+{
+    if( maxAbs == 0 )
+        return 1;
+    int exponent;
+    const double mantissa = std::frexp( maxAbs, &exponent );
+    return ( mantissa == 0.5 ? std::ldexp( 1., exponent-1 ) 
+                             : std::ldexp( 1., exponent ) );
+}
+
+// The number of bytes in a stored complex value
+inline int
+ValueSize( LPSValueType type )
+{
+    switch( type )
+    {
+    case LPS_FLOAT64: return 2*sizeof(double);
+    case LPS_FLOAT32: return 2*sizeof(float);
+    default:          return 2*sizeof(std::uint16_t);
+    }
+}
+
+inline void
+Pack( Complex<double> value, LPSValueType type, char* dest )
+{
+    if( type == LPS_FLOAT64 )
+    {
+        const double pair[2] = { value.real(), value.imag() };
+        std::memcpy( dest, pair, sizeof(pair) );
+    }
+    else if( type == LPS_FLOAT32 )
+    {
+        const float pair[2] = { float(value.real()), float(value.imag()) };
+        std::memcpy( dest, pair, sizeof(pair) );
+    }
+    else
+    {
+        const std::uint16_t pair[2] = 
+          { FloatToHalf(float(value.real())), 
+            FloatToHalf(float(value.imag())) };
+        std::memcpy( dest, pair, sizeof(pair) );
+    }
+}
+
+inline Complex<double>
+Unpack( const char* src, LPSValueType type )
+{
+    if( type == LPS_FLOAT64 )
+    {
+        double pair[2];
+        std::memcpy( pair, src, sizeof(pair) );
+        return Complex<double>(pair[0],pair[1]);
+    }
+    else if( type == LPS_FLOAT32 )
+    {
+        float pair[2];
+        std::memcpy( pair, src, sizeof(pair) );
+        return Complex<double>(pair[0],pair[1]);
+    }
+    else
+    {
+        std::uint16_t pair[2];
+        std::memcpy( pair, src, sizeof(pair) );
+        return Complex<double>(HalfToFloat(pair[0]),HalfToFloat(pair[1]));
+    }
+}
+
+} // namespace compressed_lps
+
+template<typename Real>
+inline void
+WriteLPSCompressed
+( const DistMatrix<Complex<Real>,VC,STAR>& L,
+  const DistMatrix<Complex<Real>,VC,STAR>& S,
+  Int N0, Int N1, Int plane,
+  bool tv=true, 
+  LPSValueType valueType=LPS_FLOAT32, double dropTol=1e-6 )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("WriteLPSCompressed");
+        if( L.Height() != N0*N1 || S.Height() != N0*N1 )
+            LogicError("L and S should have N0*N1 rows");
+        if( L.Width() != S.Width() || L.ColAlign() != S.ColAlign() )
+            LogicError("L and S should be the same size and aligned");
+    )
+    typedef Complex<Real> F;
+    using compressed_lps::Pack;
+    const int numTimesteps = L.Width();
+    const int localHeight = L.LocalHeight();
+    const int colShift = L.ColShift();
+    const int colStride = L.ColStride();
+    mpi::Comm comm = L.Grid().VCComm();
+    const int valueSize = compressed_lps::ValueSize( valueType );
+
+    // Factor L = W V' through the eigenvectors of the Gram matrix L'L, which
+    // are computed on the root so that every process forms its rows of W 
+    // against the same V (and with the same rank)
+    Matrix<F> G( numTimesteps, numTimesteps );
+    blas::Gemm
+    ( 'C', 'N', numTimesteps, numTimesteps, localHeight,
+      F(1), L.LockedBuffer(), L.LDim(), L.LockedBuffer(), L.LDim(),
+      F(0), G.Buffer(), G.LDim() );
+    mpi::AllReduce( G.Buffer(), numTimesteps*numTimesteps, comm );
+    Matrix<Real> w;
+    Matrix<F> V;
+    ReplicatedHermitianEig( G, w, V, comm );
+    const int rank = NumericalRank( w );
+    Matrix<F> WLoc( localHeight, rank );
+    blas::Gemm
+    ( 'N', 'N', localHeight, rank, numTimesteps,
+      F(1), L.LockedBuffer(), L.LDim(), V.LockedBuffer(), V.LDim(),
+      F(0), WLoc.Buffer(), WLoc.LDim() );
+    std::vector<double> WScales( rank, 0 );
+    for( int k=0; k<rank; ++k )
+    {
+        const F* wCol = WLoc.LockedBuffer(0,k);
+        for( int iLoc=0; iLoc<localHeight; ++iLoc )
+            WScales[k] = std::max( WScales[k], double(std::abs(wCol[iLoc])) );
+    }
+    if( rank > 0 )
+        mpi::AllReduce( WScales.data(), rank, mpi::MAX, comm );
+    for( int k=0; k<rank; ++k )
+        WScales[k] = compressed_lps::PowerOfTwoScale( WScales[k] );
+
+    // Form the sparse transform of S and drop its negligible entries
+    DistMatrix<F,VC,STAR> T( S );
+    if( tv )
+    {
+        for( int t=numTimesteps-1; t>0; --t )
+        {
+            F* tCol = T.Buffer(0,t);
+            const F* prevCol = S.LockedBuffer(0,t-1);
+            for( int iLoc=0; iLoc<localHeight; ++iLoc )
+                tCol[iLoc] -= prevCol[iLoc];
+        }
+    }
+    else
+        TemporalFFT( T );
+    double maxAbsSq=0, unusedFrobSq=0;
+    lps::LocalNorms( T, unusedFrobSq, maxAbsSq );
+    maxAbsSq = mpi::AllReduce( maxAbsSq, mpi::MAX, comm );
+    const double dropSq = dropTol*dropTol*maxAbsSq;
+    const double SScale = compressed_lps::PowerOfTwoScale( Sqrt(maxAbsSq) );
+
+    // Each frame holds the entries of every process, in rank order
+    std::vector<long long> localCounts( numTimesteps, 0 ), 
+                           prefixCounts( numTimesteps, 0 ),
+                           counts( numTimesteps );
+    for( int t=0; t<numTimesteps; ++t )
+    {
+        const F* tCol = T.LockedBuffer(0,t);
+        for( int iLoc=0; iLoc<localHeight; ++iLoc )
+            if( std::norm(tCol[iLoc]) > dropSq )
+                ++localCounts[t];
+    }
+    MPI_Exscan
+    ( localCounts.data(), prefixCounts.data(), numTimesteps, 
+      MPI_LONG_LONG, MPI_SUM, comm.comm );
+    if( L.Grid().VCRank() == 0 )
+        std::fill( prefixCounts.begin(), prefixCounts.end(), 0 );
+    MPI_Allreduce
+    ( localCounts.data(), counts.data(), numTimesteps, MPI_LONG_LONG, 
+      MPI_SUM, comm.comm );
+    std::vector<long long> offsets( numTimesteps+1, 0 );
+    for( int t=0; t<numTimesteps; ++t )
+        offsets[t+1] = offsets[t] + counts[t];
+
+    const int entrySize = sizeof(std::int32_t) + valueSize;
+    LPSCompressedHeader header;
+    for( int k=0; k<8; ++k )
+        header.magic[k] = LPS_COMPRESSED_MAGIC[k];
+    header.version = LPS_COMPRESSED_VERSION;
+    header.N0 = N0;
+    header.N1 = N1;
+    header.numTimesteps = numTimesteps;
+    header.plane = plane;
+    header.tv = tv;
+    header.rank = rank;
+    header.valueType = valueType;
+    header.numNonzeros = offsets[numTimesteps];
+    header.SScale = SScale;
+    header.offsetsOffset = sizeof(LPSCompressedHeader);
+    header.WScalesOffset = 
+        header.offsetsOffset + (numTimesteps+1)*sizeof(long long);
+    header.VOffset = header.WScalesOffset + (long long)rank*sizeof(double);
+    header.WOffset = header.VOffset + (long long)numTimesteps*rank*valueSize;
+    header.entriesOffset = 
+        header.WOffset + (long long)N0*N1*rank*valueSize;
+    const long long fileSize = 
+        header.entriesOffset + header.numNonzeros*entrySize;
+
+    std::ostringstream os;
+    os << "LPSC-" << plane << ( tv ? "-tv" : "-temporal" ) << ".bin";
+    const std::string filename = os.str();
+    MPI_File fh;
+    const int openError = 
+      MPI_File_open
+      ( comm.comm, const_cast<char*>(filename.c_str()), 
+        MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh );
+    if( openError != MPI_SUCCESS )
+        RuntimeError("Could not open ",filename);
+    // Since the file is extended up front, a failed or short write would 
+    // otherwise leave zero-filled sections of the right length behind, so 
+    // every call is checked (see mpi_io.hpp). The collective calls are made
+    // even after a local failure.
+    bool success = ( MPI_File_set_size( fh, fileSize ) == MPI_SUCCESS );
+
+    // The header, frame offsets, scales of W, and V are written by a single
+    // process
+    MPI_Status status;
+    if( L.Grid().VCRank() == 0 )
+    {
+        int error = 
+          MPI_File_write_at
+          ( fh, 0, &header, sizeof(LPSCompressedHeader), MPI_BYTE, &status );
+        success = success && 
+          mpi_io::Completed
+          ( error, status, MPI_BYTE, sizeof(LPSCompressedHeader) );
+        error = 
+          MPI_File_write_at
+          ( fh, header.offsetsOffset, offsets.data(), numTimesteps+1, 
+            MPI_LONG_LONG, &status );
+        success = success && 
+          mpi_io::Completed( error, status, MPI_LONG_LONG, numTimesteps+1 );
+        error = 
+          MPI_File_write_at
+          ( fh, header.WScalesOffset, WScales.data(), rank, MPI_DOUBLE, 
+            &status );
+        success = success && 
+          mpi_io::Completed( error, status, MPI_DOUBLE, rank );
+        std::vector<char> VPacked( numTimesteps*rank*valueSize );
+        for( int k=0; k<rank; ++k )
+            for( int t=0; t<numTimesteps; ++t )
+                Pack
+                ( V.Get(t,k), valueType, 
+                  &VPacked[(t+k*numTimesteps)*valueSize] );
+        error = 
+          MPI_File_write_at
+          ( fh, header.VOffset, VPacked.data(), VPacked.size(), MPI_BYTE, 
+            &status );
+        success = success && 
+          mpi_io::Completed( error, status, MPI_BYTE, VPacked.size() );
+    }
+
+    // Each column of W holds this process's rows every colStride entries, 
+    // starting from entry colShift
+    {
+        std::vector<char> WPacked( (long long)localHeight*rank*valueSize );
+        for( int k=0; k<rank; ++k )
+            for( int iLoc=0; iLoc<localHeight; ++iLoc )
+                Pack
+                ( Complex<double>(WLoc.Get(iLoc,k))/WScales[k], valueType, 
+                  &WPacked[(iLoc+k*localHeight)*valueSize] );
+        MPI_Datatype valueDatatype, rowsType, colType;
+        MPI_Type_contiguous( valueSize, MPI_BYTE, &valueDatatype );
+        MPI_Type_commit( &valueDatatype );
+        MPI_Type_vector( localHeight, 1, colStride, valueDatatype, &rowsType );
+        MPI_Type_create_resized
+        ( rowsType, 0, MPI_Aint(N0)*N1*valueSize, &colType );
+        MPI_Type_commit( &colType );
+        const int viewError = 
+          MPI_File_set_view
+          ( fh, header.WOffset+MPI_Offset(colShift)*valueSize, valueDatatype,
+            colType, const_cast<char*>("native"), MPI_INFO_NULL );
+        const int writeError = 
+          MPI_File_write_all
+          ( fh, WPacked.data(), localHeight*rank, valueDatatype, &status );
+        success = success && viewError == MPI_SUCCESS &&
+          mpi_io::Completed
+          ( writeError, status, valueDatatype, localHeight*rank );
+        MPI_Type_free( &colType );
+        MPI_Type_free( &rowsType );
+        MPI_Type_free( &valueDatatype );
+    }
+
+    // Each process writes its entries of frame t after those of the 
+    // processes before it
+    {
+        long long numLocalEntries = 0;
+        for( int t=0; t<numTimesteps; ++t )
+            numLocalEntries += localCounts[t];
+        std::vector<char> entries( numLocalEntries*entrySize );
+        std::vector<int> blockLengths( numTimesteps );
+        std::vector<MPI_Aint> displacements( numTimesteps );
+        long long entry = 0;
+        for( int t=0; t<numTimesteps; ++t )
+        {
+            blockLengths[t] = localCounts[t]*entrySize;
+            displacements[t] = (offsets[t]+prefixCounts[t])*entrySize;
+            const F* tCol = T.LockedBuffer(0,t);
+            for( int iLoc=0; iLoc<localHeight; ++iLoc )
+            {
+                if( std::norm(tCol[iLoc]) <= dropSq )
+                    continue;
+                char* dest = &entries[entry*entrySize];
+                const std::int32_t index = colShift + iLoc*colStride;
+                std::memcpy( dest, &index, sizeof(std::int32_t) );
+                Pack
+                ( Complex<double>(tCol[iLoc])/SScale, valueType, 
+                  dest+sizeof(std::int32_t) );
+                ++entry;
+            }
+        }
+        MPI_Datatype fileType;
+        MPI_Type_create_hindexed
+        ( numTimesteps, blockLengths.data(), displacements.data(), MPI_BYTE,
+          &fileType );
+        MPI_Type_commit( &fileType );
+        const int viewError = 
+          MPI_File_set_view
+          ( fh, header.entriesOffset, MPI_BYTE, fileType, 
+            const_cast<char*>("native"), MPI_INFO_NULL );
+        const int writeError = 
+          MPI_File_write_all
+          ( fh, entries.data(), entries.size(), MPI_BYTE, &status );
+        success = success && viewError == MPI_SUCCESS &&
+          mpi_io::Completed( writeError, status, MPI_BYTE, entries.size() );
+        MPI_Type_free( &fileType );
+    }
+    const int closeError = MPI_File_close( &fh );
+    success = success && closeError == MPI_SUCCESS;
+    if( !mpi_io::AgreeOnSuccess( success, comm.comm ) )
+        RuntimeError("Could not write ",filename);
+}
+
+inline LPSCompressedHeader
+ReadLPSCompressedHeader( std::string filename )
+{
+    DEBUG_ONLY(CallStackEntry cse("ReadLPSCompressedHeader"))
+    std::ifstream file( filename.c_str(), std::ios::binary );
+    if( !file.is_open() )
+        RuntimeError("Could not open ",filename);
+    LPSCompressedHeader header;
+    file.read( reinterpret_cast<char*>(&header), sizeof(header) );
+    if( !file || 
+        std::memcmp( header.magic, LPS_COMPRESSED_MAGIC, 8 ) != 0 ||
+        header.version != LPS_COMPRESSED_VERSION )
+        RuntimeError(filename," is not a compressed L+S file");
+    if( header.valueType < 0 || header.valueType >= LPSValueType_MAX )
+        RuntimeError(filename," has an invalid value type");
+    if( header.N0 < 0 || header.N1 < 0 || header.numTimesteps < 0 || 
+        header.rank < 0 || header.rank > header.numTimesteps ||
+        header.numNonzeros < 0 )
+        RuntimeError(filename," has an invalid header");
+    // The readers index frames and pixels with ints (as does the writer)
+    const long long maxInt = std::numeric_limits<int>::max();
+    if( header.numTimesteps >= maxInt || 
+        ( header.N1 != 0 && header.N0 > maxInt/header.N1 ) )
+        RuntimeError(filename," is too large");
+    return header;
+}
+
+// Reconstructs frame t of L and S from a file written by WriteLPSCompressed
+// as N0 x N1 matrices (oriented as in WriteLPS). Only the frame offsets, 
+// row t of V, W, and the entries needed for frame t are read: the entries 
+// of frames 0 through t for TV, and all of them for the temporal FFT.
+inline void
+ReadLPSCompressedFrame
+( std::string filename, int t, 
+  Matrix<Complex<double>>& LFrame, Matrix<Complex<double>>& SFrame )
+{
+    DEBUG_ONLY(CallStackEntry cse("ReadLPSCompressedFrame"))
+    typedef Complex<double> F;
+    using compressed_lps::Unpack;
+    const LPSCompressedHeader header = ReadLPSCompressedHeader( filename );
+    const int N0 = header.N0;
+    const int N1 = header.N1;
+    const int numPixels = N0*N1;
+    const int numTimesteps = header.numTimesteps;
+    const int rank = header.rank;
+    if( t < 0 || t >= numTimesteps )
+        LogicError("Frame ",t," is not in [0,",numTimesteps,")");
+    const auto valueType = static_cast<LPSValueType>(header.valueType);
+    const int valueSize = compressed_lps::ValueSize( valueType );
+    const int entrySize = sizeof(std::int32_t) + valueSize;
+    std::ifstream file( filename.c_str(), std::ios::binary );
+
+    std::vector<long long> offsets( numTimesteps+1 );
+    file.seekg( header.offsetsOffset );
+    file.read
+    ( reinterpret_cast<char*>(offsets.data()), 
+      (numTimesteps+1)*sizeof(long long) );
+    // The entries are located through the offsets, so they must partition 
+    // [0,numNonzeros) before any of them are trusted
+    bool validOffsets = 
+      file && offsets[0] == 0 && offsets[numTimesteps] == header.numNonzeros;
+    for( int k=0; k<numTimesteps; ++k )
+        validOffsets = validOffsets && offsets[k] <= offsets[k+1];
+    if( !validOffsets )
+        RuntimeError(filename," has invalid frame offsets");
+
+    std::vector<double> WScales( rank );
+    file.seekg( header.WScalesOffset );
+    file.read
+    ( reinterpret_cast<char*>(WScales.data()), rank*sizeof(double) );
+
+    // L_t = W conj(V(t,:))^T
+    std::vector<F> LCol( numPixels, F(0) );
+    std::vector<char> buffer( std::size_t(numPixels)*valueSize );
+    for( int k=0; k<rank; ++k )
+    {
+        char value[2*sizeof(double)];
+        file.seekg( header.VOffset + (t+(long long)k*numTimesteps)*valueSize );
+        file.read( value, valueSize );
+        const F vConj = WScales[k]*Conj(Unpack( value, valueType ));
+        file.seekg( header.WOffset + (long long)k*numPixels*valueSize );
+        file.read( buffer.data(), buffer.size() );
+        for( int p=0; p<numPixels; ++p )
+            LCol[p] += Unpack( &buffer[p*valueSize], valueType )*vConj;
+    }
+
+    // S_t is the sum of the first t+1 frames of differences for TV and the
+    // inverse temporal FFT otherwise
+    std::vector<F> SCol( numPixels, F(0) );
+    const int lastFrame = ( header.tv ? t : numTimesteps-1 );
+    const double scale = 1/Sqrt(double(numTimesteps));
+    for( int k=0; k<=lastFrame; ++k )
+    {
+        const long long numEntries = offsets[k+1] - offsets[k];
+        buffer.resize( numEntries*entrySize );
+        file.seekg( header.entriesOffset + offsets[k]*entrySize );
+        file.read( buffer.data(), numEntries*entrySize );
+        F phase = 1;
+        if( !header.tv )
+        {
+            const double pi = 4*std::atan(1.);
+            const double theta = 
+              2*pi*double((long long)k*t%numTimesteps)/numTimesteps;
+            phase = scale*F(std::cos(theta),std::sin(theta));
+        }
+        phase *= header.SScale;
+        for( long long e=0; e<numEntries; ++e )
+        {
+            const char* entry = &buffer[e*entrySize];
+            std::int32_t p;
+            std::memcpy( &p, entry, sizeof(std::int32_t) );
+            if( p < 0 || p >= numPixels )
+                RuntimeError
+                (filename," has an entry for pixel ",p," of frame ",k);
+            SCol[p] += phase*Unpack( entry+sizeof(std::int32_t), valueType );
+        }
+    }
+    if( !file )
+        RuntimeError("Could not read frame ",t," of ",filename);
+
+    LFrame.Resize( N0, N1 );
+    SFrame.Resize( N0, N1 );
+    for( int j=0; j<N1; ++j )
+        for( int i=0; i<N0; ++i )
+        {
+            LFrame.Set( i, j, LCol[j+i*N1] );
+            SFrame.Set( i, j, SCol[j+i*N1] );
+        }
+}
+
+} // namespace mri
+
+#endif // ifndef RTLPSMRI_COMPRESSEDLPS_HPP
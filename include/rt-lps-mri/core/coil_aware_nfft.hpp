@@ -23,7 +23,92 @@
 
 namespace mri {
 
-// TODO: Decide how to multithread embarrassingly parallel local transforms
+// The local columns are independent and are distributed over the threads 
+// which were requested when the coil plans were initialized; each thread
+// transforms its columns using its own copy of the coil plans (and therefore
+// its own oversampled grids and FFTW plans).
+
+// Transform the local columns [jLocBeg,jLocEnd) of FHat into those of F,
+// which must already be sized and aligned with FHat
+inline void
+CoilAwareNFFT2D
+( const DistMatrix<Complex<double>,STAR,VR>& FHat, 
+        DistMatrix<Complex<double>,STAR,VR>& F, int jLocBeg, int jLocEnd )
+{
+    DEBUG_ONLY(CallStackEntry cse("CoilAwareNFFT2D"))
+    const int numNonUniform = NumNonUniformPoints();
+    const int numCoils = NumCoils();
+    const double scale = 1./Sqrt(1.*FirstBandwidth()*SecondBandwidth());
+    const int rowShift = F.RowShift();
+    const int rowStride = F.RowStride();
+    const int numThreads = NumNFFTThreads();
+    const Complex<double>* FHatBuf = FHat.LockedBuffer();
+    Complex<double>* FBuf = F.Buffer();
+    const int FHatLDim = FHat.LDim();
+    const int FLDim = F.LDim();
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp parallel for schedule(static) num_threads(numThreads)
+#endif
+    for( int jLoc=jLocBeg; jLoc<jLocEnd; ++jLoc )
+    {
+#ifdef RTLPSMRI_HAVE_OPENMP
+        const int thread = omp_get_thread_num();
+#else
+        const int thread = 0;
+#endif
+        const int j = rowShift + jLoc*rowStride;
+        const int t = PathOfTimestep( j / numCoils );
+        nfft_plan& p = CoilPlan( t, thread );
+        p.f_hat = (fftw_complex*)
+            const_cast<Complex<double>*>(&FHatBuf[jLoc*FHatLDim]);
+        p.f = (fftw_complex*)&FBuf[jLoc*FLDim];
+        nfft_trafo_2d( &p );
+        Complex<double>* f = &FBuf[jLoc*FLDim];
+        for( int i=0; i<numNonUniform; ++i )
+            f[i] *= scale;
+    }
+}
+
+// Transform the local columns [jLocBeg,jLocEnd) of F into those of FHat,
+// which must already be sized and aligned with F
+inline void
+CoilAwareAdjointNFFT2D
+( const DistMatrix<Complex<double>,STAR,VR>& F,
+        DistMatrix<Complex<double>,STAR,VR>& FHat, int jLocBeg, int jLocEnd )
+{
+    DEBUG_ONLY(CallStackEntry cse("CoilAwareAdjointNFFT2D"))
+    const int numPixels = FirstBandwidth()*SecondBandwidth();
+    const int numCoils = NumCoils();
+    const double scale = 1./Sqrt(1.*numPixels);
+    const int rowShift = F.RowShift();
+    const int rowStride = F.RowStride();
+    const int numThreads = NumNFFTThreads();
+    const Complex<double>* FBuf = F.LockedBuffer();
+    Complex<double>* FHatBuf = FHat.Buffer();
+    const int FLDim = F.LDim();
+    const int FHatLDim = FHat.LDim();
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp parallel for schedule(static) num_threads(numThreads)
+#endif
+    for( int jLoc=jLocBeg; jLoc<jLocEnd; ++jLoc )
+    {
+#ifdef RTLPSMRI_HAVE_OPENMP
+        const int thread = omp_get_thread_num();
+#else
+        const int thread = 0;
+#endif
+        const int j = rowShift + jLoc*rowStride;
+        const int t = PathOfTimestep( j / numCoils );
+        nfft_plan& p = CoilPlan( t, thread );
+        p.f = (fftw_complex*)
+            const_cast<Complex<double>*>(&FBuf[jLoc*FLDim]);
+        p.f_hat = (fftw_complex*)&FHatBuf[jLoc*FHatLDim];
+        nfft_adjoint( &p );
+        Complex<double>* fHat = &FHatBuf[jLoc*FHatLDim];
+        for( int i=0; i<numPixels; ++i )
+            fHat[i] *= scale;
+    }
+}
 
 inline void
 CoilAwareNFFT2D
@@ -33,12 +118,12 @@ CoilAwareNFFT2D
     DEBUG_ONLY(CallStackEntry cse("CoilAwareNFFT2D"))
     const int width = FHat.Width();
     const int numNonUniform = NumNonUniformPoints();
-    const int N0 = FirstBandwidth();
-    const int N1 = SecondBandwidth();
-    const int numCoils = NumCoils();
     DEBUG_ONLY(
+        const int N0 = FirstBandwidth();
+        const int N1 = SecondBandwidth();
+        const int numCoils = NumCoils();
         const int numTimesteps = NumTimesteps();
-        if( numCoils*numTimesteps != width )
+        if( width % (numCoils*numTimesteps) != 0 )
             LogicError("Invalid width");
         if( N0 % 2 != 0 || N1 % 2 != 0 )
             LogicError("NFFT requires band limits to be even integers\n");
@@ -47,21 +132,7 @@ CoilAwareNFFT2D
     )
     F.AlignWith( FHat );
     Zeros( F, numNonUniform, width );
-    const int locWidth = F.LocalWidth();
-    const int rowShift = F.RowShift();
-    const int rowStride = F.RowStride();
-    for( int jLoc=0; jLoc<locWidth; ++jLoc )
-    {
-        const int j = rowShift + jLoc*rowStride;
-        const int t = j / numCoils;
-        nfft_plan& p = CoilPlan( t );
-        p.f_hat = (fftw_complex*)
-            const_cast<Complex<double>*>(FHat.LockedBuffer(0,jLoc));
-        p.f = (fftw_complex*)F.Buffer(0,jLoc);
-        nfft_trafo_2d( &p );
-    }
-    const double scale = 1./Sqrt(1.*N0*N1);
-    Scale( scale, F );
+    CoilAwareNFFT2D( FHat, F, 0, F.LocalWidth() );
 }
 
 inline void
@@ -73,11 +144,11 @@ CoilAwareAdjointNFFT2D
     const int width = F.Width();
     const int N0 = FirstBandwidth();
     const int N1 = SecondBandwidth();
-    const int numCoils = NumCoils();
     DEBUG_ONLY(
+        const int numCoils = NumCoils();
         const int numTimesteps = NumTimesteps();
         const int numNonUniform = NumNonUniformPoints();
-        if( width != numCoils*numTimesteps )
+        if( width % (numCoils*numTimesteps) != 0 )
             LogicError("Invalid width");
         if( N0 % 2 != 0 || N1 % 2 != 0 )
             LogicError("NFFT requires band limits to be even integers\n");
@@ -86,21 +157,7 @@ CoilAwareAdjointNFFT2D
     )
     FHat.AlignWith( F );
     Zeros( FHat, N0*N1, width );
-    const int locWidth = F.LocalWidth();
-    const int rowShift = F.RowShift();
-    const int rowStride = F.RowStride();
-    for( int jLoc=0; jLoc<locWidth; ++jLoc )
-    {
-        const int j = rowShift + jLoc*rowStride;
-        const int t = j / numCoils;
-        nfft_plan& p = CoilPlan( t );
-        p.f = (fftw_complex*)
-            const_cast<Complex<double>*>(F.LockedBuffer(0,jLoc));
-        p.f_hat = (fftw_complex*)FHat.Buffer(0,jLoc);
-        nfft_adjoint( &p );
-    }
-    const double scale = 1./Sqrt(1.*N0*N1);
-    Scale( scale, FHat );
+    CoilAwareAdjointNFFT2D( F, FHat, 0, F.LocalWidth() );
 }
 
 } // namespace mri
@@ -36,7 +36,7 @@ CoilAwareNFT2D
     const int N1 = SecondBandwidth();
     const int numCoils = NumCoils();
     DEBUG_ONLY(
-        if( width != numCoils*NumTimesteps() )
+        if( width % (numCoils*NumTimesteps()) != 0 )
             LogicError("Invalid width");
         if( FHat.Height() != N0*N1 )
             LogicError("Invalid FHat height");
@@ -49,7 +49,7 @@ CoilAwareNFT2D
     for( int jLoc=0; jLoc<locWidth; ++jLoc )
     {
         const int j = rowShift + jLoc*rowStride;
-        const int t = j / numCoils;
+        const int t = PathOfTimestep( j / numCoils );
         nfft_plan& plan = CoilPlan( t );
         const double* x = plan.x;
         Complex<double>* f = F.Buffer(0,jLoc);
@@ -90,7 +90,7 @@ CoilAwareAdjointNFT2D
     const int N1 = SecondBandwidth();
     const int numCoils = NumCoils();
     DEBUG_ONLY(
-        if( width != numCoils*NumTimesteps() )
+        if( width % (numCoils*NumTimesteps()) != 0 )
             LogicError("Invalid width");
         if( F.Height() != numNonUniform )
             LogicError("Invalid F height");
@@ -103,7 +103,7 @@ CoilAwareAdjointNFT2D
     for( int jLoc=0; jLoc<locWidth; ++jLoc )
     {
         const int j = rowShift + jLoc*rowStride;
-        const int t = j / numCoils;
+        const int t = PathOfTimestep( j / numCoils );
         nfft_plan& plan = CoilPlan( t );
         const double* x = plan.x;
         const Complex<double>* f = F.LockedBuffer(0,jLoc);
@@ -0,0 +1,342 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#ifndef RTLPSMRI_CORE_COIL_BATCHED_NFFT_HPP
+#define RTLPSMRI_CORE_COIL_BATCHED_NFFT_HPP
+
+namespace mri {
+
+// Since every coil of a given timestep shares the same trajectory, the local
+// columns of each timestep can be transformed simultaneously. The oversampled
+// grids of the b local coils of a timestep are interleaved so that the value
+// of the k'th coil at grid point i is stored at index k + i*b, which allows 
+// each entry of the precomputed interpolation window (PRE_FULL_PSI) to be 
+// loaded once and applied to all b coils (turning the sparse matrix-vector
+// products of the spreading/interpolation step into a sparse matrix-matrix
+// product).
+//
+// The groups of columns which share a timestep are distributed over the 
+// threads which were requested when the coil plans were initialized.
+
+namespace coil_batch {
+
+// Partition the local columns [jLocBeg,jLocEnd) into contiguous groups which
+// share a timestep. The columns of the g'th group are 
+// [offsets[g],offsets[g+1]).
+inline void
+TimestepGroups
+( int jLocBeg, int jLocEnd, int rowShift, int rowStride, int numCoils,
+  std::vector<int>& timesteps, std::vector<int>& offsets )
+{
+    timesteps.clear();
+    offsets.clear();
+    for( int jLoc=jLocBeg; jLoc<jLocEnd; ++jLoc )
+    {
+        const int t = (rowShift + jLoc*rowStride) / numCoils;
+        if( timesteps.empty() || timesteps.back() != t )
+        {
+            timesteps.push_back( t );
+            offsets.push_back( jLoc );
+        }
+    }
+    offsets.push_back( jLocEnd );
+}
+
+inline void
+TimestepGroups
+( int localWidth, int rowShift, int rowStride, int numCoils,
+  std::vector<int>& timesteps, std::vector<int>& offsets )
+{ 
+    TimestepGroups
+    ( 0, localWidth, rowShift, rowStride, numCoils, timesteps, offsets ); 
+}
+
+inline int
+MaxGroupSize( const std::vector<int>& offsets )
+{
+    int maxSize = 0;
+    for( unsigned g=0; g+1<offsets.size(); ++g )
+        maxSize = std::max( maxSize, offsets[g+1]-offsets[g] );
+    return maxSize;
+}
+
+// Frequency index a in [0,N) corresponds to the frequency a-N/2, which is 
+// stored at position (a-N/2) mod n of the oversampled grid
+inline int
+GridIndex( int a, int N, int n )
+{ return ( a < N/2 ? n-N/2+a : a-N/2 ); }
+
+} // namespace coil_batch
+
+// Transform the local columns [jLocBeg,jLocEnd) of FHat into those of F,
+// which must already be sized and aligned with FHat
+inline void
+CoilBatchedNFFT2D
+( const DistMatrix<Complex<double>,STAR,VR>& FHat, 
+        DistMatrix<Complex<double>,STAR,VR>& F, int jLocBeg, int jLocEnd )
+{
+    DEBUG_ONLY(CallStackEntry cse("CoilBatchedNFFT2D"))
+    typedef Complex<double> C;
+    const int numNonUniform = NumNonUniformPoints();
+    const int N0 = FirstBandwidth();
+    const int N1 = SecondBandwidth();
+    const int n0 = FirstFFTSize();
+    const int n1 = SecondFFTSize();
+    const int numCoils = NumCoils();
+    const double normalization = 1./Sqrt(1.*N0*N1);
+
+    std::vector<int> timesteps, offsets;
+    coil_batch::TimestepGroups
+    ( jLocBeg, jLocEnd, F.RowShift(), F.RowStride(), numCoils, 
+      timesteps, offsets );
+    const int numGroups = timesteps.size();
+    ReserveCoilBatches( coil_batch::MaxGroupSize(offsets) );
+
+    const int numThreads = NumNFFTThreads();
+    const C* FHatBuf = FHat.LockedBuffer();
+    C* FBuf = F.Buffer();
+    const int FHatLDim = FHat.LDim();
+    const int FLDim = F.LDim();
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp parallel num_threads(numThreads)
+#endif
+    {
+#ifdef RTLPSMRI_HAVE_OPENMP
+        const int thread = omp_get_thread_num();
+#else
+        const int thread = 0;
+#endif
+        fftw_complex* gridBuf = CoilBatchGrid( thread );
+        C* G = reinterpret_cast<C*>(gridBuf);
+        std::vector<C> acc;
+#ifdef RTLPSMRI_HAVE_OPENMP
+        #pragma omp for schedule(dynamic)
+#endif
+        for( int g=0; g<numGroups; ++g )
+        {
+            const int jLocBeg = offsets[g];
+            const int b = offsets[g+1] - jLocBeg;
+            const int path = PathOfTimestep( timesteps[g] );
+            const nfft_plan& p = CoilPlan( path, thread );
+            const C* fHats = &FHatBuf[jLocBeg*FHatLDim];
+                  C* fs    = &FBuf[jLocBeg*FLDim];
+
+            // Deconvolve and zero-pad each coil's image into its grid
+            El::MemZero( G, n0*n1*b );
+            const double* cPhiInv0 = p.c_phi_inv[0];
+            const double* cPhiInv1 = p.c_phi_inv[1];
+            for( int a0=0; a0<N0; ++a0 )
+            {
+                const int i0 = coil_batch::GridIndex( a0, N0, n0 );
+                for( int a1=0; a1<N1; ++a1 )
+                {
+                    const int i1 = coil_batch::GridIndex( a1, N1, n1 );
+                    const double scale = 
+                      normalization*cPhiInv0[a0]*cPhiInv1[a1];
+                    const C* fHat = &fHats[a1+a0*N1];
+                    C* gEntry = &G[(i1+i0*n1)*b];
+                    for( int k=0; k<b; ++k )
+                        gEntry[k] = scale*fHat[k*FHatLDim];
+                }
+            }
+
+            // Transform all of the interleaved grids at once
+            fftw_execute_dft
+            ( CoilBatchPlan( b, FFTW_FORWARD ), gridBuf, gridBuf );
+
+            // Interpolate each node from the grids of all of the coils
+            acc.resize( b );
+            const double* psi = p.psi;
+            const auto* psiIndexG = p.psi_index_g;
+            const auto* psiIndexF = p.psi_index_f;
+            for( int i=0, ix=0; i<numNonUniform; ++i )
+            {
+                for( int k=0; k<b; ++k )
+                    acc[k] = 0;
+                const int numEntries = psiIndexF[i];
+                for( int l=0; l<numEntries; ++l, ++ix )
+                {
+                    const double w = psi[ix];
+                    const C* gEntry = &G[psiIndexG[ix]*b];
+                    for( int k=0; k<b; ++k )
+                        acc[k] += w*gEntry[k];
+                }
+                for( int k=0; k<b; ++k )
+                    fs[i+k*FLDim] = acc[k];
+            }
+        }
+    }
+}
+
+inline void
+CoilBatchedNFFT2D
+( const DistMatrix<Complex<double>,STAR,VR>& FHat, 
+        DistMatrix<Complex<double>,STAR,VR>& F )
+{
+    DEBUG_ONLY(CallStackEntry cse("CoilBatchedNFFT2D"))
+    const int width = FHat.Width();
+    const int numNonUniform = NumNonUniformPoints();
+    DEBUG_ONLY(
+        const int N0 = FirstBandwidth();
+        const int N1 = SecondBandwidth();
+        const int numCoils = NumCoils();
+        const int numTimesteps = NumTimesteps();
+        if( width % (numCoils*numTimesteps) != 0 )
+            LogicError("Invalid width");
+        if( N0 % 2 != 0 || N1 % 2 != 0 )
+            LogicError("NFFT requires band limits to be even integers\n");
+        if( FHat.Height() != N0*N1 )
+            LogicError("Invalid FHat height");
+        if( !(CoilPlan(0).nfft_flags & PRE_FULL_PSI) )
+            LogicError("Coil batching requires PRE_FULL_PSI");
+    )
+    F.AlignWith( FHat );
+    Zeros( F, numNonUniform, width );
+    CoilBatchedNFFT2D( FHat, F, 0, F.LocalWidth() );
+}
+
+// Transform the local columns [jLocBeg,jLocEnd) of F into those of FHat,
+// which must already be sized and aligned with F
+inline void
+CoilBatchedAdjointNFFT2D
+( const DistMatrix<Complex<double>,STAR,VR>& F,
+        DistMatrix<Complex<double>,STAR,VR>& FHat, int jLocBeg, int jLocEnd )
+{
+    DEBUG_ONLY(CallStackEntry cse("CoilBatchedAdjointNFFT2D"))
+    typedef Complex<double> C;
+    const int numNonUniform = NumNonUniformPoints();
+    const int N0 = FirstBandwidth();
+    const int N1 = SecondBandwidth();
+    const int n0 = FirstFFTSize();
+    const int n1 = SecondFFTSize();
+    const int numCoils = NumCoils();
+    const double normalization = 1./Sqrt(1.*N0*N1);
+
+    std::vector<int> timesteps, offsets;
+    coil_batch::TimestepGroups
+    ( jLocBeg, jLocEnd, F.RowShift(), F.RowStride(), numCoils, 
+      timesteps, offsets );
+    const int numGroups = timesteps.size();
+    ReserveCoilBatches( coil_batch::MaxGroupSize(offsets) );
+
+    const int numThreads = NumNFFTThreads();
+    const C* FBuf = F.LockedBuffer();
+    C* FHatBuf = FHat.Buffer();
+    const int FLDim = F.LDim();
+    const int FHatLDim = FHat.LDim();
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp parallel num_threads(numThreads)
+#endif
+    {
+#ifdef RTLPSMRI_HAVE_OPENMP
+        const int thread = omp_get_thread_num();
+#else
+        const int thread = 0;
+#endif
+        fftw_complex* gridBuf = CoilBatchGrid( thread );
+        C* G = reinterpret_cast<C*>(gridBuf);
+        std::vector<C> acc;
+#ifdef RTLPSMRI_HAVE_OPENMP
+        #pragma omp for schedule(dynamic)
+#endif
+        for( int g=0; g<numGroups; ++g )
+        {
+            const int jLocBeg = offsets[g];
+            const int b = offsets[g+1] - jLocBeg;
+            const int path = PathOfTimestep( timesteps[g] );
+            const nfft_plan& p = CoilPlan( path, thread );
+            const C* fs    = &FBuf[jLocBeg*FLDim];
+                  C* fHats = &FHatBuf[jLocBeg*FHatLDim];
+
+            // Spread each node onto the grids of all of the coils
+            El::MemZero( G, n0*n1*b );
+            acc.resize( b );
+            const double* psi = p.psi;
+            const auto* psiIndexG = p.psi_index_g;
+            const auto* psiIndexF = p.psi_index_f;
+            for( int i=0, ix=0; i<numNonUniform; ++i )
+            {
+                for( int k=0; k<b; ++k )
+                    acc[k] = fs[i+k*FLDim];
+                const int numEntries = psiIndexF[i];
+                for( int l=0; l<numEntries; ++l, ++ix )
+                {
+                    const double w = psi[ix];
+                    C* gEntry = &G[psiIndexG[ix]*b];
+                    for( int k=0; k<b; ++k )
+                        gEntry[k] += w*acc[k];
+                }
+            }
+
+            // Transform all of the interleaved grids at once
+            fftw_execute_dft
+            ( CoilBatchPlan( b, FFTW_BACKWARD ), gridBuf, gridBuf );
+
+            // Truncate and deconvolve each coil's grid into its image
+            const double* cPhiInv0 = p.c_phi_inv[0];
+            const double* cPhiInv1 = p.c_phi_inv[1];
+            for( int a0=0; a0<N0; ++a0 )
+            {
+                const int i0 = coil_batch::GridIndex( a0, N0, n0 );
+                for( int a1=0; a1<N1; ++a1 )
+                {
+                    const int i1 = coil_batch::GridIndex( a1, N1, n1 );
+                    const double scale = 
+                      normalization*cPhiInv0[a0]*cPhiInv1[a1];
+                    C* fHat = &fHats[a1+a0*N1];
+                    const C* gEntry = &G[(i1+i0*n1)*b];
+                    for( int k=0; k<b; ++k )
+                        fHat[k*FHatLDim] = scale*gEntry[k];
+                }
+            }
+        }
+    }
+}
+
+inline void
+CoilBatchedAdjointNFFT2D
+( const DistMatrix<Complex<double>,STAR,VR>& F,
+        DistMatrix<Complex<double>,STAR,VR>& FHat )
+{
+    DEBUG_ONLY(CallStackEntry cse("CoilBatchedAdjointNFFT2D"))
+    const int width = F.Width();
+    const int N0 = FirstBandwidth();
+    const int N1 = SecondBandwidth();
+    DEBUG_ONLY(
+        const int numNonUniform = NumNonUniformPoints();
+        const int numCoils = NumCoils();
+        const int numTimesteps = NumTimesteps();
+        if( width % (numCoils*numTimesteps) != 0 )
+            LogicError("Invalid width");
+        if( N0 % 2 != 0 || N1 % 2 != 0 )
+            LogicError("NFFT requires band limits to be even integers\n");
+        if( F.Height() != numNonUniform )
+            LogicError("Invalid F height");
+        if( !(CoilPlan(0).nfft_flags & PRE_FULL_PSI) )
+            LogicError("Coil batching requires PRE_FULL_PSI");
+    )
+    FHat.AlignWith( F );
+    Zeros( FHat, N0*N1, width );
+    CoilBatchedAdjointNFFT2D( F, FHat, 0, F.LocalWidth() );
+}
+
+} // namespace mri
+
+#endif // ifndef RTLPSMRI_CORE_COIL_BATCHED_NFFT_HPP
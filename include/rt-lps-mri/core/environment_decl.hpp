@@ -129,38 +129,152 @@ DEBUG_ONLY(
 
 void ReportException( std::exception& e );
 
+// The local NFFTs can either be applied one (coil,time) column at a time 
+// using NFFT3, to all of the local coils of each timestep at once using 
+// NFFT3's precomputed windows, or to all of the local coils of each timestep
+// at once using the in-tree gridding matrices (see GriddingMatrix)
+namespace NFFTTypeNS {
+enum NFFTType
+{
+    PER_COIL_NFFT,
+    COIL_BATCHED_NFFT,
+    NATIVE_NFFT,
+    NFFTType_MAX // for detecting number of entries in enum
+};
+}
+using namespace NFFTTypeNS;
+
+void SetNFFTType( NFFTType type );
+NFFTType GetNFFTType();
+
+// The acquisition operator and its adjoint can split the (coil,time) columns
+// into chunks of consecutive timesteps so that the redistribution of one 
+// chunk overlaps with the local NFFTs of another (this requires MPI-3). A 
+// single chunk, the default, gives the bulk-synchronous application.
+void SetNumPipelineChunks( int numChunks );
+int NumPipelineChunks();
+
 bool InitializedCoilPlans();
 bool InitializedAcquisition();
+bool InitializedNormalKernels();
 void InitializeCoilPlans
 ( const DistMatrix<double,STAR,STAR>& paths, 
-  int numCoils, int N0, int N1, int n0, int n1, int m );
+  int numCoils, int N0, int N1, int n0, int n1, int m, int numThreads=1 );
 void InitializeAcquisition
 ( const DistMatrix<double,         STAR,STAR>& densityComp,
   const DistMatrix<Complex<double>,STAR,STAR>& sensitivity,
   const DistMatrix<double,         STAR,STAR>& paths, 
-  int numCoils, int N0, int N1, int n0, int n1, int m );
+  int numCoils, int N0, int N1, int n0, int n1, int m, int numThreads=1,
+  bool normalKernels=false );
 void FinalizeCoilPlans();
 void FinalizeAcquisition();
 
+// For streaming reconstructions, drop the first timestep of the acquisition
+// operator and append a timestep with the given path and density compensation
+void SlideAcquisition
+( const DistMatrix<double,STAR,STAR>& path,
+  const DistMatrix<double,STAR,STAR>& densityComp );
+
 int NumCoils();
 int NumTimesteps();
 int NumNonUniformPoints();
 int FirstBandwidth();
 int SecondBandwidth();
+int FirstFFTSize();
+int SecondFFTSize();
+int NumNFFTThreads();
+
+// Several planes can be reconstructed concurrently by the threads of an 
+// (outermost) OpenMP parallel region of NumPlaneThreads() threads, which all
+// share the acquisition data. The per-thread NFFT data is then split evenly
+// between the plane threads, and, within such a region, NumNFFTThreads() 
+// is the number of NFFT threads available to each plane thread. The coil 
+// plans must already be initialized (with at least as many threads), and 
+// each plane thread must make its MPI calls on its own communicators, which
+// requires MPI_THREAD_MULTIPLE.
+void SetNumPlaneThreads( int numPlaneThreads );
+int NumPlaneThreads();
+
+// Each thread has its own copy of the plan for each path, which differ only
+// in their oversampled grids and FFTW plans
+nfft_plan& CoilPlan( int path, int thread=0 );
+
+// Each thread also has a buffer for holding the interleaved oversampled grids
+// of up to the reserved number of coils, as well as (shared) FFTW plans for
+// transforming a given number of interleaved grids in place. The buffers are
+// sized for double-precision grids and can be reused for single-precision 
+// grids (which have their own plans).
+void ReserveCoilBatches( int batchSize );
+template<typename Real=double>
+typename FFTW<Real>::complex* CoilBatchGrid( int thread=0 );
+template<typename Real=double>
+typename FFTW<Real>::plan CoilBatchPlan( int batchSize, int sign );
 
-nfft_plan& CoilPlan( int path );
+// Cached plans for applying, in place, howMany unnormalized length-n 
+// transforms to consecutive rows of a column-major matrix with leading 
+// dimension ldim. Since the plans are FFTW_UNALIGNED, they may be executed 
+// (via fftw_execute_dft) on any block of rows of such a matrix. The plans are
+// freed when RT-LPS-MRI is finalized.
+template<typename Real=double>
+typename FFTW<Real>::plan 
+TemporalPlan( int n, int howMany, int ldim, int sign );
+
+// A compressed sparse row representation of the interpolation from the 
+// (row-major) oversampled grid onto the non-uniform nodes of a timestep. 
+// Row r corresponds to node nodes[r], and its (grid index,weight) pairs are 
+// stored in [offsets[r],offsets[r+1]) of indices and weights. The rows are 
+// ordered by the first grid point of their window so that consecutive rows 
+// touch nearby portions of the grid. A single-precision copy of the weights
+// is kept for the single-precision kernels.
+struct GriddingMatrix
+{
+    std::vector<int> nodes;
+    std::vector<int> offsets;
+    std::vector<int> indices;
+    std::vector<double> weights;
+    std::vector<float> singleWeights;
+};
+
+// The gridding matrices are built from the plans' precomputed windows when 
+// the coil plans are initialized with NATIVE_NFFT selected (or when it is
+// later selected)
+bool InitializedGridding();
+const GriddingMatrix& Gridding( int path );
+
+// N0*N1 x 1
+//
+// The position of each pixel of an image within the oversampled grid, and
+// its deapodization weight (including the 1/sqrt(N0*N1) normalization)
+const std::vector<int>& GriddingIndices();
+const std::vector<double>& Deapodization();
 
 // 2*M x numTimesteps
 const DistMatrix<double,STAR,STAR>& CoilPaths();
 
+// The acquisition data is stored in both double and single precision so that
+// the operators can be applied in either
+
 // M x numTimesteps
-const DistMatrix<double,STAR,STAR>& DensityComp();
+template<typename Real=double>
+const DistMatrix<Real,STAR,STAR>& DensityComp();
 
 // N0*N1 x numCoils
-const DistMatrix<Complex<double>,STAR,STAR>& Sensitivity();
+template<typename Real=double>
+const DistMatrix<Complex<Real>,STAR,STAR>& Sensitivity();
 
 // N0*N1 x 1
-const DistMatrix<double,STAR,STAR>& SensitivityScalings();
+template<typename Real=double>
+const DistMatrix<Real,STAR,STAR>& SensitivityScalings();
+
+// (2*N0)*(2*N1) x numTimesteps
+// 
+// The (real) Fourier transforms of the circulant embeddings of the Toeplitz
+// normal operators of each timestep, stored in the row-major ordering of a 
+// 2*N0 x 2*N1 grid, along with per-thread grids and (shared) FFTW plans for
+// applying them in place
+const DistMatrix<double,STAR,STAR>& NormalKernels();
+fftw_complex* NormalGrid( int thread=0 );
+fftw_plan NormalPlan( int sign );
 
 } // namespace mri
 
@@ -76,6 +76,45 @@ inline void
 PrintInputReport()
 { GetArgs().PrintReport(); }
 
+// Copy a distributed matrix into one of a different precision with the same
+// distribution and alignment
+template<typename S,typename T,Dist U,Dist V>
+inline void
+Convert( const DistMatrix<S,U,V>& A, DistMatrix<T,U,V>& B )
+{
+    DEBUG_ONLY(CallStackEntry cse("Convert"))
+    B.SetGrid( A.Grid() );
+    B.AlignWith( A );
+    B.Resize( A.Height(), A.Width() );
+    const int localHeight = A.LocalHeight();
+    const int localWidth = A.LocalWidth();
+    for( int jLoc=0; jLoc<localWidth; ++jLoc )
+    {
+        const S* ACol = A.LockedBuffer(0,jLoc);
+        T* BCol = B.Buffer(0,jLoc);
+        for( int iLoc=0; iLoc<localHeight; ++iLoc )
+            BCol[iLoc] = T(ACol[iLoc]);
+    }
+}
+
+// Several planes can be processed together by stacking their timesteps side 
+// by side (see BatchedLPS), in which case the t'th stacked timestep belongs 
+// to plane t / NumTimesteps() and follows path t % NumTimesteps()
+inline int
+PathOfTimestep( int t )
+{ return t % NumTimesteps(); }
+
+// The MPI datatype of a complex scalar, for calls which bypass Elemental's
+// MPI wrappers
+template<typename Real>
+inline MPI_Datatype MpiComplexType();
+template<>
+inline MPI_Datatype MpiComplexType<double>()
+{ return MPI_C_DOUBLE_COMPLEX; }
+template<>
+inline MPI_Datatype MpiComplexType<float>()
+{ return MPI_C_FLOAT_COMPLEX; }
+
 } // namespace mri
 
 #endif // ifndef RTLPSMRI_CORE_ENVIRONMENT_IMPL_HPP
@@ -0,0 +1,96 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#ifndef RTLPSMRI_CORE_FFTW_HPP
+#define RTLPSMRI_CORE_FFTW_HPP
+
+namespace mri {
+
+// A thin wrapper around the double- and single-precision interfaces of FFTW
+// so that the transforms can be templated on the underlying real type. The
+// single-precision interface is only available if libfftw3f was detected.
+template<typename Real>
+struct FFTW;
+
+template<>
+struct FFTW<double>
+{
+    typedef fftw_complex complex;
+    typedef fftw_plan plan;
+
+    static void* malloc( size_t n ) { return fftw_malloc( n ); }
+    static void free( void* p ) { fftw_free( p ); }
+
+    static plan plan_dft_1d
+    ( int n, complex* in, complex* out, int sign, unsigned flags )
+    { return fftw_plan_dft_1d( n, in, out, sign, flags ); }
+
+    static plan plan_many_dft
+    ( int rank, const int* n, int howMany, 
+      complex* in,  const int* inEmbed,  int inStride,  int inDist,
+      complex* out, const int* outEmbed, int outStride, int outDist,
+      int sign, unsigned flags )
+    { 
+        return fftw_plan_many_dft
+        ( rank, n, howMany, in, inEmbed, inStride, inDist, 
+          out, outEmbed, outStride, outDist, sign, flags ); 
+    }
+
+    static void execute( const plan p ) { fftw_execute( p ); }
+    static void execute_dft( const plan p, complex* in, complex* out )
+    { fftw_execute_dft( p, in, out ); }
+    static void destroy_plan( plan p ) { fftw_destroy_plan( p ); }
+};
+
+#ifdef RTLPSMRI_HAVE_FFTWF
+template<>
+struct FFTW<float>
+{
+    typedef fftwf_complex complex;
+    typedef fftwf_plan plan;
+
+    static void* malloc( size_t n ) { return fftwf_malloc( n ); }
+    static void free( void* p ) { fftwf_free( p ); }
+
+    static plan plan_dft_1d
+    ( int n, complex* in, complex* out, int sign, unsigned flags )
+    { return fftwf_plan_dft_1d( n, in, out, sign, flags ); }
+
+    static plan plan_many_dft
+    ( int rank, const int* n, int howMany, 
+      complex* in,  const int* inEmbed,  int inStride,  int inDist,
+      complex* out, const int* outEmbed, int outStride, int outDist,
+      int sign, unsigned flags )
+    { 
+        return fftwf_plan_many_dft
+        ( rank, n, howMany, in, inEmbed, inStride, inDist, 
+          out, outEmbed, outStride, outDist, sign, flags ); 
+    }
+
+    static void execute( const plan p ) { fftwf_execute( p ); }
+    static void execute_dft( const plan p, complex* in, complex* out )
+    { fftwf_execute_dft( p, in, out ); }
+    static void destroy_plan( plan p ) { fftwf_destroy_plan( p ); }
+};
+#endif // ifdef RTLPSMRI_HAVE_FFTWF
+
+} // namespace mri
+
+#endif // ifndef RTLPSMRI_CORE_FFTW_HPP
@@ -0,0 +1,75 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#ifndef RTLPSMRI_CORE_FUSEDREDUCTION_HPP
+#define RTLPSMRI_CORE_FUSEDREDUCTION_HPP
+
+namespace mri {
+
+// A fixed set of sums (e.g., squared Frobenius norms and nonzero counts) and
+// maxima which are accumulated locally and then combined with a single 
+// MPI_Allreduce, using a custom datatype and operation, instead of one 
+// full pass and one collective per statistic. The entries are always 
+// accumulated in double precision so that counts remain exact.
+struct FusedReduction
+{
+    static const int NUM_SUMS = 8;
+    static const int NUM_MAXES = 2;
+
+    double sums[NUM_SUMS];
+    double maxes[NUM_MAXES];
+
+    FusedReduction()
+    {
+        for( int k=0; k<NUM_SUMS; ++k )
+            sums[k] = 0;
+        for( int k=0; k<NUM_MAXES; ++k )
+            maxes[k] = 0;
+    }
+};
+
+// The datatype and operation are created upon first use and freed by 
+// Finalize
+MPI_Datatype FusedReductionType();
+MPI_Op FusedReductionOp();
+
+inline void
+FusedAllReduce( FusedReduction& reduction, mpi::Comm comm )
+{
+    DEBUG_ONLY(CallStackEntry cse("FusedAllReduce"))
+    MPI_Allreduce
+    ( MPI_IN_PLACE, &reduction, 1, FusedReductionType(), FusedReductionOp(),
+      comm.comm );
+}
+
+// Combine an independent set of statistics (e.g., one per plane) in a single
+// reduction
+inline void
+FusedAllReduce( std::vector<FusedReduction>& reductions, mpi::Comm comm )
+{
+    DEBUG_ONLY(CallStackEntry cse("FusedAllReduce"))
+    MPI_Allreduce
+    ( MPI_IN_PLACE, reductions.data(), reductions.size(), 
+      FusedReductionType(), FusedReductionOp(), comm.comm );
+}
+
+} // namespace mri
+
+#endif // ifndef RTLPSMRI_CORE_FUSEDREDUCTION_HPP
@@ -21,18 +21,122 @@
 #ifndef RTLPSMRI_CORE_LOADDATA_HPP
 #define RTLPSMRI_CORE_LOADDATA_HPP
 
+#include <cstdint>
+#include <cstring>
+
 namespace mri {
 
+// Scanners typically export k-space as interleaved (real,imag) pairs of 
+// 32-bit floats or 16-bit integers rather than as complex doubles, along 
+// with a scale factor for each plane. Such files are read at their native 
+// size into the front of the local buffer and then widened in place.
+enum KSpaceSampleType
+{
+    KSPACE_COMPLEX_FLOAT64=0,
+    KSPACE_COMPLEX_FLOAT32,
+    KSPACE_COMPLEX_INT16,
+    KSpaceSampleType_MAX // for validation
+};
+
+namespace load_data {
+
+inline int SampleSize( KSpaceSampleType sampleType )
+{
+    switch( sampleType )
+    {
+    case KSPACE_COMPLEX_FLOAT64: return 2*sizeof(double);
+    case KSPACE_COMPLEX_FLOAT32: return 2*sizeof(float);
+    case KSPACE_COMPLEX_INT16:   return 2*sizeof(std::int16_t);
+    default: LogicError("Invalid k-space sample type"); return 0;
+    }
+}
+
+// Widen the first n samples of buffer into n complex doubles, in place. 
+// Sample k occupies bytes [k*size,(k+1)*size), where size is at most 16, so
+// filling the entries from the back only overwrites samples which have 
+// already been consumed.
+template<typename F>
+inline void
+Widen( Complex<double>* buffer, std::size_t n, double scale )
+{
+    DEBUG_ONLY(CallStackEntry cse("load_data::Widen"))
+    const char* samples = reinterpret_cast<const char*>(buffer);
+    for( std::size_t k=n; k>0; --k )
+    {
+        F pair[2];
+        std::memcpy( pair, &samples[(k-1)*sizeof(pair)], sizeof(pair) );
+        buffer[k-1] = Complex<double>( scale*pair[0], scale*pair[1] );
+    }
+}
+
+} // namespace load_data
+
+// The read is collective over comm (see ReadColumns), and each sample is 
+// multiplied by scale as it is widened
+inline void
+ReadKSpace
+( DistMatrix<Complex<double>,STAR,VR>& data, std::string filename,
+  KSpaceSampleType sampleType, double scale, mpi::Comm comm )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("ReadKSpace");
+        if( data.Height() > 0 && data.LDim() != data.Height() )
+            LogicError("Local columns are not contiguous");
+    )
+    const int sampleSize = load_data::SampleSize( sampleType );
+    parallel_read::ReadStridedColumns
+    ( filename, comm, MPI_Offset(data.Height())*sampleSize, data.Width(),
+      data.RowShift(), data.RowStride(), data.LocalWidth(), data.Buffer() );
+
+    const std::size_t n = std::size_t(data.Height())*data.LocalWidth();
+    if( sampleType == KSPACE_COMPLEX_FLOAT32 )
+        load_data::Widen<float>( data.Buffer(), n, scale );
+    else if( sampleType == KSPACE_COMPLEX_INT16 )
+        load_data::Widen<std::int16_t>( data.Buffer(), n, scale );
+    else if( scale != 1. )
+    {
+        Complex<double>* buffer = data.Buffer();
+        for( std::size_t k=0; k<n; ++k )
+            buffer[k] *= scale;
+    }
+}
+
+inline void
+ReadKSpace
+( DistMatrix<Complex<double>,STAR,VR>& data, std::string filename,
+  KSpaceSampleType sampleType=KSPACE_COMPLEX_FLOAT64, double scale=1. )
+{
+    DEBUG_ONLY(CallStackEntry cse("ReadKSpace"))
+    ReadKSpace( data, filename, sampleType, scale, data.RowComm() );
+}
+
 inline void
 LoadData
 ( int numNonUniform, int numCoils, int numTimesteps,
-  std::string filename, DistMatrix<Complex<double>,STAR,VR>& data )
+  std::string filename, DistMatrix<Complex<double>,STAR,VR>& data,
+  KSpaceSampleType sampleType=KSPACE_COMPLEX_FLOAT64, double scale=1. )
 {
     DEBUG_ONLY(CallStackEntry cse("LoadData"))
     const int m = numNonUniform;
     const int n = numCoils*numTimesteps;
     data.Resize( m, n );
-    El::Read( data, filename, BINARY_FLAT );
+    ReadKSpace( data, filename, sampleType, scale );
+}
+
+// The data is always widened to double precision before conversion
+template<typename Real>
+inline void
+LoadData
+( int numNonUniform, int numCoils, int numTimesteps,
+  std::string filename, DistMatrix<Complex<Real>,STAR,VR>& data,
+  KSpaceSampleType sampleType=KSPACE_COMPLEX_FLOAT64, double scale=1. )
+{
+    DEBUG_ONLY(CallStackEntry cse("LoadData"))
+    DistMatrix<Complex<double>,STAR,VR> dataDouble( data.Grid() );
+    LoadData
+    ( numNonUniform, numCoils, numTimesteps, filename, dataDouble, 
+      sampleType, scale );
+    Convert( dataDouble, data );
 }
 
 } // namespace mri
@@ -32,7 +32,7 @@ LoadDensity
     const int m = numNonUniform;
     const int n = numTimesteps;
     density.Resize( m, n );
-    El::Read( density, filename, BINARY_FLAT );
+    ReadReplicated( density, filename );
 }
 
 } // namespace mri
@@ -32,7 +32,7 @@ LoadPaths
     const int m = 2*numNonUniform;
     const int n = numTimesteps;
     paths.Resize( m, n );
-    El::Read( paths, filename, BINARY_FLAT );
+    ReadReplicated( paths, filename );
 }
 
 } // namespace mri
@@ -32,7 +32,7 @@ LoadSensitivity
     const int m = N0*N1;
     const int n = numCoils;
     sensitivity.Resize( m, n );
-    El::Read( sensitivity, filename, BINARY_FLAT );
+    ReadReplicated( sensitivity, filename );
 }
 
 } // namespace mri
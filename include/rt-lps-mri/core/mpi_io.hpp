@@ -0,0 +1,58 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#ifndef RTLPSMRI_CORE_MPIIO_HPP
+#define RTLPSMRI_CORE_MPIIO_HPP
+
+namespace mri {
+
+// MPI files default to MPI_ERRORS_RETURN, so an I/O call which fails (or 
+// transfers less than requested, e.g., on a full disk) does not abort. Each
+// call is instead checked with Completed, and the outcome of a collective 
+// read or write is agreed upon with AgreeOnSuccess, so that every process 
+// throws together rather than only some of them.
+
+namespace mpi_io {
+
+// Whether an MPI-IO call returned MPI_SUCCESS and transferred exactly count
+// elements of the given datatype
+inline bool
+Completed( int error, MPI_Status& status, MPI_Datatype type, int count )
+{
+    int transferred;
+    return error == MPI_SUCCESS &&
+           MPI_Get_count( &status, type, &transferred ) == MPI_SUCCESS &&
+           transferred == count;
+}
+
+// Returns whether success held on every process of comm
+inline bool
+AgreeOnSuccess( bool success, MPI_Comm comm )
+{
+    int allSuccess = success;
+    MPI_Allreduce( MPI_IN_PLACE, &allSuccess, 1, MPI_INT, MPI_MIN, comm );
+    return allSuccess;
+}
+
+} // namespace mpi_io
+
+} // namespace mri
+
+#endif // ifndef RTLPSMRI_CORE_MPIIO_HPP
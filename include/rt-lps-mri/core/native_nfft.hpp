@@ -0,0 +1,306 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#ifndef RTLPSMRI_CORE_NATIVE_NFFT_HPP
+#define RTLPSMRI_CORE_NATIVE_NFFT_HPP
+
+namespace mri {
+
+// An in-tree alternative to NFFT3's trafo/adjoint which applies each 
+// timestep's gridding matrix (see GriddingMatrix) to the interleaved 
+// oversampled grids of all of the local coils of the timestep (in the same 
+// layout as CoilBatchedNFFT2D). Since the weights are real, the grids are 
+// treated as arrays of 2*b reals per grid point so that each gridding 
+// weight is applied with a single contiguous multiply-add over all of the 
+// coils. The deapodization weights include the normalization, so no 
+// additional scaling pass is required.
+//
+// Unlike the NFFT3 paths, the native engine can also run entirely in single
+// precision (with single-precision grids, weights, and FFTW plans).
+
+namespace native_nfft {
+
+inline const double* 
+Weights( const GriddingMatrix& A, double )
+{ return A.weights.data(); }
+
+inline const float* 
+Weights( const GriddingMatrix& A, float )
+{ return A.singleWeights.data(); }
+
+// acc[l] := sum_{e in row r} w_e G[i_e*2b+l], l in [0,2b)
+template<typename Real>
+inline void
+InterpolateRow
+( const GriddingMatrix& A, int r, int b, const Real* G, Real* acc )
+{
+    const int twoB = 2*b;
+    for( int l=0; l<twoB; ++l )
+        acc[l] = 0;
+    const int* indices = A.indices.data();
+    const Real* weights = Weights( A, Real(0) );
+    const int entryEnd = A.offsets[r+1];
+    for( int e=A.offsets[r]; e<entryEnd; ++e )
+    {
+        const Real w = weights[e];
+        const Real* gEntry = &G[indices[e]*twoB];
+        RTLPSMRI_SIMD
+        for( int l=0; l<twoB; ++l )
+            acc[l] += w*gEntry[l];
+    }
+}
+
+// G[i_e*2b+l] += w_e acc[l], l in [0,2b), for each entry e of row r
+template<typename Real>
+inline void
+SpreadRow
+( const GriddingMatrix& A, int r, int b, const Real* acc, Real* G )
+{
+    const int twoB = 2*b;
+    const int* indices = A.indices.data();
+    const Real* weights = Weights( A, Real(0) );
+    const int entryEnd = A.offsets[r+1];
+    for( int e=A.offsets[r]; e<entryEnd; ++e )
+    {
+        const Real w = weights[e];
+        Real* gEntry = &G[indices[e]*twoB];
+        RTLPSMRI_SIMD
+        for( int l=0; l<twoB; ++l )
+            gEntry[l] += w*acc[l];
+    }
+}
+
+} // namespace native_nfft
+
+// Transform the local columns [jLocBeg,jLocEnd) of FHat into those of F,
+// which must already be sized and aligned with FHat
+template<typename Real>
+inline void
+NativeNFFT2D
+( const DistMatrix<Complex<Real>,STAR,VR>& FHat, 
+        DistMatrix<Complex<Real>,STAR,VR>& F, int jLocBeg, int jLocEnd )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("NativeNFFT2D");
+        if( !InitializedGridding() )
+            LogicError("Native gridding was not initialized");
+    )
+    typedef Complex<Real> C;
+    typedef FFTW<Real> fft;
+    const int numNonUniform = NumNonUniformPoints();
+    const int numPixels = FHat.Height();
+    const int nTotal = FirstFFTSize()*SecondFFTSize();
+    const int numCoils = NumCoils();
+    std::vector<int> timesteps, offsets;
+    coil_batch::TimestepGroups
+    ( jLocBeg, jLocEnd, F.RowShift(), F.RowStride(), numCoils, 
+      timesteps, offsets );
+    const int numGroups = timesteps.size();
+    ReserveCoilBatches( coil_batch::MaxGroupSize(offsets) );
+
+    const int numThreads = NumNFFTThreads();
+    const int* gridIndices = GriddingIndices().data();
+    const double* deapod = Deapodization().data();
+    const C* FHatBuf = FHat.LockedBuffer();
+    C* FBuf = F.Buffer();
+    const int FHatLDim = FHat.LDim();
+    const int FLDim = F.LDim();
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp parallel num_threads(numThreads)
+#endif
+    {
+#ifdef RTLPSMRI_HAVE_OPENMP
+        const int thread = omp_get_thread_num();
+#else
+        const int thread = 0;
+#endif
+        typename fft::complex* gridBuf = CoilBatchGrid<Real>( thread );
+        C* G = reinterpret_cast<C*>(gridBuf);
+        std::vector<Real> acc;
+#ifdef RTLPSMRI_HAVE_OPENMP
+        #pragma omp for schedule(dynamic)
+#endif
+        for( int g=0; g<numGroups; ++g )
+        {
+            const int jLocBeg = offsets[g];
+            const int b = offsets[g+1] - jLocBeg;
+            const GriddingMatrix& A = 
+                Gridding( PathOfTimestep(timesteps[g]) );
+            const C* fHats = &FHatBuf[jLocBeg*FHatLDim];
+                  C* fs    = &FBuf[jLocBeg*FLDim];
+
+            // Deapodize and zero-pad each coil's image into its grid
+            El::MemZero( G, nTotal*b );
+            for( int i=0; i<numPixels; ++i )
+            {
+                const Real w = deapod[i];
+                C* gEntry = &G[gridIndices[i]*b];
+                for( int k=0; k<b; ++k )
+                    gEntry[k] = w*fHats[i+k*FHatLDim];
+            }
+
+            fft::execute_dft
+            ( CoilBatchPlan<Real>( b, FFTW_FORWARD ), gridBuf, gridBuf );
+
+            // Interpolate each node from the grids of all of the coils
+            acc.resize( 2*b );
+            const Real* GReal = reinterpret_cast<const Real*>(G);
+            for( int r=0; r<numNonUniform; ++r )
+            {
+                native_nfft::InterpolateRow( A, r, b, GReal, acc.data() );
+                const int i = A.nodes[r];
+                for( int k=0; k<b; ++k )
+                    fs[i+k*FLDim] = C(acc[2*k],acc[2*k+1]);
+            }
+        }
+    }
+}
+
+template<typename Real>
+inline void
+NativeNFFT2D
+( const DistMatrix<Complex<Real>,STAR,VR>& FHat, 
+        DistMatrix<Complex<Real>,STAR,VR>& F )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("NativeNFFT2D");
+        if( !InitializedGridding() )
+            LogicError("Native gridding was not initialized");
+        if( FHat.Width() % (NumCoils()*NumTimesteps()) != 0 )
+            LogicError("Invalid width");
+        if( FHat.Height() != FirstBandwidth()*SecondBandwidth() )
+            LogicError("Invalid FHat height");
+    )
+    F.AlignWith( FHat );
+    F.Resize( NumNonUniformPoints(), FHat.Width() );
+    NativeNFFT2D( FHat, F, 0, F.LocalWidth() );
+}
+
+// Transform the local columns [jLocBeg,jLocEnd) of F into those of FHat,
+// which must already be sized and aligned with F
+template<typename Real>
+inline void
+NativeAdjointNFFT2D
+( const DistMatrix<Complex<Real>,STAR,VR>& F,
+        DistMatrix<Complex<Real>,STAR,VR>& FHat, int jLocBeg, int jLocEnd )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("NativeAdjointNFFT2D");
+        if( !InitializedGridding() )
+            LogicError("Native gridding was not initialized");
+    )
+    typedef Complex<Real> C;
+    typedef FFTW<Real> fft;
+    const int numNonUniform = NumNonUniformPoints();
+    const int numPixels = FirstBandwidth()*SecondBandwidth();
+    const int nTotal = FirstFFTSize()*SecondFFTSize();
+    const int numCoils = NumCoils();
+    std::vector<int> timesteps, offsets;
+    coil_batch::TimestepGroups
+    ( jLocBeg, jLocEnd, F.RowShift(), F.RowStride(), numCoils, 
+      timesteps, offsets );
+    const int numGroups = timesteps.size();
+    ReserveCoilBatches( coil_batch::MaxGroupSize(offsets) );
+
+    const int numThreads = NumNFFTThreads();
+    const int* gridIndices = GriddingIndices().data();
+    const double* deapod = Deapodization().data();
+    const C* FBuf = F.LockedBuffer();
+    C* FHatBuf = FHat.Buffer();
+    const int FLDim = F.LDim();
+    const int FHatLDim = FHat.LDim();
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp parallel num_threads(numThreads)
+#endif
+    {
+#ifdef RTLPSMRI_HAVE_OPENMP
+        const int thread = omp_get_thread_num();
+#else
+        const int thread = 0;
+#endif
+        typename fft::complex* gridBuf = CoilBatchGrid<Real>( thread );
+        C* G = reinterpret_cast<C*>(gridBuf);
+        std::vector<Real> acc;
+#ifdef RTLPSMRI_HAVE_OPENMP
+        #pragma omp for schedule(dynamic)
+#endif
+        for( int g=0; g<numGroups; ++g )
+        {
+            const int jLocBeg = offsets[g];
+            const int b = offsets[g+1] - jLocBeg;
+            const GriddingMatrix& A = 
+                Gridding( PathOfTimestep(timesteps[g]) );
+            const C* fs    = &FBuf[jLocBeg*FLDim];
+                  C* fHats = &FHatBuf[jLocBeg*FHatLDim];
+
+            // Spread each node onto the grids of all of the coils
+            El::MemZero( G, nTotal*b );
+            acc.resize( 2*b );
+            Real* GReal = reinterpret_cast<Real*>(G);
+            for( int r=0; r<numNonUniform; ++r )
+            {
+                const int i = A.nodes[r];
+                for( int k=0; k<b; ++k )
+                {
+                    const C value = fs[i+k*FLDim];
+                    acc[2*k]   = value.real();
+                    acc[2*k+1] = value.imag();
+                }
+                native_nfft::SpreadRow( A, r, b, acc.data(), GReal );
+            }
+
+            fft::execute_dft
+            ( CoilBatchPlan<Real>( b, FFTW_BACKWARD ), gridBuf, gridBuf );
+
+            // Truncate and deapodize each coil's grid into its image
+            for( int i=0; i<numPixels; ++i )
+            {
+                const Real w = deapod[i];
+                const C* gEntry = &G[gridIndices[i]*b];
+                for( int k=0; k<b; ++k )
+                    fHats[i+k*FHatLDim] = w*gEntry[k];
+            }
+        }
+    }
+}
+
+template<typename Real>
+inline void
+NativeAdjointNFFT2D
+( const DistMatrix<Complex<Real>,STAR,VR>& F,
+        DistMatrix<Complex<Real>,STAR,VR>& FHat )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("NativeAdjointNFFT2D");
+        if( !InitializedGridding() )
+            LogicError("Native gridding was not initialized");
+        if( F.Width() % (NumCoils()*NumTimesteps()) != 0 )
+            LogicError("Invalid width");
+        if( F.Height() != NumNonUniformPoints() )
+            LogicError("Invalid F height");
+    )
+    FHat.AlignWith( F );
+    FHat.Resize( FirstBandwidth()*SecondBandwidth(), F.Width() );
+    NativeAdjointNFFT2D( F, FHat, 0, F.LocalWidth() );
+}
+
+} // namespace mri
+
+#endif // ifndef RTLPSMRI_CORE_NATIVE_NFFT_HPP
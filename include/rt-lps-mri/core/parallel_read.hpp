@@ -0,0 +1,204 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#ifndef RTLPSMRI_CORE_PARALLELREAD_HPP
+#define RTLPSMRI_CORE_PARALLELREAD_HPP
+
+namespace mri {
+
+// The inputs are stored as flat column-major binary files (El's BINARY_FLAT
+// format). Rather than funneling each file through El::Read, a [STAR,VR] 
+// matrix is read with a single collective MPI-IO call in which each process
+// requests exactly the columns it owns, straight into its local buffer, and
+// a replicated [STAR,STAR] matrix is read once per node (or once overall, 
+// without MPI-3) and then broadcast.
+
+namespace parallel_read {
+
+// MPI-IO and MPI_Bcast counts are ints, so large transfers are split
+const MPI_Offset MAX_CHUNK_BYTES = MPI_Offset(1) << 30;
+
+// Returns whether all numBytes were read (see mpi_io::Completed)
+inline bool
+ReadBytes( MPI_File fh, MPI_Offset offset, char* buffer, MPI_Offset numBytes )
+{
+    DEBUG_ONLY(CallStackEntry cse("parallel_read::ReadBytes"))
+    for( MPI_Offset done=0; done<numBytes; done+=MAX_CHUNK_BYTES )
+    {
+        const int chunk = std::min( MAX_CHUNK_BYTES, numBytes-done );
+        MPI_Status status;
+        const int error = 
+          MPI_File_read_at
+          ( fh, offset+done, &buffer[done], chunk, MPI_BYTE, &status );
+        if( !mpi_io::Completed( error, status, MPI_BYTE, chunk ) )
+            return false;
+    }
+    return true;
+}
+
+inline void
+BroadcastBytes( char* buffer, MPI_Offset numBytes, MPI_Comm comm )
+{
+    DEBUG_ONLY(CallStackEntry cse("parallel_read::BroadcastBytes"))
+    for( MPI_Offset done=0; done<numBytes; done+=MAX_CHUNK_BYTES )
+    {
+        const int chunk = std::min( MAX_CHUNK_BYTES, numBytes-done );
+        MPI_Bcast( &buffer[done], chunk, MPI_BYTE, 0, comm );
+    }
+}
+
+// Reads every rowStride'th column, starting from column rowShift, of a file
+// holding width columns of colBytes bytes each, into the contiguous buffer.
+// The read is collective over comm.
+inline void
+ReadStridedColumns
+( std::string filename, mpi::Comm comm, MPI_Offset colBytes, int width, 
+  int rowShift, int rowStride, int localWidth, void* buffer )
+{
+    DEBUG_ONLY(CallStackEntry cse("parallel_read::ReadStridedColumns"))
+    const MPI_Offset expectedBytes = colBytes*width;
+    if( colBytes > MAX_CHUNK_BYTES )
+        LogicError("Columns of ",colBytes," bytes are too large");
+
+    MPI_File fh;
+    const int openError = 
+      MPI_File_open
+      ( comm.comm, const_cast<char*>(filename.c_str()), MPI_MODE_RDONLY, 
+        MPI_INFO_NULL, &fh );
+    if( openError != MPI_SUCCESS )
+        RuntimeError("Could not open ",filename);
+    MPI_Offset fileBytes;
+    MPI_File_get_size( fh, &fileBytes );
+    if( fileBytes != expectedBytes )
+    {
+        MPI_File_close( &fh );
+        RuntimeError
+        (filename," has ",fileBytes," bytes rather than ",expectedBytes);
+    }
+
+    MPI_Datatype colType, fileType;
+    MPI_Type_contiguous( int(colBytes), MPI_BYTE, &colType );
+    MPI_Type_commit( &colType );
+    MPI_Type_vector( localWidth, 1, rowStride, colType, &fileType );
+    MPI_Type_commit( &fileType );
+    bool success = 
+      ( MPI_File_set_view
+        ( fh, rowShift*colBytes, colType, fileType, 
+          const_cast<char*>("native"), MPI_INFO_NULL ) == MPI_SUCCESS );
+    MPI_Status status;
+    const int readError = 
+      MPI_File_read_all( fh, buffer, localWidth, colType, &status );
+    success = success && 
+      mpi_io::Completed( readError, status, colType, localWidth );
+    MPI_Type_free( &fileType );
+    MPI_Type_free( &colType );
+    MPI_File_close( &fh );
+
+    // A failed or short read would otherwise leave garbage in the buffer
+    if( !mpi_io::AgreeOnSuccess( success, comm.comm ) )
+        RuntimeError("Could not read the columns of ",filename);
+}
+
+} // namespace parallel_read
+
+// The read is collective over comm, which defaults to A.RowComm() but can be
+// any communicator over the same processes (e.g., a duplicate, so that a 
+// background read cannot interleave with collectives on the original).
+// Each process views the file as every RowStride()'th column, starting from
+// column RowShift(), and reads straight into its local buffer.
+template<typename T>
+inline void
+ReadColumns( DistMatrix<T,STAR,VR>& A, std::string filename, mpi::Comm comm )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("ReadColumns");
+        if( A.Height() > 0 && A.LDim() != A.Height() )
+            LogicError("Local columns are not contiguous");
+    )
+    parallel_read::ReadStridedColumns
+    ( filename, comm, MPI_Offset(A.Height())*sizeof(T), A.Width(), 
+      A.RowShift(), A.RowStride(), A.LocalWidth(), A.Buffer() );
+}
+
+template<typename T>
+inline void
+ReadColumns( DistMatrix<T,STAR,VR>& A, std::string filename )
+{
+    DEBUG_ONLY(CallStackEntry cse("ReadColumns"))
+    ReadColumns( A, filename, A.RowComm() );
+}
+
+template<typename T>
+inline void
+ReadReplicated( DistMatrix<T,STAR,STAR>& A, std::string filename )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("ReadReplicated");
+        if( A.Height() > 0 && A.LDim() != A.Height() )
+            LogicError("Local columns are not contiguous");
+    )
+    const MPI_Offset expectedBytes = 
+        MPI_Offset(A.Height())*A.Width()*sizeof(T);
+    MPI_Comm comm = A.Grid().Comm().comm;
+    MPI_Comm nodeComm;
+#ifdef RTLPSMRI_HAVE_MPI3
+    MPI_Comm_split_type
+    ( comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &nodeComm );
+#else
+    MPI_Comm_dup( comm, &nodeComm );
+#endif
+    int nodeRank;
+    MPI_Comm_rank( nodeComm, &nodeRank );
+    char* buffer = reinterpret_cast<char*>(A.Buffer());
+
+    // The reader of each node checks the size before reading (and the read
+    // itself), and the processes only proceed if every reader succeeded
+    MPI_Offset fileBytes = -1;
+    bool readBytes = false;
+    if( nodeRank == 0 )
+    {
+        MPI_File fh;
+        const int openError = 
+          MPI_File_open
+          ( MPI_COMM_SELF, const_cast<char*>(filename.c_str()), 
+            MPI_MODE_RDONLY, MPI_INFO_NULL, &fh );
+        if( openError == MPI_SUCCESS )
+        {
+            MPI_File_get_size( fh, &fileBytes );
+            if( fileBytes == expectedBytes )
+                readBytes = 
+                  parallel_read::ReadBytes( fh, 0, buffer, expectedBytes );
+            MPI_File_close( &fh );
+        }
+    }
+    int success = ( nodeRank != 0 || readBytes );
+    MPI_Allreduce( MPI_IN_PLACE, &success, 1, MPI_INT, MPI_MIN, comm );
+    if( !success )
+    {
+        MPI_Comm_free( &nodeComm );
+        RuntimeError("Could not read ",expectedBytes," bytes from ",filename);
+    }
+    parallel_read::BroadcastBytes( buffer, expectedBytes, nodeComm );
+    MPI_Comm_free( &nodeComm );
+}
+
+} // namespace mri
+
+#endif // ifndef RTLPSMRI_CORE_PARALLELREAD_HPP
@@ -0,0 +1,82 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#ifndef RTLPSMRI_CORE_REPLICATEDEIG_HPP
+#define RTLPSMRI_CORE_REPLICATEDEIG_HPP
+
+namespace mri {
+
+// The eigendecomposition of a small Hermitian matrix G which is replicated 
+// over comm (e.g., a Gram matrix formed by an allreduce). Even with identical
+// inputs, separate LAPACK calls are not guaranteed to agree bitwise (e.g., 
+// with threaded BLAS), and a disagreement in a rank cut-off or in the phase
+// of an eigenvector would silently corrupt anything formed from w and V on 
+// each process, so the decomposition is computed on the root and broadcast.
+// The eigenvalues are returned in descending order. G is overwritten.
+template<typename Real>
+inline void
+ReplicatedHermitianEig
+( Matrix<Complex<Real>>& G, Matrix<Real>& w, Matrix<Complex<Real>>& V,
+  mpi::Comm comm )
+{
+    DEBUG_ONLY(CallStackEntry cse("ReplicatedHermitianEig"))
+    typedef Complex<Real> F;
+    const int n = G.Height();
+
+    // Pack [w, V] into a single buffer so that one broadcast suffices
+    std::vector<F> packed( n+n*n );
+    if( mpi::Rank(comm) == 0 )
+    {
+        El::HermitianEig( LOWER, G, w, V, DESCENDING );
+        for( int i=0; i<n; ++i )
+            packed[i] = w.Get(i,0);
+        for( int j=0; j<n; ++j )
+            El::MemCopy( &packed[n+j*n], V.LockedBuffer(0,j), n );
+    }
+    mpi::Broadcast( packed.data(), n+n*n, 0, comm );
+    w.Resize( n, 1 );
+    V.Resize( n, n );
+    for( int i=0; i<n; ++i )
+        w.Set( i, 0, RealPart(packed[i]) );
+    for( int j=0; j<n; ++j )
+        El::MemCopy( V.Buffer(0,j), &packed[n+j*n], n );
+}
+
+// The number of eigenvalues returned by ReplicatedHermitianEig (for a Gram 
+// matrix) which are above the n eps w(0) cut-off relative to the largest. 
+// Since w is identical on every process, so is the result.
+template<typename Real>
+inline int
+NumericalRank( const Matrix<Real>& w )
+{
+    DEBUG_ONLY(CallStackEntry cse("NumericalRank"))
+    const int n = w.Height();
+    if( n == 0 )
+        return 0;
+    const Real tol = n*lapack::MachineEpsilon<Real>()*w.Get(0,0);
+    int rank = 0;
+    while( rank < n && w.Get(rank,0) > tol )
+        ++rank;
+    return rank;
+}
+
+} // namespace mri
+
+#endif // ifndef RTLPSMRI_CORE_REPLICATEDEIG_HPP
@@ -23,83 +23,82 @@
 
 namespace mri {
 
-// TODO: Decide how to avoid horrendous non-unit stride access...
+// Each local row of an image x time matrix is transformed along time. Rather
+// than copying each row into a contiguous buffer, the local rows are split
+// into blocks, and each block is transformed in place by a single cached FFTW
+// plan which strides by the leading dimension. The 1/sqrt(nt) normalization
+// is applied to each block immediately after its transform, while the block 
+// is still in cache, and the blocks are distributed over the NFFT threads.
 
-// TODO: Decide how to multithread embarrassingly parallel local transforms
+namespace temporal_fft {
 
+template<typename Real>
 inline void
-TemporalFFT( DistMatrix<Complex<double>,VC,STAR>& A )
+Transform( DistMatrix<Complex<Real>,VC,STAR>& A, int sign )
 {
-    DEBUG_ONLY(
-        CallStackEntry cse("TemporalFFT");
-        if( A.Width() != NumTimesteps() )
-            LogicError("Wrong number of timesteps");
-    )
+    DEBUG_ONLY(CallStackEntry cse("temporal_fft::Transform"))
+    typedef FFTW<Real> fft;
     const int numTimesteps = A.Width();
-    fftw_complex* buf = 
-        (fftw_complex*)fftw_malloc(numTimesteps*sizeof(fftw_complex));
-    fftw_plan p = 
-        fftw_plan_dft_1d( numTimesteps, buf, buf, FFTW_FORWARD, FFTW_ESTIMATE );
-    
-    const int numLocFFTs = A.LocalHeight();
-    Complex<double>* ABuf = A.Buffer();
+    const int localHeight = A.LocalHeight();
     const int ldim = A.LDim();
-    for( int k=0; k<numLocFFTs; ++k )
+    if( localHeight == 0 || numTimesteps == 0 )
+        return;
+
+    const int maxBlockHeight = 64;
+    const int blockHeight = std::min( localHeight, maxBlockHeight );
+    const int numBlocks = (localHeight+blockHeight-1) / blockHeight;
+    const int lastHeight = localHeight - (numBlocks-1)*blockHeight;
+    const auto plan = 
+        TemporalPlan<Real>( numTimesteps, blockHeight, ldim, sign );
+    const auto lastPlan = 
+        TemporalPlan<Real>( numTimesteps, lastHeight, ldim, sign );
+
+    const Real scale = 1/Sqrt(Real(numTimesteps));
+    const int numThreads = NumNFFTThreads();
+    Complex<Real>* ABuf = A.Buffer();
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp parallel for schedule(static) num_threads(numThreads)
+#endif
+    for( int b=0; b<numBlocks; ++b )
     {
-        // Copy in data   
-        for( int i=0; i<numTimesteps; ++i )
-            std::memcpy( &buf[i], &ABuf[k+i*ldim], sizeof(fftw_complex) );
-
-        // Run the transform
-        fftw_execute(p);
-
-        // Copy out data
-        for( int i=0; i<numTimesteps; ++i )
-            std::memcpy( &ABuf[k+i*ldim], &buf[i], sizeof(fftw_complex) );
+        const bool last = ( b == numBlocks-1 );
+        const int height = ( last ? lastHeight : blockHeight );
+        Complex<Real>* block = &ABuf[b*blockHeight];
+        auto* blockData = reinterpret_cast<typename fft::complex*>(block);
+        fft::execute_dft( last ? lastPlan : plan, blockData, blockData );
+        for( int t=0; t<numTimesteps; ++t )
+        {
+            Complex<Real>* blockCol = &block[t*ldim];
+            for( int i=0; i<height; ++i )
+                blockCol[i] *= scale;
+        }
     }
+}
 
-    fftw_free( buf );
+} // namespace temporal_fft
 
-    const double scale = 1./Sqrt(double(numTimesteps));
-    Scale( scale, A );
+template<typename Real>
+inline void
+TemporalFFT( DistMatrix<Complex<Real>,VC,STAR>& A )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("TemporalFFT");
+        if( A.Width() != NumTimesteps() )
+            LogicError("Wrong number of timesteps");
+    )
+    temporal_fft::Transform( A, FFTW_FORWARD );
 }
 
+template<typename Real>
 inline void
-TemporalAdjointFFT( DistMatrix<Complex<double>,VC,STAR>& A )
+TemporalAdjointFFT( DistMatrix<Complex<Real>,VC,STAR>& A )
 {
     DEBUG_ONLY(
         CallStackEntry cse("TemporalAdjointFFT");
         if( A.Width() != NumTimesteps() )
             LogicError("Wrong number of timesteps");
     )
-    const int numTimesteps = A.Width();
-    fftw_complex* buf = 
-        (fftw_complex*)fftw_malloc(numTimesteps*sizeof(fftw_complex));
-    fftw_plan p = 
-        fftw_plan_dft_1d
-        ( numTimesteps, buf, buf, FFTW_BACKWARD, FFTW_ESTIMATE );
-    
-    const int numLocFFTs = A.LocalHeight();
-    Complex<double>* ABuf = A.Buffer();
-    const int ldim = A.LDim();
-    for( int k=0; k<numLocFFTs; ++k )
-    {
-        // Copy in data   
-        for( int i=0; i<numTimesteps; ++i )
-            std::memcpy( &buf[i], &ABuf[k+i*ldim], sizeof(fftw_complex) );
-
-        // Run the transform
-        fftw_execute(p);
-
-        // Copy out data
-        for( int i=0; i<numTimesteps; ++i )
-            std::memcpy( &ABuf[k+i*ldim], &buf[i], sizeof(fftw_complex) );
-    }
-
-    fftw_free( buf );
-
-    const double scale = 1./Sqrt(double(numTimesteps));
-    Scale( scale, A );
+    temporal_fft::Transform( A, FFTW_BACKWARD );
 }
 
 } // namespace mri
@@ -0,0 +1,171 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#ifndef RTLPSMRI_CORE_WORKSPACE_HPP
+#define RTLPSMRI_CORE_WORKSPACE_HPP
+
+namespace mri {
+
+// Each application of the acquisition operator, its adjoint, or the normal
+// operator requires several temporaries with (up to) one column per 
+// (coil,time) pair. Rather than allocating and freeing them during every 
+// application, they can be held by a workspace which is passed into 
+// Acquisition, AdjointAcquisition, and NormalAcquisition. Since the forward 
+// and adjoint applications never overlap, they share their buffers.
+//
+// The buffers grow to the sizes they are used at, and Reserve can be used to
+// size them all up front (from NumCoils(), NumTimesteps(), etc., and the 
+// number of planes whose timesteps are stacked side by side).
+template<typename Real>
+struct AcquisitionWorkspace
+{
+    // N0*N1 x (numCoils*numTimesteps)
+    DistMatrix<Complex<Real>,STAR,VR> coilImages_STAR_VR;
+
+    // numNonUniform x (numCoils*numTimesteps)
+    DistMatrix<Complex<Real>,STAR,VR> kSpace_STAR_VR;
+
+    // N0*N1 x numTimesteps (only used by NormalAcquisition)
+    DistMatrix<Complex<Real>,STAR,VR> frames_STAR_VR, normalFrames_STAR_VR;
+
+    // The packed all-to-all buffers of ScatterAndScale and 
+    // PrescaleAndContract (the second pair is only used by the pipelined 
+    // operators, which keep two chunks in flight), and the (full or partial)
+    // images of the timesteps with a locally-owned (coil,time) column
+    std::vector<Complex<Real>> sendBuffers[2], recvBuffers[2];
+    Matrix<Complex<Real>> localFrames;
+
+    AcquisitionWorkspace( const El::Grid& grid=El::DefaultGrid() )
+    : coilImages_STAR_VR(grid), kSpace_STAR_VR(grid), frames_STAR_VR(grid),
+      normalFrames_STAR_VR(grid)
+    { }
+
+    const El::Grid& Grid() const { return coilImages_STAR_VR.Grid(); }
+
+    // Rebinding to a different grid releases the buffers
+    void SetGrid( const El::Grid& grid )
+    {
+        if( &grid == &Grid() )
+            return;
+        coilImages_STAR_VR.SetGrid( grid );
+        kSpace_STAR_VR.SetGrid( grid );
+        frames_STAR_VR.SetGrid( grid );
+        normalFrames_STAR_VR.SetGrid( grid );
+    }
+
+    void Reserve( int numPlanes=1 )
+    {
+        DEBUG_ONLY(CallStackEntry cse("AcquisitionWorkspace::Reserve"))
+        const int numPixels = FirstBandwidth()*SecondBandwidth();
+        const int numTimesteps = numPlanes*NumTimesteps();
+        const int width = NumCoils()*numTimesteps;
+        coilImages_STAR_VR.Resize( numPixels, width );
+        kSpace_STAR_VR.Resize( NumNonUniformPoints(), width );
+        if( InitializedNormalKernels() )
+        {
+            frames_STAR_VR.Resize( numPixels, numTimesteps );
+            normalFrames_STAR_VR.Resize( numPixels, numTimesteps );
+        }
+    }
+};
+
+// The image x time temporaries of the L+S iteration, along with the workspace
+// for the acquisition operator. A single workspace can be reused for each of
+// the planes processed on a given grid.
+template<typename Real>
+struct LPSWorkspace
+{
+    AcquisitionWorkspace<Real> acquisition;
+
+    // N0*N1 x numTimesteps
+    DistMatrix<Complex<Real>,VC,STAR> M, M0, LPlusS, ED;
+
+    // N0*N1 x (numTimesteps-1), with one such block per stacked plane
+    DistMatrix<Complex<Real>,VC,STAR> Z;
+
+    // numNonUniform x (numCoils*numTimesteps)
+    DistMatrix<Complex<Real>,STAR,VR> R;
+
+    // N0*N1 x numTimesteps (only used by the accelerated solver)
+    DistMatrix<Complex<Real>,VC,STAR> LPrev, SPrev, SBar;
+
+    // N0*N1 x (rank+oversample) sample of the range of L, and the (redundant)
+    // right singular subspace used to warm-start PartialSVT
+    DistMatrix<Complex<Real>,VC,STAR> svtRange;
+    Matrix<Complex<Real>> svtV;
+
+    // Whether M already holds E'D for the data about to be passed into LPS
+    // (see SeedFromNeighbor)
+    bool haveAdjointData;
+
+    LPSWorkspace( const El::Grid& grid=El::DefaultGrid() )
+    : acquisition(grid), M(grid), M0(grid), LPlusS(grid), ED(grid), Z(grid),
+      R(grid), LPrev(grid), SPrev(grid), SBar(grid), svtRange(grid),
+      haveAdjointData(false)
+    { }
+
+    const El::Grid& Grid() const { return M.Grid(); }
+
+    // Rebinding to a different grid releases the buffers
+    void SetGrid( const El::Grid& grid )
+    {
+        if( &grid == &Grid() )
+            return;
+        acquisition.SetGrid( grid );
+        haveAdjointData = false;
+        M.SetGrid( grid );
+        M0.SetGrid( grid );
+        LPlusS.SetGrid( grid );
+        ED.SetGrid( grid );
+        Z.SetGrid( grid );
+        R.SetGrid( grid );
+        LPrev.SetGrid( grid );
+        SPrev.SetGrid( grid );
+        SBar.SetGrid( grid );
+        svtRange.SetGrid( grid );
+    }
+
+    void Reserve( bool tv=true, bool accelerated=false, int numPlanes=1 )
+    {
+        DEBUG_ONLY(CallStackEntry cse("LPSWorkspace::Reserve"))
+        acquisition.Reserve( numPlanes );
+        const int numPixels = FirstBandwidth()*SecondBandwidth();
+        const int numTimesteps = numPlanes*NumTimesteps();
+        M.Resize( numPixels, numTimesteps );
+        M0.Resize( numPixels, numTimesteps );
+        LPlusS.Resize( numPixels, numTimesteps );
+        if( tv )
+            Z.Resize( numPixels, numTimesteps-numPlanes );
+        if( InitializedNormalKernels() )
+            ED.Resize( numPixels, numTimesteps );
+        else
+            R.Resize( NumNonUniformPoints(), NumCoils()*numTimesteps );
+        if( accelerated )
+        {
+            LPrev.Resize( numPixels, numTimesteps );
+            SPrev.Resize( numPixels, numTimesteps );
+            SBar.Resize( numPixels, numTimesteps );
+        }
+    }
+};
+
+} // namespace mri
+
+#endif // ifndef RTLPSMRI_CORE_WORKSPACE_HPP
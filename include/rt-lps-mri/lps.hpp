@@ -25,71 +25,553 @@ namespace mri {
 
 namespace lps {
 
+// The TV clipping kernel operates directly on the local column buffers of the
+// [VC,STAR] matrices (so that each column is streamed with unit stride), 
+// compares squared magnitudes against the squared clipping radius (so that a
+// square root is only needed for the entries which are actually clipped), 
+// and is distributed over the NFFT threads in blocks of local rows.
+
+const int TV_BLOCK_HEIGHT = 256;
+
+// A fused version of 
+//
+//    S := M - L,
+//    Z_j := Clip(Z_j + (S_{j+1}-S_j)/4, clipRadius),
+//    S := S - D' Z, where D is the forward difference in time,
+//
+// which makes a single pass over M, L, S, and Z. Column j of S is finalized 
+// as soon as column j of Z has been updated, since the original value of 
+// S_j is no longer needed at that point.
+//
+// When the timesteps of several planes are stacked side by side, each plane
+// is clipped with its own radius, clipRadii[k], and has its own block of 
+// numTimesteps-1 columns of Z (the differences never cross planes).
+template<typename Real>
 inline void
-UpdateZ
-( double clipRadius,
-  const DistMatrix<Complex<double>,VC,STAR>& S, 
-        DistMatrix<Complex<double>,VC,STAR>& Z )
+SparseTVUpdate
+( const std::vector<Real>& clipRadii,
+  const DistMatrix<Complex<Real>,VC,STAR>& M,
+  const DistMatrix<Complex<Real>,VC,STAR>& L,
+        DistMatrix<Complex<Real>,VC,STAR>& Z,
+        DistMatrix<Complex<Real>,VC,STAR>& S )
 {
-    DEBUG_ONLY(CallStackEntry cse("lps::UpdateZ"))
-    const int numTimesteps = S.Width();
-    const int localHeight = S.LocalHeight();
-    for( int iLoc=0; iLoc<localHeight; ++iLoc )
+    const int numPlanes = clipRadii.size();
+    const int numTimesteps = M.Width() / numPlanes;
+    DEBUG_ONLY(
+        CallStackEntry cse("lps::SparseTVUpdate");
+        if( numTimesteps < 2 )
+            LogicError("TV clipping requires at least two timesteps");
+        if( M.Width() != numPlanes*numTimesteps || 
+            Z.Width() != numPlanes*(numTimesteps-1) )
+            LogicError("Widths are not consistent with the planes");
+    )
+    typedef Complex<Real> F;
+    const int localHeight = M.LocalHeight();
+    S.AlignWith( M );
+    S.Resize( M.Height(), M.Width() );
+    const int MLDim = M.LDim();
+    const int LLDim = L.LDim();
+    const int ZLDim = Z.LDim();
+    const int SLDim = S.LDim();
+    const int numThreads = NumNFFTThreads();
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp parallel for schedule(static) num_threads(numThreads)
+#endif
+    for( int iBeg=0; iBeg<localHeight; iBeg+=TV_BLOCK_HEIGHT )
     {
-        for( int j=0; j<numTimesteps-1; ++j )
+        const int iEnd = std::min( iBeg+TV_BLOCK_HEIGHT, localHeight );
+        for( int k=0; k<numPlanes; ++k )
         {
-            const Complex<double> curr = S.GetLocal(iLoc,j);
-            const Complex<double> next = S.GetLocal(iLoc,j+1);
-            Z.UpdateLocal( iLoc, j, 0.25*(next-curr) ); 
-            // Clip magnitude to be less than or equal to clipRadius
-            const Complex<double> xi = Z.GetLocal(iLoc,j);
-            const double xiAbs = Abs(xi);
-            if( xiAbs > clipRadius )
-                Z.SetLocal( iLoc, j, xi*(clipRadius/xiAbs) );    
+            const Real clipRadius = clipRadii[k];
+            const Real clipRadiusSq = clipRadius*clipRadius;
+            const F* MBuf = M.LockedBuffer(0,k*numTimesteps);
+            const F* LBuf = L.LockedBuffer(0,k*numTimesteps);
+            F* ZBuf = Z.Buffer(0,k*(numTimesteps-1));
+            F* SBuf = S.Buffer(0,k*numTimesteps);
+            {
+                F* sCol = SBuf;
+                RTLPSMRI_SIMD
+                for( int i=iBeg; i<iEnd; ++i )
+                    sCol[i] = MBuf[i] - LBuf[i];
+            }
+            for( int j=0; j<numTimesteps-1; ++j )
+            {
+                const F* mNext = &MBuf[(j+1)*MLDim];
+                const F* lNext = &LBuf[(j+1)*LLDim];
+                F* sCurr = &SBuf[j*SLDim];
+                F* sNext = &SBuf[(j+1)*SLDim];
+                F* zCurr = &ZBuf[j*ZLDim];
+                const F* zPrev = ( j > 0 ? &ZBuf[(j-1)*ZLDim] : 0 );
+                RTLPSMRI_SIMD
+                for( int i=iBeg; i<iEnd; ++i )
+                {
+                    const F s = mNext[i] - lNext[i];
+                    sNext[i] = s;
+                    const F xi = zCurr[i] + Real(0.25)*(s-sCurr[i]);
+                    const Real xiAbsSq = 
+                        xi.real()*xi.real() + xi.imag()*xi.imag();
+                    const F z = 
+                      ( xiAbsSq > clipRadiusSq ? 
+                        xi*(clipRadius/Sqrt(xiAbsSq)) : xi );
+                    zCurr[i] = z;
+                    sCurr[i] += ( zPrev ? z - zPrev[i] : z );
+                }
+            }
+            {
+                F* sCol = &SBuf[(numTimesteps-1)*SLDim];
+                const F* zCol = &ZBuf[(numTimesteps-2)*ZLDim];
+                RTLPSMRI_SIMD
+                for( int i=iBeg; i<iEnd; ++i )
+                    sCol[i] -= zCol[i];
+            }
         }
     }
 }
 
+template<typename Real>
+inline void
+SparseTVUpdate
+( Real clipRadius,
+  const DistMatrix<Complex<Real>,VC,STAR>& M,
+  const DistMatrix<Complex<Real>,VC,STAR>& L,
+        DistMatrix<Complex<Real>,VC,STAR>& Z,
+        DistMatrix<Complex<Real>,VC,STAR>& S )
+{
+    DEBUG_ONLY(CallStackEntry cse("lps::SparseTVUpdate"))
+    const std::vector<Real> clipRadii( 1, clipRadius );
+    SparseTVUpdate( clipRadii, M, L, Z, S );
+}
+
+// The accelerated solver extrapolates the iterates with the momentum 
+// 
+//    Y    := (L+S) + beta ((L+S) - (LPrev+SPrev)),
+//    SBar := S + beta (S - SPrev),
+//
+// where Y is the point at which the data-fidelity gradient is evaluated and 
+// SBar is used in place of S in the next low-rank update.
+template<typename Real>
 inline void
-SubtractAdjDz
-( const DistMatrix<Complex<double>,VC,STAR>& Z,
-        DistMatrix<Complex<double>,VC,STAR>& S )
+Extrapolate
+( Real beta,
+  const DistMatrix<Complex<Real>,VC,STAR>& L,
+  const DistMatrix<Complex<Real>,VC,STAR>& S,
+  const DistMatrix<Complex<Real>,VC,STAR>& LPrev,
+  const DistMatrix<Complex<Real>,VC,STAR>& SPrev,
+        DistMatrix<Complex<Real>,VC,STAR>& Y,
+        DistMatrix<Complex<Real>,VC,STAR>& SBar )
 {
-    DEBUG_ONLY(CallStackEntry cse("lps::SubtractAdjDz"))
-    const int numTimesteps = S.Width();
-    const int localHeight = S.LocalHeight();
-    for( int iLoc=0; iLoc<localHeight; ++iLoc )
+    DEBUG_ONLY(CallStackEntry cse("lps::Extrapolate"))
+    typedef Complex<Real> F;
+    const int numTimesteps = L.Width();
+    const int localHeight = L.LocalHeight();
+    Y.AlignWith( L );
+    SBar.AlignWith( L );
+    Y.Resize( L.Height(), numTimesteps );
+    SBar.Resize( L.Height(), numTimesteps );
+    const int numThreads = NumNFFTThreads();
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp parallel for schedule(static) num_threads(numThreads)
+#endif
+    for( int j=0; j<numTimesteps; ++j )
     {
-        // Add the first column of Z to the first column of S
-        S.UpdateLocal( iLoc, 0, Z.GetLocal(iLoc,0) );
-        // Add row-wise diff of Z to the middle
-        for( int j=1; j<numTimesteps-1; ++j )
+        const F* lCol = L.LockedBuffer(0,j);
+        const F* sCol = S.LockedBuffer(0,j);
+        const F* lPrevCol = LPrev.LockedBuffer(0,j);
+        const F* sPrevCol = SPrev.LockedBuffer(0,j);
+        F* yCol = Y.Buffer(0,j);
+        F* sBarCol = SBar.Buffer(0,j);
+        RTLPSMRI_SIMD
+        for( int i=0; i<localHeight; ++i )
         {
-            const Complex<double> curr = Z.GetLocal(iLoc,j-1);
-            const Complex<double> next = Z.GetLocal(iLoc,j);
-            S.UpdateLocal( iLoc, j, next-curr ); 
+            const F x = lCol[i] + sCol[i];
+            yCol[i] = x + beta*(x-lPrevCol[i]-sPrevCol[i]);
+            sBarCol[i] = sCol[i] + beta*(sCol[i]-sPrevCol[i]);
         }
-        // Subtract the last column of Z from the last column of S
-        S.UpdateLocal( iLoc, numTimesteps-1, -Z.GetLocal(iLoc,numTimesteps-2) );
+    }
+}
+
+// Returns the local contribution to Re < Y - (L+S), (L+S) - (LPrev+SPrev) >,
+// which is positive when the momentum points against the latest 
+// proximal-gradient step. This is the gradient-based adaptive restart test 
+// of O'Donoghue and Candes applied to the sum L+S, which is all that the 
+// data-fidelity term sees. The sum over the processes is left to the 
+// iteration's FusedReduction.
+template<typename Real>
+inline double
+LocalRestartIndicator
+( const DistMatrix<Complex<Real>,VC,STAR>& Y,
+  const DistMatrix<Complex<Real>,VC,STAR>& L,
+  const DistMatrix<Complex<Real>,VC,STAR>& S,
+  const DistMatrix<Complex<Real>,VC,STAR>& LPrev,
+  const DistMatrix<Complex<Real>,VC,STAR>& SPrev )
+{
+    DEBUG_ONLY(CallStackEntry cse("lps::LocalRestartIndicator"))
+    typedef Complex<Real> F;
+    const int numTimesteps = L.Width();
+    const int localHeight = L.LocalHeight();
+    const int numThreads = NumNFFTThreads();
+    double localInner = 0;
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp parallel for schedule(static) num_threads(numThreads) \
+            reduction(+:localInner)
+#endif
+    for( int j=0; j<numTimesteps; ++j )
+    {
+        const F* yCol = Y.LockedBuffer(0,j);
+        const F* lCol = L.LockedBuffer(0,j);
+        const F* sCol = S.LockedBuffer(0,j);
+        const F* lPrevCol = LPrev.LockedBuffer(0,j);
+        const F* sPrevCol = SPrev.LockedBuffer(0,j);
+        Real colInner = 0;
+        for( int i=0; i<localHeight; ++i )
+        {
+            const F x = lCol[i] + sCol[i];
+            const F a = yCol[i] - x;
+            const F b = x - lPrevCol[i] - sPrevCol[i];
+            colInner += a.real()*b.real() + a.imag()*b.imag();
+        }
+        localInner += colInner;
+    }
+    return localInner;
+}
+
+// The slots of the FusedReduction filled by LPS
+enum ReductionSum
+{
+    FROB_M0_SQ=0,
+    FROB_UPDATE_SQ,
+    FROB_L_SQ,
+    FROB_S_SQ,
+    FROB_Z_SQ,
+    NUM_NONZEROS,
+    RESTART_INNER
+};
+enum ReductionMax
+{
+    MAX_M_SQ=0
+};
+
+// Accumulates the local contributions to || A ||_F^2 and max |A_ij|^2
+template<typename Real>
+inline void
+LocalNorms
+( const DistMatrix<Complex<Real>,VC,STAR>& A, double& frobSq, double& maxSq )
+{
+    DEBUG_ONLY(CallStackEntry cse("lps::LocalNorms"))
+    typedef Complex<Real> F;
+    const int width = A.Width();
+    const int localHeight = A.LocalHeight();
+    const int numThreads = NumNFFTThreads();
+    double localFrobSq=0, localMaxSq=0;
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp parallel for schedule(static) num_threads(numThreads) \
+            reduction(+:localFrobSq) reduction(max:localMaxSq)
+#endif
+    for( int j=0; j<width; ++j )
+    {
+        const F* aCol = A.LockedBuffer(0,j);
+        double colFrobSq=0, colMaxSq=0;
+        for( int i=0; i<localHeight; ++i )
+        {
+            const double absSq = aCol[i].real()*aCol[i].real() + 
+                                 aCol[i].imag()*aCol[i].imag();
+            colFrobSq += absSq;
+            colMaxSq = std::max( colMaxSq, absSq );
+        }
+        localFrobSq += colFrobSq;
+        localMaxSq = std::max( localMaxSq, colMaxSq );
+    }
+    frobSq += localFrobSq;
+    maxSq = std::max( maxSq, localMaxSq );
+}
+
+// Accumulates the local contributions to || M0 ||_F^2, || M-M0 ||_F^2, and 
+// max |M_ij|^2 in a single pass over M and M0 (neither of which is modified)
+template<typename Real>
+inline void
+LocalConvergenceNorms
+( const DistMatrix<Complex<Real>,VC,STAR>& M,
+  const DistMatrix<Complex<Real>,VC,STAR>& M0, 
+  double& frobM0Sq, double& frobUpdateSq, double& maxMSq )
+{
+    DEBUG_ONLY(CallStackEntry cse("lps::LocalConvergenceNorms"))
+    typedef Complex<Real> F;
+    const int width = M.Width();
+    const int localHeight = M.LocalHeight();
+    const int numThreads = NumNFFTThreads();
+    double localM0Sq=0, localUpdateSq=0, localMaxSq=0;
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp parallel for schedule(static) num_threads(numThreads) \
+            reduction(+:localM0Sq,localUpdateSq) reduction(max:localMaxSq)
+#endif
+    for( int j=0; j<width; ++j )
+    {
+        const F* mCol = M.LockedBuffer(0,j);
+        const F* m0Col = M0.LockedBuffer(0,j);
+        double colM0Sq=0, colUpdateSq=0, colMaxSq=0;
+        for( int i=0; i<localHeight; ++i )
+        {
+            const F m = mCol[i];
+            const F m0 = m0Col[i];
+            const F update = m - m0;
+            colM0Sq += m0.real()*m0.real() + m0.imag()*m0.imag();
+            colUpdateSq += 
+              update.real()*update.real() + update.imag()*update.imag();
+            colMaxSq = 
+              std::max( colMaxSq, double(m.real()*m.real()+m.imag()*m.imag()) );
+        }
+        localM0Sq += colM0Sq;
+        localUpdateSq += colUpdateSq;
+        localMaxSq = std::max( localMaxSq, colMaxSq );
+    }
+    frobM0Sq += localM0Sq;
+    frobUpdateSq += localUpdateSq;
+    maxMSq = std::max( maxMSq, localMaxSq );
+}
+
+// Returns the number of local nonzero entries of A
+template<typename Real>
+inline double
+LocalNumNonzeros( const DistMatrix<Complex<Real>,VC,STAR>& A )
+{
+    DEBUG_ONLY(CallStackEntry cse("lps::LocalNumNonzeros"))
+    typedef Complex<Real> F;
+    const int width = A.Width();
+    const int localHeight = A.LocalHeight();
+    const int numThreads = NumNFFTThreads();
+    double numNonzeros = 0;
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp parallel for schedule(static) num_threads(numThreads) \
+            reduction(+:numNonzeros)
+#endif
+    for( int j=0; j<width; ++j )
+    {
+        const F* aCol = A.LockedBuffer(0,j);
+        int colNonzeros = 0;
+        for( int i=0; i<localHeight; ++i )
+            if( aCol[i] != F(0) )
+                ++colNonzeros;
+        numNonzeros += colNonzeros;
+    }
+    return numNonzeros;
+}
+
+// Soft-thresholds the singular values of each of the numPlanes column blocks
+// of A (one per stacked plane) through the numTimesteps x numTimesteps Gram
+// matrix of the block, as in El::svt::Cross, but with the local 
+// contributions to every plane's Gram matrix combined in a single reduction.
+// When relative is true, each plane's threshold is tau times its own largest
+// singular value. The rank of each block is returned in ranks.
+template<typename Real>
+inline void
+BatchedSVT
+( DistMatrix<Complex<Real>,VC,STAR>& A, int numPlanes, Real tau, 
+  bool relative, std::vector<int>& ranks )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("lps::BatchedSVT");
+        if( A.Width() % numPlanes != 0 )
+            LogicError("Width is not a multiple of the number of planes");
+    )
+    typedef Complex<Real> F;
+    const int numTimesteps = A.Width() / numPlanes;
+    const int localHeight = A.LocalHeight();
+    const int ALDim = A.LDim();
+    const int gramSize = numTimesteps*numTimesteps;
+
+    // G_k := A_k' A_k for every plane, with one reduction for all of them
+    std::vector<F> grams( numPlanes*gramSize );
+    for( int k=0; k<numPlanes; ++k )
+    {
+        const F* ABlock = A.LockedBuffer(0,k*numTimesteps);
+        blas::Gemm
+        ( 'C', 'N', numTimesteps, numTimesteps, localHeight,
+          F(1), ABlock, ALDim, ABlock, ALDim,
+          F(0), &grams[k*gramSize], numTimesteps );
+    }
+    mpi::AllReduce( grams.data(), numPlanes*gramSize, A.Grid().VCComm() );
+
+    ranks.resize( numPlanes );
+    Matrix<F> G, V, VScaled, W, T;
+    Matrix<Real> w;
+    for( int k=0; k<numPlanes; ++k )
+    {
+        G.Resize( numTimesteps, numTimesteps );
+        for( int j=0; j<numTimesteps; ++j )
+            El::MemCopy
+            ( G.Buffer(0,j), &grams[k*gramSize+j*numTimesteps], 
+              numTimesteps );
+        ReplicatedHermitianEig( G, w, V, A.Grid().VCComm() );
+
+        // The singular values of A_k are the square roots of the eigenvalues
+        const Real sigmaMax = Sqrt(std::max(w.Get(0,0),Real(0)));
+        const Real thresh = ( relative ? tau*sigmaMax : tau );
+        int rank = 0;
+        VScaled.Resize( numTimesteps, numTimesteps );
+        while( rank < numTimesteps )
+        {
+            const Real sigma = Sqrt(std::max(w.Get(rank,0),Real(0)));
+            if( sigma <= thresh )
+                break;
+            const Real scale = (sigma-thresh)/sigma;
+            const F* vCol = V.LockedBuffer(0,rank);
+            F* vScaledCol = VScaled.Buffer(0,rank);
+            for( int i=0; i<numTimesteps; ++i )
+                vScaledCol[i] = scale*vCol[i];
+            ++rank;
+        }
+        ranks[k] = rank;
+
+        // A_k := A_k (V diag((sigma-thresh)_+/sigma) V')
+        W.Resize( numTimesteps, numTimesteps );
+        blas::Gemm
+        ( 'N', 'C', numTimesteps, numTimesteps, rank,
+          F(1), VScaled.LockedBuffer(), VScaled.LDim(), 
+                V.LockedBuffer(), V.LDim(),
+          F(0), W.Buffer(), W.LDim() );
+        T.Resize( localHeight, numTimesteps );
+        F* ABlock = A.Buffer(0,k*numTimesteps);
+        blas::Gemm
+        ( 'N', 'N', localHeight, numTimesteps, numTimesteps,
+          F(1), ABlock, ALDim, W.LockedBuffer(), W.LDim(),
+          F(0), T.Buffer(), T.LDim() );
+        for( int j=0; j<numTimesteps; ++j )
+            El::MemCopy
+            ( &ABlock[j*ALDim], T.LockedBuffer(0,j), localHeight );
     }
 }
 
 } // namespace lps
 
+// On entry, L and S should hold the converged solution of a neighbouring 
+// plane. On exit, L holds the projection of this plane's low-rank residual
+// E'D - S onto the right singular subspace V of the neighbour's L, i.e., 
+// (E'D - S) V V', so that L+S matches E'D within that subspace without 
+// counting the sparse part twice. S (and the TV dual variable) are left 
+// unchanged, and V is stored in the workspace (where it warm-starts 
+// PartialSVT). E'D is left in the workspace, and the next call to LPS, 
+// which must be given the same D (with warmStart set), uses it rather than
+// applying the adjoint again.
+//
+// V is computed from the eigenvectors of the Gram matrix L'L, which is only
+// numTimesteps x numTimesteps.
+template<typename Real>
+inline int
+SeedFromNeighbor
+( const DistMatrix<Complex<Real>,STAR,VR>& D,
+        DistMatrix<Complex<Real>,VC,STAR>& L,
+  const DistMatrix<Complex<Real>,VC,STAR>& S,
+  LPSWorkspace<Real>& work, bool progress=false )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("SeedFromNeighbor");
+        if( L.Width() != NumTimesteps() )
+            LogicError("Neighbouring solution has the wrong number of frames");
+        if( S.Height() != L.Height() || S.Width() != L.Width() )
+            LogicError("Neighbouring L and S have different sizes");
+    )
+    typedef Complex<Real> F;
+    const int numTimesteps = L.Width();
+
+    // V := the eigenvectors of L'L with non-negligible eigenvalues
+    Matrix<F> G( numTimesteps, numTimesteps );
+    blas::Gemm
+    ( 'C', 'N', numTimesteps, numTimesteps, L.LocalHeight(),
+      F(1), L.LockedBuffer(), L.LDim(), L.LockedBuffer(), L.LDim(),
+      F(0), G.Buffer(), G.LDim() );
+    mpi::AllReduce
+    ( G.Buffer(), numTimesteps*numTimesteps, L.Grid().VCComm() );
+    Matrix<Real> w;
+    Matrix<F> Z;
+    ReplicatedHermitianEig( G, w, Z, L.Grid().VCComm() );
+    const int rank = NumericalRank( w );
+    auto& V = work.svtV;
+    V.Resize( numTimesteps, rank );
+    for( int j=0; j<rank; ++j )
+        El::MemCopy( V.Buffer(0,j), Z.LockedBuffer(0,j), numTimesteps );
+
+    // L := (E'D - S) V V'
+    work.SetGrid( D.Grid() );
+    auto& ED = work.M;
+    AdjointAcquisition( D, ED, work.acquisition, progress );
+    L.AlignWith( ED );
+    L = ED;
+    Axpy( F(-1), S, L );
+    auto& LV = work.svtRange;
+    LV.AlignWith( L );
+    LV.Resize( L.Height(), rank );
+    const int localHeight = L.LocalHeight();
+    blas::Gemm
+    ( 'N', 'N', localHeight, rank, numTimesteps,
+      F(1), L.LockedBuffer(), L.LDim(), V.LockedBuffer(), V.LDim(),
+      F(0), LV.Buffer(), LV.LDim() );
+    blas::Gemm
+    ( 'N', 'C', localHeight, numTimesteps, rank,
+      F(1), LV.LockedBuffer(), LV.LDim(), V.LockedBuffer(), V.LDim(),
+      F(0), L.Buffer(), L.LDim() );
+    work.haveAdjointData = true;
+    return rank;
+}
+
+enum LPSSolver
+{
+    // The iteration of Otazo et al. with a fixed unit step
+    LPS_PROXIMAL_GRADIENT,
+    // FISTA-style momentum extrapolation on (L,S)
+    LPS_ACCELERATED,
+    LPSSolver_MAX
+};
+
+struct LPSCtrl
+{
+    // Use TV clipping (rather than soft-thresholding of the temporal FFT)
+    // for the sparse component
+    bool tv;
+    double lambdaL;
+    // lambdaS is set relative to || E'D ||_max
+    double lambdaSRelMaxM;
+    double relTol;
+    int maxIts;
+    bool tryTSQR;
+    bool progress;
+
+    LPSSolver solver;
+    // Reset the momentum of the accelerated solver when it opposes the 
+    // latest step
+    bool adaptiveRestart;
+
+    // Only compute the leading singular triplets of the low-rank update 
+    // (see PartialSVT), sampling rank(L)+svtOversample columns
+    bool partialSVT;
+    int svtOversample;
+
+    // Start from the L and S passed in (rather than from zero), along with
+    // the TV dual variable and singular subspace left in the workspace
+    bool warmStart;
+
+    LPSCtrl()
+    : tv(true), lambdaL(0.025), lambdaSRelMaxM(0.5), relTol(0.0025),
+      maxIts(100), tryTSQR(false), progress(true),
+      solver(LPS_PROXIMAL_GRADIENT), adaptiveRestart(true),
+      partialSVT(false), svtOversample(5), warmStart(false)
+    { }
+};
+
+template<typename Real>
 inline int
 LPS
-( const DistMatrix<Complex<double>,STAR,VR>& D,
-        DistMatrix<Complex<double>,VC,STAR>& L,
-        DistMatrix<Complex<double>,VC,STAR>& S,
-  bool tv=true,
-  double lambdaL=0.025, double lambdaSRelMaxM=0.5,
-  double relTol=0.0025, int maxIts=100,
-  bool tryTSQR=false, bool progress=true )
+( const DistMatrix<Complex<Real>,STAR,VR>& D,
+        DistMatrix<Complex<Real>,VC,STAR>& L,
+        DistMatrix<Complex<Real>,VC,STAR>& S,
+  LPSWorkspace<Real>& work,
+  const LPSCtrl& ctrl )
 {
     DEBUG_ONLY(CallStackEntry cse("LPS"))
     using El::Timer;
-    typedef double Real;
     typedef Complex<Real> F;
+    const bool tv = ctrl.tv;
+    const bool progress = ctrl.progress;
+    const bool accelerated = ctrl.solver == LPS_ACCELERATED;
 
     const int numTimesteps = NumTimesteps();
     const int N0 = FirstBandwidth();
@@ -100,46 +582,164 @@ LPS
     Timer initial("initial");
     initial.Start();
 
-    // M := E' D
-    DistMatrix<F,VC,STAR> M( D.Grid() );
-    AdjointAcquisition( D, M, progress );
+    // Size the temporaries once so that the iterations do not allocate
+    work.SetGrid( D.Grid() );
+    work.Reserve( tv, accelerated );
+    auto& M = work.M;
+    auto& M0 = work.M0;
+    auto& LPlusS = work.LPlusS;
+    auto& ED = work.ED;
+    auto& Z = work.Z;
+    auto& R = work.R;
+    auto& LPrev = work.LPrev;
+    auto& SPrev = work.SPrev;
+    auto& SBar = work.SBar;
+
+    // M := E' D (unless SeedFromNeighbor already computed it)
+    if( !work.haveAdjointData || !ctrl.warmStart )
+        AdjointAcquisition( D, M, work.acquisition, progress );
+    work.haveAdjointData = false;
+
+    // If the Toeplitz kernels are available, E'E can be applied directly,
+    // and E'D is all that needs to be remembered from the k-space data
+    const bool toeplitz = InitializedNormalKernels();
+    if( toeplitz )
+        ED = M;
 
     // Set lambdaS relative to || M ||_max
-    const double maxM = MaxNorm( M );
-    const double lambdaS = lambdaSRelMaxM*maxM;
+    // (|| M ||_F is computed in the same pass and reduction)
+    FusedReduction initialNorms;
+    lps::LocalNorms
+    ( M, initialNorms.sums[lps::FROB_M0_SQ], 
+         initialNorms.maxes[lps::MAX_M_SQ] );
+    FusedAllReduce( initialNorms, M.Grid().VCComm() );
+    const Real maxM = Sqrt(initialNorms.maxes[lps::MAX_M_SQ]);
+    const Real lambdaS = ctrl.lambdaSRelMaxM*maxM;
 
-    if( progress )
+    if( progress && amRoot )
     {
-        const double frobM = FrobeniusNorm( M );
-        if( amRoot )
-            std::cout << "|| M= E'D ||_F = " << frobM << "\n"
-                      << "lambdaL=" << lambdaL << ", lambdaS=" << lambdaS
-                      << std::endl;
+        const double frobM = Sqrt(initialNorms.sums[lps::FROB_M0_SQ]);
+        std::cout << "|| M= E'D ||_F = " << frobM << "\n"
+                  << "lambdaL=" << ctrl.lambdaL << ", lambdaS=" << lambdaS
+                  << std::endl;
     }
 
-    // Align L and S to M, and set S := 0
-    L.SetGrid( M.Grid() );
-    S.SetGrid( M.Grid() );
-    L.AlignWith( M );
-    S.AlignWith( M );
-    Zeros( S, N0*N1, numTimesteps );
+    // || M ||_max for the upcoming TV clipping radius, which is refreshed by
+    // the fused reduction at the end of each iteration
+    Real maxNormM = maxM;
 
-    // If using TV clipping, we need to accumulate data in the matrix Z 
-    DistMatrix<F,VC,STAR> Z( M.Grid() );
-    if( tv )
+    Timer svt("svt"), thresh("thresh"), forward("forward"), adjoint("adjoint");
+
+    // M := Y - E'(E Y - D), where Y is held by LPlusS 
+    auto dataStep = [&]( double& forwardTime, double& adjointTime )
     {
-        Z.AlignWith( M );
-        Zeros( Z, N0*N1, numTimesteps-1 );
+        if( toeplitz )
+        {
+            // M := Y - E'E Y + E'D
+            forward.Start();
+            NormalAcquisition( LPlusS, M, work.acquisition, progress );
+            Scale( F(-1), M );
+            Axpy( F(1), LPlusS, M );
+            Axpy( F(1), ED, M );
+            forwardTime = forward.Stop();
+            adjointTime = 0;
+        }
+        else
+        {
+            forward.Start();
+            Acquisition( LPlusS, R, work.acquisition, progress ); 
+            Axpy( F(-1), D, R );
+            forwardTime = forward.Stop();
+            adjoint.Start();
+            AdjointAcquisition( R, M, work.acquisition, progress );
+            Scale( F(-1), M );
+            Axpy( F(1), LPlusS, M );
+            adjointTime = adjoint.Stop();
+        }
+    };
+
+    // A warm start requires an initial guess for L and S of the right size 
+    // which lives on the same grid as (and is aligned with) E'D
+    const bool warmStart = 
+        ctrl.warmStart && 
+        &L.Grid() == &M.Grid() && &S.Grid() == &M.Grid() &&
+        L.Height() == N0*N1 && L.Width() == numTimesteps &&
+        S.Height() == N0*N1 && S.Width() == numTimesteps &&
+        L.ColAlign() == M.ColAlign() && S.ColAlign() == M.ColAlign();
+    if( warmStart )
+    {
+        // Y := L+S, SBar := S, and M := Y - E'(E Y - D)
+        LPlusS.AlignWith( M );
+        LPlusS = L;
+        Axpy( F(1), S, LPlusS );
+        if( accelerated )
+        {
+            SBar.AlignWith( M );
+            SBar = S;
+        }
+        double forwardTime, adjointTime;
+        dataStep( forwardTime, adjointTime );
+        if( tv )
+        {
+            FusedReduction warmNorms;
+            lps::LocalNorms
+            ( M, warmNorms.sums[lps::FROB_M0_SQ], 
+                 warmNorms.maxes[lps::MAX_M_SQ] );
+            FusedAllReduce( warmNorms, M.Grid().VCComm() );
+            maxNormM = Sqrt(warmNorms.maxes[lps::MAX_M_SQ]);
+        }
+
+        // Keep the TV dual variable if it is compatible
+        if( tv && (Z.Height() != N0*N1 || Z.Width() != numTimesteps-1 ||
+                   Z.ColAlign() != M.ColAlign()) )
+        {
+            Z.AlignWith( M );
+            Zeros( Z, N0*N1, numTimesteps-1 );
+        }
     }
+    else
+    {
+        // Align L and S to M, and set S := 0
+        L.SetGrid( M.Grid() );
+        S.SetGrid( M.Grid() );
+        L.AlignWith( M );
+        S.AlignWith( M );
+        Zeros( S, N0*N1, numTimesteps );
+
+        // If using TV clipping, we need to accumulate data in the matrix Z 
+        if( tv )
+        {
+            Z.AlignWith( M );
+            Zeros( Z, N0*N1, numTimesteps-1 );
+        }
 
+        // The accelerated iteration starts from the extrapolation point 
+        // Y = L+S = 0 with SBar = S = 0 
+        if( accelerated )
+        {
+            LPlusS.AlignWith( M );
+            SBar.AlignWith( M );
+            Zeros( LPlusS, N0*N1, numTimesteps );
+            Zeros( SBar, N0*N1, numTimesteps );
+            L.AlignWith( M );
+            Zeros( L, N0*N1, numTimesteps );
+        }
+    }
+    Real momentum = 1;
+    bool restart = false;
 
     if( progress && amRoot )
         std::cout << "initialization time: " << initial.Stop() << std::endl;
 
-    int numIts=0;
-    Timer svt("svt"), thresh("thresh"), forward("forward"), adjoint("adjoint");
-    DistMatrix<F,VC,STAR> M0( M.Grid() );
-    DistMatrix<F,STAR,VR> R( M.Grid() );
+    // Unless the previous right singular subspace is available from a warm
+    // start, the first low-rank update uses the full SVT
+    int prevRank = -1;
+    if( warmStart && work.svtV.Height() == numTimesteps )
+        prevRank = work.svtV.Width();
+    else
+        work.svtV.Empty();
+
+    int numIts=0, numRestarts=0;
     while( true )
     {
         ++numIts;
@@ -147,70 +747,119 @@ LPS
         // M0 := M
         M0 = M;
 
-        // L := SVT(M-S,lambdaL)
+        // Remember the previous iterates for the extrapolation
+        if( accelerated )
+        {
+            LPrev = L;
+            SPrev = S;
+        }
+
+        // L := SVT(M-S,lambdaL), with S replaced by its extrapolation SBar
+        // in the accelerated iteration
         svt.Start();
         L = M;
-        Axpy( F(-1), S, L );
+        Axpy( F(-1), ( accelerated ? SBar : S ), L );
         int rank;
-        if( tryTSQR )
-            rank = El::svt::TSQR( L, lambdaL, true );
+        if( ctrl.partialSVT )
+            rank = PartialSVT
+            ( L, Real(ctrl.lambdaL), true, prevRank, work.svtV, 
+              work.svtRange, ctrl.svtOversample, ctrl.tryTSQR );
+        else if( ctrl.tryTSQR )
+            rank = El::svt::TSQR( L, Real(ctrl.lambdaL), true );
         else 
-            rank = El::svt::Cross( L, lambdaL, true );
+            rank = El::svt::Cross( L, Real(ctrl.lambdaL), true );
+        const bool partialSVT = ctrl.partialSVT && work.svtV.Height() != 0;
+        prevRank = rank;
         const double svtTime = svt.Stop();
 
         // S := TransformedST(M-L)
+        // Every norm and count needed after this iteration is accumulated
+        // locally and then combined with a single reduction
+        FusedReduction norms;
         thresh.Start();
-        int numNonzeros;
-        S = M;
-        Axpy( F(-1), L, S );
         if( tv )
         {
-            lps::UpdateZ( MaxNorm(M)*lambdaS/2, S, Z );
-            lps::SubtractAdjDz( Z, S );
+            lps::SparseTVUpdate( maxNormM*lambdaS/2, M, L, Z, S );
             if( progress )
-                numNonzeros = ZeroNorm( S );
+                norms.sums[lps::NUM_NONZEROS] = lps::LocalNumNonzeros( S );
         }
         else
         {
+            S = M;
+            Axpy( F(-1), L, S );
             TemporalFFT( S );
             El::SoftThreshold( S, lambdaS );
             if( progress )
-                numNonzeros = ZeroNorm( S );
+                norms.sums[lps::NUM_NONZEROS] = lps::LocalNumNonzeros( S );
             TemporalAdjointFFT( S );
         }
         const double threshTime = thresh.Stop();
 
-        // M := L + S - E'(E(L+S)-D)
-        forward.Start();
-        M = L;
-        Axpy( F(1), S, M );
-        Acquisition( M, R, progress ); 
-        Axpy( F(-1), D, R );
-        const double forwardTime = forward.Stop();
-        adjoint.Start();
-        AdjointAcquisition( R, M, progress );
-        Scale( F(-1), M );
-        Axpy( F(1), L, M );
-        Axpy( F(1), S, M );
-        const double adjointTime = adjoint.Stop();
-
-        const Real frobM0 = FrobeniusNorm( M0 );        
-        Axpy( F(-1), M, M0 );
-        const Real frobUpdate = FrobeniusNorm( M0 );
+        // Y := L+S, or its extrapolation with the FISTA momentum 
+        //   beta_k = (t_k-1)/t_{k+1},  t_{k+1} = (1+sqrt(1+4 t_k^2))/2,
+        // where t_k is reset to one upon an adaptive restart. So that the 
+        // restart test does not need a collective of its own, its local 
+        // inner product joins the iteration's fused reduction, and a restart
+        // takes effect one iteration after the step which triggered it.
+        if( accelerated )
+        {
+            if( ctrl.adaptiveRestart && numIts > 1 )
+                norms.sums[lps::RESTART_INNER] = 
+                    lps::LocalRestartIndicator( LPlusS, L, S, LPrev, SPrev );
+            if( restart )
+            {
+                momentum = 1;
+                ++numRestarts;
+                restart = false;
+            }
+            const Real nextMomentum = (1+Sqrt(1+4*momentum*momentum))/2;
+            const Real beta = (momentum-1)/nextMomentum;
+            momentum = nextMomentum;
+            lps::Extrapolate( beta, L, S, LPrev, SPrev, LPlusS, SBar );
+        }
+        else
+        {
+            LPlusS = L;
+            Axpy( F(1), S, LPlusS );
+        }
+
+        // M := Y - E'(E Y - D)
+        double forwardTime, adjointTime;
+        dataStep( forwardTime, adjointTime );
+
+        lps::LocalConvergenceNorms
+        ( M, M0, norms.sums[lps::FROB_M0_SQ], 
+          norms.sums[lps::FROB_UPDATE_SQ], norms.maxes[lps::MAX_M_SQ] );
         if( progress )
         {
-            const double frobL = FrobeniusNorm( L );
-            const double frobS = FrobeniusNorm( S );
-            double frobZ;
+            double unusedMaxSq = 0;
+            lps::LocalNorms( L, norms.sums[lps::FROB_L_SQ], unusedMaxSq );
+            lps::LocalNorms( S, norms.sums[lps::FROB_S_SQ], unusedMaxSq );
             if( tv )
-                frobZ = FrobeniusNorm( Z );
+                lps::LocalNorms( Z, norms.sums[lps::FROB_Z_SQ], unusedMaxSq );
+        }
+        FusedAllReduce( norms, M.Grid().VCComm() );
+        const Real frobM0 = Sqrt(norms.sums[lps::FROB_M0_SQ]);
+        const Real frobUpdate = Sqrt(norms.sums[lps::FROB_UPDATE_SQ]);
+        maxNormM = Sqrt(norms.maxes[lps::MAX_M_SQ]);
+        restart = ( norms.sums[lps::RESTART_INNER] > 0 );
+        if( progress )
+        {
+            const long long numNonzeros = norms.sums[lps::NUM_NONZEROS];
+            const double frobL = Sqrt(norms.sums[lps::FROB_L_SQ]);
+            const double frobS = Sqrt(norms.sums[lps::FROB_S_SQ]);
+            const double frobZ = Sqrt(norms.sums[lps::FROB_Z_SQ]);
             if( amRoot )
             {
                 std::cout << "After " << numIts << " its: \n"
-                          << "  rank(L)      = " << rank << "\n"
+                          << "  rank(L)      = " << rank 
+                          << ( partialSVT ? " (partial SVT)" : "" ) << "\n"
                           << "  nnz(TS)      = " << numNonzeros << "\n"
                           << "  || L    ||_F = " << frobL << "\n"
                           << "  || S    ||_F = " << frobS << "\n";
+                if( accelerated )
+                    std::cout 
+                          << "  restarts     = " << numRestarts << "\n";
                 if( tv )
                     std::cout 
                           << "  || Z    ||_F = " << frobZ << "\n";
@@ -219,13 +868,345 @@ LPS
                           << "  || M-M0 ||_F / || M0 ||_F = " 
                           << frobUpdate/frobM0 << "\n"
                           << "  SVT time:     " << svtTime << " seconds\n"
-                          << "  Thresh time:  " << threshTime << " seconds\n"
+                          << "  Thresh time:  " << threshTime << " seconds\n";
+                if( toeplitz )
+                    std::cout 
+                          << "  Normal time:  " << forwardTime << " seconds\n";
+                else
+                    std::cout 
                           << "  Forward time: " << forwardTime << " seconds\n"
-                          << "  Adjoint time: " << adjointTime << " seconds\n"
-                          << std::endl;
+                          << "  Adjoint time: " << adjointTime << " seconds\n";
+                std::cout << std::endl;
             }
         }
-        if( numIts == maxIts || frobUpdate < relTol*frobM0 )
+        if( numIts == ctrl.maxIts || frobUpdate < ctrl.relTol*frobM0 )
+            break;
+    }
+    return numIts;
+}
+
+template<typename Real>
+inline int
+LPS
+( const DistMatrix<Complex<Real>,STAR,VR>& D,
+        DistMatrix<Complex<Real>,VC,STAR>& L,
+        DistMatrix<Complex<Real>,VC,STAR>& S,
+  const LPSCtrl& ctrl )
+{
+    DEBUG_ONLY(CallStackEntry cse("LPS"))
+    LPSWorkspace<Real> work( D.Grid() );
+    return LPS( D, L, S, work, ctrl );
+}
+
+template<typename Real>
+inline int
+LPS
+( const DistMatrix<Complex<Real>,STAR,VR>& D,
+        DistMatrix<Complex<Real>,VC,STAR>& L,
+        DistMatrix<Complex<Real>,VC,STAR>& S,
+  LPSWorkspace<Real>& work,
+  bool tv=true,
+  double lambdaL=0.025, double lambdaSRelMaxM=0.5,
+  double relTol=0.0025, int maxIts=100,
+  bool tryTSQR=false, bool progress=true )
+{
+    DEBUG_ONLY(CallStackEntry cse("LPS"))
+    LPSCtrl ctrl;
+    ctrl.tv = tv;
+    ctrl.lambdaL = lambdaL;
+    ctrl.lambdaSRelMaxM = lambdaSRelMaxM;
+    ctrl.relTol = relTol;
+    ctrl.maxIts = maxIts;
+    ctrl.tryTSQR = tryTSQR;
+    ctrl.progress = progress;
+    return LPS( D, L, S, work, ctrl );
+}
+
+template<typename Real>
+inline int
+LPS
+( const DistMatrix<Complex<Real>,STAR,VR>& D,
+        DistMatrix<Complex<Real>,VC,STAR>& L,
+        DistMatrix<Complex<Real>,VC,STAR>& S,
+  bool tv=true,
+  double lambdaL=0.025, double lambdaSRelMaxM=0.5,
+  double relTol=0.0025, int maxIts=100,
+  bool tryTSQR=false, bool progress=true )
+{
+    DEBUG_ONLY(CallStackEntry cse("LPS"))
+    LPSWorkspace<Real> work( D.Grid() );
+    return LPS
+    ( D, L, S, work, tv, lambdaL, lambdaSRelMaxM, relTol, maxIts, tryTSQR, 
+      progress );
+}
+
+// Jointly reconstructs numPlanes planes whose k-space data are stacked side
+// by side in D, which is then NumNonUniformPoints() x 
+// (numPlanes*NumCoils()*NumTimesteps()). On exit, L and S hold the stacked
+// images, N0*N1 x (numPlanes*NumTimesteps()), with the frames of plane k in
+// columns [k*NumTimesteps(),(k+1)*NumTimesteps()).
+//
+// Every acquisition operator, temporal transform, and reduction is applied 
+// once to the whole stack, which amortizes the latency of the collectives 
+// over the planes, while lambdaS, the TV clipping radius, the singular 
+// value thresholding, and the convergence test are all kept per plane. The 
+// iteration stops once every plane has converged (or after maxIts).
+//
+// Only the proximal-gradient iteration with a full (Gram-based) SVT from a 
+// zero initial guess is supported, so ctrl.tryTSQR, ctrl.partialSVT, and 
+// ctrl.warmStart are ignored.
+template<typename Real>
+inline int
+BatchedLPS
+( const DistMatrix<Complex<Real>,STAR,VR>& D,
+        DistMatrix<Complex<Real>,VC,STAR>& L,
+        DistMatrix<Complex<Real>,VC,STAR>& S,
+  LPSWorkspace<Real>& work,
+  const LPSCtrl& ctrl,
+  int numPlanes )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("BatchedLPS");
+        if( D.Width() != numPlanes*NumCoils()*NumTimesteps() )
+            LogicError("Data is not a stack of numPlanes planes");
+    )
+    using El::Timer;
+    typedef Complex<Real> F;
+    if( ctrl.solver != LPS_PROXIMAL_GRADIENT )
+        LogicError("BatchedLPS only supports the proximal-gradient solver");
+    const bool tv = ctrl.tv;
+    const bool progress = ctrl.progress;
+
+    const int numTimesteps = NumTimesteps();
+    const int width = numPlanes*numTimesteps;
+    const int N0 = FirstBandwidth();
+    const int N1 = SecondBandwidth();
+
+    const bool amRoot = D.Grid().Rank() == 0;
+
+    Timer initial("initial");
+    initial.Start();
+
+    work.SetGrid( D.Grid() );
+    work.Reserve( tv, false, numPlanes );
+    auto& M = work.M;
+    auto& M0 = work.M0;
+    auto& LPlusS = work.LPlusS;
+    auto& ED = work.ED;
+    auto& Z = work.Z;
+    auto& R = work.R;
+
+    // M := E' D
+    AdjointAcquisition( D, M, work.acquisition, progress );
+    work.haveAdjointData = false;
+    const bool toeplitz = InitializedNormalKernels();
+    if( toeplitz )
+        ED = M;
+
+    // The column blocks of a stacked matrix which belong to plane k
+    typedef DistMatrix<F,VC,STAR> DistImages;
+    auto lockedPlane = [&]( const DistImages& A, int k, DistImages& Ak )
+    { 
+        const int planeWidth = A.Width() / numPlanes;
+        El::LockedView( Ak, A, 0, k*planeWidth, A.Height(), planeWidth ); 
+    };
+    auto plane = [&]( DistImages& A, int k, DistImages& Ak )
+    { 
+        const int planeWidth = A.Width() / numPlanes;
+        El::View( Ak, A, 0, k*planeWidth, A.Height(), planeWidth ); 
+    };
+
+    // Set each plane's lambdaS relative to its own || M_k ||_max
+    std::vector<FusedReduction> initialNorms( numPlanes );
+    DistImages Ak(M.Grid()), Bk(M.Grid());
+    for( int k=0; k<numPlanes; ++k )
+    {
+        lockedPlane( M, k, Ak );
+        lps::LocalNorms
+        ( Ak, initialNorms[k].sums[lps::FROB_M0_SQ], 
+              initialNorms[k].maxes[lps::MAX_M_SQ] );
+    }
+    FusedAllReduce( initialNorms, M.Grid().VCComm() );
+    std::vector<Real> lambdaS( numPlanes ), maxNormM( numPlanes );
+    for( int k=0; k<numPlanes; ++k )
+    {
+        maxNormM[k] = Sqrt(initialNorms[k].maxes[lps::MAX_M_SQ]);
+        lambdaS[k] = ctrl.lambdaSRelMaxM*maxNormM[k];
+        if( progress && amRoot )
+        {
+            const double frobM = Sqrt(initialNorms[k].sums[lps::FROB_M0_SQ]);
+            std::cout << "plane " << k << ": || M= E'D ||_F = " << frobM 
+                      << ", lambdaS=" << lambdaS[k] << std::endl;
+        }
+    }
+    if( progress && amRoot )
+        std::cout << "lambdaL=" << ctrl.lambdaL << std::endl;
+
+    L.SetGrid( M.Grid() );
+    S.SetGrid( M.Grid() );
+    L.AlignWith( M );
+    S.AlignWith( M );
+    Zeros( S, N0*N1, width );
+    if( tv )
+    {
+        Z.AlignWith( M );
+        Zeros( Z, N0*N1, width-numPlanes );
+    }
+
+    if( progress && amRoot )
+        std::cout << "initialization time: " << initial.Stop() << std::endl;
+
+    Timer svt("svt"), thresh("thresh"), forward("forward"), adjoint("adjoint");
+    std::vector<int> ranks;
+    std::vector<Real> clipRadii( numPlanes );
+    std::vector<FusedReduction> norms( numPlanes );
+    int numIts=0;
+    while( true )
+    {
+        ++numIts;
+
+        // M0 := M
+        M0 = M;
+
+        // L := SVT(M-S,lambdaL), one plane at a time
+        svt.Start();
+        L = M;
+        Axpy( F(-1), S, L );
+        lps::BatchedSVT( L, numPlanes, Real(ctrl.lambdaL), true, ranks );
+        const double svtTime = svt.Stop();
+
+        // S := TransformedST(M-L)
+        for( int k=0; k<numPlanes; ++k )
+            norms[k] = FusedReduction();
+        thresh.Start();
+        if( tv )
+        {
+            for( int k=0; k<numPlanes; ++k )
+                clipRadii[k] = maxNormM[k]*lambdaS[k]/2;
+            lps::SparseTVUpdate( clipRadii, M, L, Z, S );
+            if( progress )
+                for( int k=0; k<numPlanes; ++k )
+                {
+                    lockedPlane( S, k, Ak );
+                    norms[k].sums[lps::NUM_NONZEROS] = 
+                        lps::LocalNumNonzeros( Ak );
+                }
+        }
+        else
+        {
+            S = M;
+            Axpy( F(-1), L, S );
+            for( int k=0; k<numPlanes; ++k )
+            {
+                plane( S, k, Ak );
+                TemporalFFT( Ak );
+                El::SoftThreshold( Ak, lambdaS[k] );
+                if( progress )
+                    norms[k].sums[lps::NUM_NONZEROS] = 
+                        lps::LocalNumNonzeros( Ak );
+                TemporalAdjointFFT( Ak );
+            }
+        }
+        const double threshTime = thresh.Stop();
+
+        // M := (L+S) - E'(E (L+S) - D)
+        LPlusS = L;
+        Axpy( F(1), S, LPlusS );
+        double forwardTime, adjointTime=0;
+        if( toeplitz )
+        {
+            forward.Start();
+            NormalAcquisition( LPlusS, M, work.acquisition, progress );
+            Scale( F(-1), M );
+            Axpy( F(1), LPlusS, M );
+            Axpy( F(1), ED, M );
+            forwardTime = forward.Stop();
+        }
+        else
+        {
+            forward.Start();
+            Acquisition( LPlusS, R, work.acquisition, progress ); 
+            Axpy( F(-1), D, R );
+            forwardTime = forward.Stop();
+            adjoint.Start();
+            AdjointAcquisition( R, M, work.acquisition, progress );
+            Scale( F(-1), M );
+            Axpy( F(1), LPlusS, M );
+            adjointTime = adjoint.Stop();
+        }
+
+        // Every plane's norms are combined with a single reduction
+        for( int k=0; k<numPlanes; ++k )
+        {
+            auto& planeNorms = norms[k];
+            lockedPlane( M, k, Ak );
+            lockedPlane( M0, k, Bk );
+            lps::LocalConvergenceNorms
+            ( Ak, Bk, planeNorms.sums[lps::FROB_M0_SQ], 
+              planeNorms.sums[lps::FROB_UPDATE_SQ], 
+              planeNorms.maxes[lps::MAX_M_SQ] );
+            if( progress )
+            {
+                double unusedMaxSq = 0;
+                lockedPlane( L, k, Ak );
+                lps::LocalNorms
+                ( Ak, planeNorms.sums[lps::FROB_L_SQ], unusedMaxSq );
+                lockedPlane( S, k, Ak );
+                lps::LocalNorms
+                ( Ak, planeNorms.sums[lps::FROB_S_SQ], unusedMaxSq );
+                if( tv )
+                {
+                    lockedPlane( Z, k, Ak );
+                    lps::LocalNorms
+                    ( Ak, planeNorms.sums[lps::FROB_Z_SQ], unusedMaxSq );
+                }
+            }
+        }
+        FusedAllReduce( norms, M.Grid().VCComm() );
+
+        int numConverged = 0;
+        for( int k=0; k<numPlanes; ++k )
+        {
+            const auto& planeNorms = norms[k];
+            const Real frobM0 = Sqrt(planeNorms.sums[lps::FROB_M0_SQ]);
+            const Real frobUpdate = Sqrt(planeNorms.sums[lps::FROB_UPDATE_SQ]);
+            maxNormM[k] = Sqrt(planeNorms.maxes[lps::MAX_M_SQ]);
+            if( frobUpdate < ctrl.relTol*frobM0 )
+                ++numConverged;
+            if( progress && amRoot )
+            {
+                std::cout 
+                  << "After " << numIts << " its, plane " << k << ": \n"
+                  << "  rank(L)      = " << ranks[k] << "\n"
+                  << "  nnz(TS)      = " 
+                  << (long long)planeNorms.sums[lps::NUM_NONZEROS] << "\n"
+                  << "  || L    ||_F = " 
+                  << Sqrt(planeNorms.sums[lps::FROB_L_SQ]) << "\n"
+                  << "  || S    ||_F = " 
+                  << Sqrt(planeNorms.sums[lps::FROB_S_SQ]) << "\n";
+                if( tv )
+                    std::cout 
+                      << "  || Z    ||_F = " 
+                      << Sqrt(planeNorms.sums[lps::FROB_Z_SQ]) << "\n";
+                std::cout 
+                  << "  || M-M0 ||_F / || M0 ||_F = " 
+                  << frobUpdate/frobM0 << "\n";
+            }
+        }
+        if( progress && amRoot )
+        {
+            std::cout << "  SVT time:     " << svtTime << " seconds\n"
+                      << "  Thresh time:  " << threshTime << " seconds\n";
+            if( toeplitz )
+                std::cout 
+                      << "  Normal time:  " << forwardTime << " seconds\n";
+            else
+                std::cout 
+                      << "  Forward time: " << forwardTime << " seconds\n"
+                      << "  Adjoint time: " << adjointTime << " seconds\n";
+            std::cout << std::endl;
+        }
+        if( numIts == ctrl.maxIts || numConverged == numPlanes )
             break;
     }
     return numIts;
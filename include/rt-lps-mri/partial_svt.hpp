@@ -0,0 +1,210 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#ifndef RTLPSMRI_PARTIALSVT_HPP
+#define RTLPSMRI_PARTIALSVT_HPP
+
+namespace mri {
+
+// Singular value soft-thresholding of an image x time matrix which only
+// computes the leading singular triplets. Since the rank of the low-rank 
+// component typically settles after a few L+S iterations, the range of A is 
+// sampled with the previous right singular subspace V (padded with 
+// 'oversample' random columns), i.e., with Y := A [V, Omega]. Writing 
+// Y = Q R via the Cholesky factor of Y'Y, the small matrix B := Q' A = R^-H Y'A
+// is formed (with a single allreduce for both Y'Y and Y'A), and its SVD, 
+// B = U_B Sigma V_B', yields
+//
+//    A := Y (R^-1 U_B (Sigma - tau)_+ V_B'),
+//
+// without ever forming Q. If too few of the sampled singular values fall 
+// below the threshold (so that the sample may have missed some that do not),
+// or the Cholesky factorization fails, the full SVT is used instead.
+//
+// On exit, V holds the new right singular subspace if the partial path 
+// succeeded, and is emptied if the full path was taken. The returned rank 
+// should be passed back in as 'prevRank' (which is negative when unknown).
+
+namespace partial_svt {
+
+template<typename Real>
+inline int
+Full
+( DistMatrix<Complex<Real>,VC,STAR>& A, Real tau, bool relative, 
+  bool tryTSQR )
+{
+    if( tryTSQR )
+        return El::svt::TSQR( A, tau, relative );
+    else
+        return El::svt::Cross( A, tau, relative );
+}
+
+} // namespace partial_svt
+
+template<typename Real>
+inline int
+PartialSVT
+( DistMatrix<Complex<Real>,VC,STAR>& A, Real tau, bool relative,
+  int prevRank, Matrix<Complex<Real>>& V, 
+  DistMatrix<Complex<Real>,VC,STAR>& Y, int oversample=5, 
+  bool tryTSQR=false )
+{
+    DEBUG_ONLY(CallStackEntry cse("PartialSVT"))
+    typedef Complex<Real> F;
+    const int width = A.Width();
+    const int localHeight = A.LocalHeight();
+    const int minGap = std::max( 1, oversample/2 );
+    const int numSamples = 
+        std::min( std::max(prevRank,1)+std::max(oversample,1), width );
+    if( prevRank < 0 || numSamples >= width )
+    {
+        V.Empty();
+        return partial_svt::Full( A, tau, relative, tryTSQR );
+    }
+    mpi::Comm comm = A.Grid().VCComm();
+
+    // Omega := [V, random], which must be identical on every process
+    Matrix<F> Omega( width, numSamples );
+    const int numWarm = ( V.Height() == width ? 
+                          std::min(V.Width(),numSamples) : 0 );
+    for( int j=0; j<numWarm; ++j )
+        El::MemCopy( Omega.Buffer(0,j), V.LockedBuffer(0,j), width );
+    const int numRandom = numSamples - numWarm;
+    if( numRandom > 0 )
+    {
+        Matrix<F> random;
+        if( mpi::Rank(comm) == 0 )
+            El::Gaussian( random, width, numRandom );
+        else
+            random.Resize( width, numRandom );
+        mpi::Broadcast( random.Buffer(), width*numRandom, 0, comm );
+        for( int j=0; j<numRandom; ++j )
+            El::MemCopy
+            ( Omega.Buffer(0,numWarm+j), random.LockedBuffer(0,j), width );
+    }
+
+    // Y := A Omega
+    Y.AlignWith( A );
+    Y.Resize( A.Height(), numSamples );
+    blas::Gemm
+    ( 'N', 'N', localHeight, numSamples, width, 
+      F(1), A.LockedBuffer(), A.LDim(), Omega.LockedBuffer(), Omega.LDim(),
+      F(0), Y.Buffer(), Y.LDim() );
+
+    // [G, C] := [Y'Y, Y'A]
+    Matrix<F> GC( numSamples, numSamples+width );
+    blas::Gemm
+    ( 'C', 'N', numSamples, numSamples, localHeight,
+      F(1), Y.LockedBuffer(), Y.LDim(), Y.LockedBuffer(), Y.LDim(),
+      F(0), GC.Buffer(0,0), GC.LDim() );
+    blas::Gemm
+    ( 'C', 'N', numSamples, width, localHeight,
+      F(1), Y.LockedBuffer(), Y.LDim(), A.LockedBuffer(), A.LDim(),
+      F(0), GC.Buffer(0,numSamples), GC.LDim() );
+    mpi::AllReduce( GC.Buffer(), numSamples*(numSamples+width), comm );
+    Matrix<F> G( numSamples, numSamples ), B( numSamples, width );
+    for( int j=0; j<numSamples; ++j )
+        El::MemCopy( G.Buffer(0,j), GC.LockedBuffer(0,j), numSamples );
+    for( int j=0; j<width; ++j )
+        El::MemCopy
+        ( B.Buffer(0,j), GC.LockedBuffer(0,numSamples+j), numSamples );
+
+    // G := R, where Y'Y = R'R, B := R^-H Y'A, and B = U_B Sigma V_B'. These
+    // small factorizations are computed on the root and their results 
+    // broadcast, so that every process applies the same update to its rows 
+    // (see ReplicatedHermitianEig).
+    const bool amRoot = mpi::Rank(comm) == 0;
+    int status[2] = { 1, 0 }; // { factored, rank }
+    Matrix<Real> s;
+    Matrix<F> VB;
+    if( amRoot )
+    {
+        try { El::Cholesky( UPPER, G ); }
+        catch( std::exception& ) { status[0] = 0; }
+        if( status[0] )
+        {
+            El::Trsm( LEFT, UPPER, ADJOINT, NON_UNIT, F(1), G, B );
+            El::SVD( B, s, VB );
+            const Real sigmaMax = s.Get(0,0);
+            const Real tauAbs = ( relative ? tau*sigmaMax : tau );
+            const int numSingVals = s.Height();
+            int rank = 0;
+            while( rank < numSingVals && s.Get(rank,0) > tauAbs )
+                ++rank;
+            for( int j=0; j<rank; ++j )
+                s.Set( j, 0, s.Get(j,0)-tauAbs );
+            status[1] = rank;
+        }
+    }
+    mpi::Broadcast( status, 2, 0, comm );
+    const bool factored = status[0];
+    const int rank = status[1];
+    if( !factored || rank+minGap > numSamples )
+    {
+        V.Empty();
+        return partial_svt::Full( A, tau, relative, tryTSQR );
+    }
+
+    // W := R^-1 U_B(:,1:r) (Sigma - tau)_+ and VRank := V_B(:,1:r), which are
+    // packed into one buffer for the broadcast
+    Matrix<F> W( numSamples, rank ), VRank( width, rank );
+    std::vector<F> packed( (numSamples+width)*rank );
+    if( amRoot )
+    {
+        for( int j=0; j<rank; ++j )
+        {
+            const F* uCol = B.LockedBuffer(0,j);
+            F* wCol = W.Buffer(0,j);
+            const Real sigma = s.Get(j,0);
+            for( int i=0; i<numSamples; ++i )
+                wCol[i] = sigma*uCol[i];
+        }
+        El::Trsm( LEFT, UPPER, NORMAL, NON_UNIT, F(1), G, W );
+        for( int j=0; j<rank; ++j )
+        {
+            El::MemCopy
+            ( &packed[j*numSamples], W.LockedBuffer(0,j), numSamples );
+            El::MemCopy
+            ( &packed[rank*numSamples+j*width], VB.LockedBuffer(0,j), width );
+        }
+    }
+    mpi::Broadcast( packed.data(), (numSamples+width)*rank, 0, comm );
+    for( int j=0; j<rank; ++j )
+    {
+        El::MemCopy( W.Buffer(0,j), &packed[j*numSamples], numSamples );
+        El::MemCopy
+        ( VRank.Buffer(0,j), &packed[rank*numSamples+j*width], width );
+    }
+    Matrix<F> WV;
+    Zeros( WV, numSamples, width );
+    if( rank > 0 )
+        El::Gemm( NORMAL, ADJOINT, F(1), W, VRank, F(0), WV );
+    blas::Gemm
+    ( 'N', 'N', localHeight, width, numSamples,
+      F(1), Y.LockedBuffer(), Y.LDim(), WV.LockedBuffer(), WV.LDim(),
+      F(0), A.Buffer(), A.LDim() );
+
+    V = VRank;
+    return rank;
+}
+
+} // namespace mri
+
+#endif // ifndef RTLPSMRI_PARTIALSVT_HPP
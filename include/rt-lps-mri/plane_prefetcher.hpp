@@ -0,0 +1,145 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#ifndef RTLPSMRI_PLANEPREFETCHER_HPP
+#define RTLPSMRI_PLANEPREFETCHER_HPP
+
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace mri {
+
+// A double-buffered ingest stage for the k-space data of a sequence of 
+// planes, which are stored in the files <dataBase>-<plane>.bin. While the 
+// caller reconstructs one plane, the next plane is read into the other 
+// [STAR,VR] buffer on a background I/O thread, so that the read overlaps 
+// with the L+S iterations rather than leaving the cores idle between planes.
+// The files may hold compact samples (see KSpaceSampleType), in which case 
+// plane k is widened and multiplied by scales[k] (or by one, if scales is 
+// empty) as it is read.
+//
+// The background reads are collective over a duplicate of the grid's 
+// communicator (so that they cannot be confused with the collectives of the
+// reconstruction), and so MPI must provide MPI_THREAD_MULTIPLE. Every 
+// process of the grid must make the same sequence of calls.
+class PlanePrefetcher
+{
+public:
+    typedef DistMatrix<Complex<double>,STAR,VR> DataMatrix;
+
+    // Collective over the grid
+    PlanePrefetcher
+    ( const Grid& grid, int numNonUniform, int numCoils, int numTimesteps,
+      std::string dataBase, 
+      KSpaceSampleType sampleType=KSPACE_COMPLEX_FLOAT64,
+      const std::vector<double>& scales=std::vector<double>() )
+    : numNonUniform_(numNonUniform), numCoils_(numCoils), 
+      numTimesteps_(numTimesteps), dataBase_(dataBase), 
+      sampleType_(sampleType), scales_(scales),
+      current_(0), pendingPlane_(-1)
+    {
+        DEBUG_ONLY(CallStackEntry cse("PlanePrefetcher::PlanePrefetcher"))
+        MPI_Comm_dup( grid.VRComm().comm, &ioComm_.comm );
+        buffers_[0].reset( new DataMatrix(grid) );
+        buffers_[1].reset( new DataMatrix(grid) );
+    }
+
+    ~PlanePrefetcher()
+    {
+        if( thread_.joinable() )
+            thread_.join();
+        mpi::Free( ioComm_ );
+    }
+
+    std::string Filename( int plane ) const
+    {
+        std::ostringstream os;
+        os << dataBase_ << "-" << plane << ".bin";
+        return os.str();
+    }
+
+    // Returns the data for the given plane, which remains valid until the 
+    // next call, and then starts reading nextPlane in the background (unless
+    // nextPlane is -1). If the given plane was not the one being prefetched,
+    // the prefetched data is discarded and the plane is read directly.
+    const DataMatrix& Get( int plane, int nextPlane=-1 )
+    {
+        DEBUG_ONLY(CallStackEntry cse("PlanePrefetcher::Get"))
+        const int prefetched = pendingPlane_;
+        Wait();
+        if( prefetched == plane )
+            current_ = 1-current_;
+        else
+            Read( *buffers_[current_], plane );
+
+        if( nextPlane != -1 )
+        {
+            pendingPlane_ = nextPlane;
+            DataMatrix& next = *buffers_[1-current_];
+            thread_ = std::thread
+            ( [this,&next,nextPlane]() 
+              { 
+                  try { Read( next, nextPlane ); }
+                  catch( ... ) { error_ = std::current_exception(); }
+              } );
+        }
+        return *buffers_[current_];
+    }
+
+private:
+    int numNonUniform_, numCoils_, numTimesteps_;
+    std::string dataBase_;
+    KSpaceSampleType sampleType_;
+    std::vector<double> scales_;
+    mpi::Comm ioComm_;
+    std::unique_ptr<DataMatrix> buffers_[2];
+    int current_, pendingPlane_;
+    std::thread thread_;
+    std::exception_ptr error_;
+
+    void Read( DataMatrix& data, int plane )
+    {
+        DEBUG_ONLY(CallStackEntry cse("PlanePrefetcher::Read"))
+        data.Resize( numNonUniform_, numCoils_*numTimesteps_ );
+        const double scale = ( scales_.empty() ? 1. : scales_.at(plane) );
+        ReadKSpace( data, Filename(plane), sampleType_, scale, ioComm_ );
+    }
+
+    // Finish any background read and rethrow its exception, if any
+    void Wait()
+    {
+        DEBUG_ONLY(CallStackEntry cse("PlanePrefetcher::Wait"))
+        if( thread_.joinable() )
+            thread_.join();
+        pendingPlane_ = -1;
+        if( error_ )
+        {
+            std::exception_ptr error = error_;
+            error_ = std::exception_ptr();
+            std::rethrow_exception( error );
+        }
+    }
+};
+
+} // namespace mri
+
+#endif // ifndef RTLPSMRI_PLANEPREFETCHER_HPP
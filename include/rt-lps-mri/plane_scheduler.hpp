@@ -0,0 +1,193 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#ifndef RTLPSMRI_PLANESCHEDULER_HPP
+#define RTLPSMRI_PLANESCHEDULER_HPP
+
+#ifdef RTLPSMRI_HAVE_MPI3
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace mri {
+
+// A dynamic scheduler for independent planes. Rather than assigning planes
+// to processes up front, a shared ticket counter (stored in an MPI-3 window 
+// on the root process and advanced with an atomic fetch-and-add) hands out 
+// the next plane to whichever process becomes free first, so that planes 
+// which take more L+S iterations than others do not leave the remaining 
+// processes idle.
+//
+// The last NumTeamPlanes() planes are reserved for teams of TeamSize() 
+// processes. Once a process draws a ticket past the single-process planes it
+// is idle, and the idle processes are grouped into teams in the order that 
+// they arrive, so that the processes which finish first cooperate on the 
+// tail planes while the stragglers finish their own planes. Each team 
+// communicator is formed with MPI_Comm_create_group, which is only 
+// collective over the members of the team.
+//
+// NOTE: This is a deliberate simplification of regrouping the idle processes
+//       around whichever planes remain. The team planes are fixed up front 
+//       (by index), a team only starts once all of its members have 
+//       arrived (so its first members wait for the later ones, which may be
+//       stragglers), each team solves exactly one plane, and a straggler 
+//       stuck on a slow single-process plane still finishes it alone. 
+//       Forming teams over the undrawn planes as soon as enough processes 
+//       are idle would require the members of a team to agree on its 
+//       membership and plane before MPI_Comm_create_group, and helping a 
+//       plane which is already being solved would require redistributing 
+//       its state mid-solve.
+//
+// The counter and the arrival list are accessed with passive-target 
+// operations. Without asynchronous progress, an MPI implementation may delay
+// such a request until the root next enters the library (at the latest, 
+// when it finishes its current plane), and so a process which is waiting 
+// for its team polls with an exponential back-off, capped at 
+// MAX_POLL_INTERVAL microseconds, rather than flooding the root with requests.
+class PlaneScheduler
+{
+public:
+    static constexpr std::chrono::microseconds::rep MAX_POLL_INTERVAL = 10000;
+
+    // Collective over comm
+    PlaneScheduler( mpi::Comm comm, int numPlanes, int teamSize=1 )
+    : comm_(comm), teamSize_(teamSize), arrival_(-1)
+    {
+        DEBUG_ONLY(CallStackEntry cse("PlaneScheduler::PlaneScheduler"))
+        const int commSize = mpi::Size( comm );
+        const int commRank = mpi::Rank( comm );
+        if( teamSize < 1 || teamSize > commSize )
+            LogicError("Invalid team size of ",teamSize);
+        numTeamPlanes_ = std::min( numPlanes, commSize/teamSize );
+        // Teams of a single process simply continue to draw planes
+        if( teamSize == 1 )
+            numTeamPlanes_ = 0;
+        numSinglePlanes_ = numPlanes - numTeamPlanes_;
+
+        // The root holds the ticket counter followed by the ranks of the
+        // idle processes, in order of arrival
+        const MPI_Aint windowSize = 
+            ( commRank == 0 ? (commSize+1)*sizeof(int) : 0 );
+        MPI_Win_allocate
+        ( windowSize, sizeof(int), MPI_INFO_NULL, comm.comm, &buffer_, 
+          &window_ );
+        if( commRank == 0 )
+        {
+            buffer_[0] = 0;
+            for( int q=0; q<commSize; ++q )
+                buffer_[q+1] = -1;
+        }
+        mpi::Barrier( comm );
+        MPI_Win_lock_all( 0, window_ );
+    }
+
+    // Collective over the original communicator
+    ~PlaneScheduler()
+    {
+        MPI_Win_unlock_all( window_ );
+        MPI_Win_free( &window_ );
+    }
+
+    int NumSinglePlanes() const { return numSinglePlanes_; }
+    int NumTeamPlanes() const { return numTeamPlanes_; }
+    int TeamSize() const { return teamSize_; }
+
+    // Returns the next plane to be solved by this process alone, or -1 once 
+    // the single-process planes have all been handed out
+    int NextPlane()
+    {
+        DEBUG_ONLY(
+            CallStackEntry cse("PlaneScheduler::NextPlane");
+            if( arrival_ != -1 )
+                LogicError("Already drew a ticket past the last plane");
+        )
+        const int one = 1;
+        int ticket;
+        MPI_Fetch_and_op( &one, &ticket, MPI_INT, 0, 0, MPI_SUM, window_ );
+        MPI_Win_flush( 0, window_ );
+        if( ticket < numSinglePlanes_ )
+            return ticket;
+
+        // Record our rank in the next free slot of the arrival list
+        arrival_ = ticket - numSinglePlanes_;
+        const int commRank = mpi::Rank( comm_ );
+        MPI_Accumulate
+        ( &commRank, 1, MPI_INT, 0, arrival_+1, 1, MPI_INT, MPI_REPLACE, 
+          window_ );
+        MPI_Win_flush( 0, window_ );
+        return -1;
+    }
+
+    // After NextPlane has returned -1, wait for the rest of this process's 
+    // team to arrive and return the team's plane along with a communicator 
+    // over the team (ordered by arrival). If there is no team plane left 
+    // for this process, -1 is returned and teamComm is not modified.
+    int JoinTeam( mpi::Comm& teamComm )
+    {
+        DEBUG_ONLY(
+            CallStackEntry cse("PlaneScheduler::JoinTeam");
+            if( arrival_ == -1 )
+                LogicError("Must exhaust the single-process planes first");
+        )
+        const int team = arrival_ / teamSize_;
+        if( team >= numTeamPlanes_ )
+            return -1;
+
+        // Poll the team's slice of the arrival list (atomically, with one
+        // request per poll) until the whole team is known
+        std::vector<int> ranks( teamSize_, -1 );
+        const std::chrono::microseconds::rep maxInterval = MAX_POLL_INTERVAL;
+        std::chrono::microseconds::rep interval = 1;
+        while( true )
+        {
+            MPI_Get_accumulate
+            ( NULL, 0, MPI_INT, ranks.data(), teamSize_, MPI_INT, 
+              0, team*teamSize_+1, teamSize_, MPI_INT, MPI_NO_OP, window_ );
+            MPI_Win_flush( 0, window_ );
+            if( std::find( ranks.begin(), ranks.end(), -1 ) == ranks.end() )
+                break;
+            std::this_thread::sleep_for
+            ( std::chrono::microseconds(interval) );
+            interval = std::min( 2*interval, maxInterval );
+        }
+
+        MPI_Group group, teamGroup;
+        MPI_Comm_group( comm_.comm, &group );
+        MPI_Group_incl( group, teamSize_, ranks.data(), &teamGroup );
+        MPI_Comm_create_group( comm_.comm, teamGroup, team, &teamComm.comm );
+        MPI_Group_free( &teamGroup );
+        MPI_Group_free( &group );
+        return numSinglePlanes_ + team;
+    }
+
+private:
+    mpi::Comm comm_;
+    int teamSize_, numTeamPlanes_, numSinglePlanes_;
+    int arrival_;
+    int* buffer_;
+    MPI_Win window_;
+};
+
+} // namespace mri
+
+#endif // ifdef RTLPSMRI_HAVE_MPI3
+
+#endif // ifndef RTLPSMRI_PLANESCHEDULER_HPP
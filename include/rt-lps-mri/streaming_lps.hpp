@@ -0,0 +1,156 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#ifndef RTLPSMRI_STREAMINGLPS_HPP
+#define RTLPSMRI_STREAMINGLPS_HPP
+
+namespace mri {
+
+// A streaming L+S reconstruction over a sliding window of the last 
+// NumTimesteps() frames. The acquisition operator is initialized with the 
+// paths and density compensation of the first window as usual; after the 
+// initial window is reconstructed, each new frame slides the acquisition 
+// operator (see SlideAcquisition), the k-space data, and the previous 
+// solution forward by one timestep, and then a small, fixed number of 
+// warm-started L+S iterations are run, so that the per-frame latency does 
+// not depend upon the length of the series.
+
+namespace streaming {
+
+// Move the local columns of A one to the left. The last column is either 
+// zeroed or left as is (so that it duplicates the previous last column).
+template<typename Real>
+inline void
+ShiftColumns( DistMatrix<Complex<Real>,VC,STAR>& A, bool zeroLast )
+{
+    DEBUG_ONLY(CallStackEntry cse("streaming::ShiftColumns"))
+    const int width = A.Width();
+    const int localHeight = A.LocalHeight();
+    for( int j=0; j<width-1; ++j )
+        El::MemCopy( A.Buffer(0,j), A.LockedBuffer(0,j+1), localHeight );
+    if( zeroLast && width > 0 )
+        El::MemZero( A.Buffer(0,width-1), localHeight );
+}
+
+// Move the (time-indexed) rows of the redundant right singular subspace up
+// by one, duplicating the last row
+template<typename Real>
+inline void
+ShiftRows( Matrix<Complex<Real>>& V )
+{
+    DEBUG_ONLY(CallStackEntry cse("streaming::ShiftRows"))
+    const int height = V.Height();
+    const int width = V.Width();
+    for( int j=0; j<width; ++j )
+    {
+        Complex<Real>* col = V.Buffer(0,j);
+        for( int i=0; i<height-1; ++i )
+            col[i] = col[i+1];
+    }
+}
+
+} // namespace streaming
+
+template<typename Real>
+class StreamingLPS
+{
+public:
+    StreamingLPS( const El::Grid& grid=El::DefaultGrid() )
+    : work_(grid), D_(grid), DNext_(grid), L_(grid), S_(grid)
+    { }
+
+    // Reconstruct the initial window, D, which is numNonUniform x 
+    // (numCoils*numTimesteps)
+    int Initialize
+    ( const DistMatrix<Complex<Real>,STAR,VR>& D, const LPSCtrl& ctrl )
+    {
+        DEBUG_ONLY(CallStackEntry cse("StreamingLPS::Initialize"))
+        ctrl_ = ctrl;
+        ctrl_.warmStart = false;
+        D_ = D;
+        return LPS( D_, L_, S_, work_, ctrl_ );
+    }
+
+    // Drop the oldest frame of the window and append the k-space data of the
+    // new frame (numNonUniform x numCoils), along with its path 
+    // (2*numNonUniform x 1) and density compensation (numNonUniform x 1), 
+    // and then run at most maxIts warm-started iterations
+    int AddFrame
+    ( const DistMatrix<Complex<Real>,STAR,VR>& frame, 
+      const DistMatrix<double,STAR,STAR>& path,
+      const DistMatrix<double,STAR,STAR>& densityComp, int maxIts )
+    {
+        DEBUG_ONLY(
+            CallStackEntry cse("StreamingLPS::AddFrame");
+            if( frame.Height() != D_.Height() || 
+                frame.Width() != NumCoils() )
+                LogicError("New frame of the wrong size");
+        )
+        const int numNonUniform = D_.Height();
+        const int numCoils = NumCoils();
+        const int numTimesteps = NumTimesteps();
+        const int keptWidth = numCoils*(numTimesteps-1);
+
+        SlideAcquisition( path, densityComp );
+
+        // Shift the (coil,time) columns of the k-space data by one timestep
+        DNext_.AlignWith( D_ );
+        DNext_.Resize( numNonUniform, numCoils*numTimesteps );
+        {
+            DistMatrix<Complex<Real>,STAR,VR> DKept(D_.Grid()), 
+                                              DKeptNext(D_.Grid()),
+                                              DNew(D_.Grid());
+            LockedView( DKept, D_, 0, numCoils, numNonUniform, keptWidth );
+            View( DKeptNext, DNext_, 0, 0, numNonUniform, keptWidth );
+            DKeptNext = DKept;
+            View( DNew, DNext_, 0, keptWidth, numNonUniform, numCoils );
+            DNew = frame;
+        }
+        D_ = DNext_;
+
+        // Slide the previous solution, which is then used as a warm start. 
+        // The new low-rank column is initialized with the previous last 
+        // column, while the new sparse and TV dual columns start at zero.
+        streaming::ShiftColumns( L_, false );
+        streaming::ShiftColumns( S_, true );
+        if( ctrl_.tv )
+            streaming::ShiftColumns( work_.Z, true );
+        streaming::ShiftRows( work_.svtV );
+
+        LPSCtrl ctrl = ctrl_;
+        ctrl.warmStart = true;
+        ctrl.maxIts = maxIts;
+        return LPS( D_, L_, S_, work_, ctrl );
+    }
+
+    const DistMatrix<Complex<Real>,STAR,VR>& D() const { return D_; }
+    const DistMatrix<Complex<Real>,VC,STAR>& L() const { return L_; }
+    const DistMatrix<Complex<Real>,VC,STAR>& S() const { return S_; }
+
+private:
+    LPSCtrl ctrl_;
+    LPSWorkspace<Real> work_;
+    DistMatrix<Complex<Real>,STAR,VR> D_, DNext_;
+    DistMatrix<Complex<Real>,VC,STAR> L_, S_;
+};
+
+} // namespace mri
+
+#endif // ifndef RTLPSMRI_STREAMINGLPS_HPP
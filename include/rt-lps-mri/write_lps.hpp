@@ -21,29 +21,33 @@
 #ifndef RTLPSMRI_WRITELPS_HPP
 #define RTLPSMRI_WRITELPS_HPP
 
+#include <cstring>
+#include <fstream>
+
 namespace mri {
 
+template<typename Real>
 inline void
 WriteLPS
-( const DistMatrix<Complex<double>,VC,STAR>& L,
-  const DistMatrix<Complex<double>,VC,STAR>& S,
+( const DistMatrix<Complex<Real>,VC,STAR>& L,
+  const DistMatrix<Complex<Real>,VC,STAR>& S,
   Int N0, Int N1, Int plane,
   bool tv=true,
   FileFormat format=ASCII_MATLAB )
 {
     DEBUG_ONLY(CallStackEntry cse("WriteLPS"))
-    Matrix<Complex<double>> B( N0, N1, N0 );
-    Complex<double>* BBuf = B.Buffer();
+    Matrix<Complex<Real>> B( N0, N1, N0 );
+    Complex<Real>* BBuf = B.Buffer();
 
     // Split the timesteps among processes
-    DistMatrix<Complex<double>,STAR,VR> A_STAR_VR( L );
+    DistMatrix<Complex<Real>,STAR,VR> A_STAR_VR( L );
     const int rowShift = A_STAR_VR.RowShift();
     const int rowStride = A_STAR_VR.RowStride();
     const int localWidth = A_STAR_VR.LocalWidth();
     for( Int tLoc=0; tLoc<localWidth; ++tLoc )
     {
         const Int t = rowShift + tLoc*rowStride;
-        const Complex<double>* LBuf = A_STAR_VR.LockedBuffer(0,tLoc);
+        const Complex<Real>* LBuf = A_STAR_VR.LockedBuffer(0,tLoc);
         for( Int j=0; j<N1; ++j )
             for( Int i=0; i<N0; ++i )    
                 BBuf[i+j*N0] = LBuf[j+i*N1];
@@ -59,7 +63,7 @@ WriteLPS
     for( Int tLoc=0; tLoc<localWidth; ++tLoc )
     {
         const Int t = rowShift + tLoc*rowStride;
-        const Complex<double>* SBuf = A_STAR_VR.LockedBuffer(0,tLoc);
+        const Complex<Real>* SBuf = A_STAR_VR.LockedBuffer(0,tLoc);
         for( Int j=0; j<N1; ++j )
             for( Int i=0; i<N0; ++i )    
                 BBuf[i+j*N0] = SBuf[j+i*N1];
@@ -73,6 +77,250 @@ WriteLPS
     }
 }
 
+// WriteLPS creates 2*numTimesteps small files per plane. Alternatively, 
+// the L and S of a plane can be stored in a single binary container file, 
+// "LPS-<plane>-tv.bin" (or "LPS-<plane>-temporal.bin"), which begins with 
+// an LPSContainerHeader and is followed by the numTimesteps frames of L and 
+// then the numTimesteps frames of S. Each frame is stored in the row order 
+// of L and S, i.e., pixel (i,j) is entry j+i*N1 of its frame (each frame is 
+// the transpose of the N0 x N1 matrix written by WriteLPS), so that each
+// process writes its [VC,STAR] rows in place, without any redistribution, 
+// in a single collective MPI-IO call.
+struct LPSContainerHeader
+{
+    char magic[8];
+    long long version;
+    long long N0, N1, numTimesteps, plane;
+    long long tv;
+    // The size of each real component (4 or 8 bytes)
+    long long realSize;
+    // The byte offset of the first frame of L
+    long long dataOffset;
+};
+
+const char LPS_CONTAINER_MAGIC[8] = {'R','T','L','P','S','M','R','I'};
+const long long LPS_CONTAINER_VERSION = 1;
+
+template<typename Real>
+inline void
+WriteLPSContainer
+( const DistMatrix<Complex<Real>,VC,STAR>& L,
+  const DistMatrix<Complex<Real>,VC,STAR>& S,
+  Int N0, Int N1, Int plane,
+  bool tv=true )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("WriteLPSContainer");
+        if( L.Height() != N0*N1 || S.Height() != N0*N1 )
+            LogicError("L and S should have N0*N1 rows");
+        if( L.Width() != S.Width() || L.ColAlign() != S.ColAlign() )
+            LogicError("L and S should be the same size and aligned");
+    )
+    const int numTimesteps = L.Width();
+    const int localHeight = L.LocalHeight();
+    const MPI_Offset entrySize = sizeof(Complex<Real>);
+    const MPI_Offset frameSize = MPI_Offset(N0)*N1*entrySize;
+
+    LPSContainerHeader header;
+    for( int k=0; k<8; ++k )
+        header.magic[k] = LPS_CONTAINER_MAGIC[k];
+    header.version = LPS_CONTAINER_VERSION;
+    header.N0 = N0;
+    header.N1 = N1;
+    header.numTimesteps = numTimesteps;
+    header.plane = plane;
+    header.tv = tv;
+    header.realSize = sizeof(Real);
+    header.dataOffset = sizeof(LPSContainerHeader);
+
+    std::ostringstream os;
+    os << "LPS-" << plane << ( tv ? "-tv" : "-temporal" ) << ".bin";
+    const std::string filename = os.str();
+    MPI_Comm comm = L.Grid().VCComm().comm;
+    MPI_File fh;
+    const int openError = 
+      MPI_File_open
+      ( comm, const_cast<char*>(filename.c_str()), 
+        MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh );
+    if( openError != MPI_SUCCESS )
+        RuntimeError("Could not open ",filename);
+    // Since the file is extended up front, a failed or short write would 
+    // otherwise leave zero-filled frames of the right length behind
+    bool success = 
+      ( MPI_File_set_size( fh, header.dataOffset+2*numTimesteps*frameSize ) 
+        == MPI_SUCCESS );
+    if( L.Grid().VCRank() == 0 )
+    {
+        MPI_Status status;
+        const int error = 
+          MPI_File_write_at
+          ( fh, 0, &header, sizeof(LPSContainerHeader), MPI_BYTE, &status );
+        success = success && 
+          mpi_io::Completed
+          ( error, status, MPI_BYTE, sizeof(LPSContainerHeader) );
+    }
+
+    // Each frame of the file holds this process's rows every ColStride() 
+    // entries, starting from entry ColShift(), and the frames of L and S 
+    // are consecutive
+    MPI_Datatype entryType, rowsType, frameType;
+    MPI_Type_contiguous( int(entrySize), MPI_BYTE, &entryType );
+    MPI_Type_commit( &entryType );
+    MPI_Type_vector( localHeight, 1, L.ColStride(), entryType, &rowsType );
+    MPI_Type_create_resized( rowsType, 0, frameSize, &frameType );
+    MPI_Type_commit( &frameType );
+    // (the collective calls must be made even after a local failure)
+    const int viewError = 
+      MPI_File_set_view
+      ( fh, header.dataOffset+L.ColShift()*entrySize, entryType, frameType,
+        const_cast<char*>("native"), MPI_INFO_NULL );
+    success = success && viewError == MPI_SUCCESS;
+
+    // Describe the local columns of L followed by those of S in memory
+    MPI_Datatype LType, SType, memType;
+    MPI_Type_vector( numTimesteps, localHeight, L.LDim(), entryType, &LType );
+    MPI_Type_vector( numTimesteps, localHeight, S.LDim(), entryType, &SType );
+    MPI_Aint addresses[2];
+    MPI_Get_address( const_cast<Complex<Real>*>(L.LockedBuffer()), 
+                     &addresses[0] );
+    MPI_Get_address( const_cast<Complex<Real>*>(S.LockedBuffer()), 
+                     &addresses[1] );
+    int blockLengths[2] = { 1, 1 };
+    MPI_Datatype types[2] = { LType, SType };
+    MPI_Type_create_struct( 2, blockLengths, addresses, types, &memType );
+    MPI_Type_commit( &memType );
+
+    MPI_Status status;
+    const int writeError = 
+      MPI_File_write_all( fh, MPI_BOTTOM, 1, memType, &status );
+    success = success && mpi_io::Completed( writeError, status, memType, 1 );
+
+    MPI_Type_free( &memType );
+    MPI_Type_free( &SType );
+    MPI_Type_free( &LType );
+    MPI_Type_free( &frameType );
+    MPI_Type_free( &rowsType );
+    MPI_Type_free( &entryType );
+    const int closeError = MPI_File_close( &fh );
+    success = success && closeError == MPI_SUCCESS;
+    if( !mpi_io::AgreeOnSuccess( success, comm ) )
+        RuntimeError("Could not write ",filename);
+}
+
+inline LPSContainerHeader
+ReadLPSContainerHeader( std::string filename )
+{
+    DEBUG_ONLY(CallStackEntry cse("ReadLPSContainerHeader"))
+    std::ifstream file( filename.c_str(), std::ios::binary );
+    if( !file.is_open() )
+        RuntimeError("Could not open ",filename);
+    LPSContainerHeader header;
+    file.read( reinterpret_cast<char*>(&header), sizeof(header) );
+    if( !file || 
+        std::memcmp( header.magic, LPS_CONTAINER_MAGIC, 8 ) != 0 ||
+        header.version != LPS_CONTAINER_VERSION )
+        RuntimeError(filename," is not an L+S container");
+    if( header.realSize != sizeof(float) && 
+        header.realSize != sizeof(double) )
+        RuntimeError(filename," has an invalid real size");
+    if( header.N0 < 0 || header.N1 < 0 || header.numTimesteps < 0 ||
+        header.dataOffset < (long long)sizeof(LPSContainerHeader) )
+        RuntimeError(filename," has an invalid header");
+    return header;
+}
+
+// Reads frame t of L and S from a file written by WriteLPSContainer as 
+// N0 x N1 matrices (oriented as in WriteLPS)
+inline void
+ReadLPSContainerFrame
+( std::string filename, int t, 
+  Matrix<Complex<double>>& LFrame, Matrix<Complex<double>>& SFrame )
+{
+    DEBUG_ONLY(CallStackEntry cse("ReadLPSContainerFrame"))
+    const LPSContainerHeader header = ReadLPSContainerHeader( filename );
+    const int N0 = header.N0;
+    const int N1 = header.N1;
+    const int numPixels = N0*N1;
+    const int numTimesteps = header.numTimesteps;
+    if( t < 0 || t >= numTimesteps )
+        LogicError("Frame ",t," is not in [0,",numTimesteps,")");
+    const long long entrySize = 2*header.realSize;
+    const long long frameSize = numPixels*entrySize;
+    std::ifstream file( filename.c_str(), std::ios::binary );
+    std::vector<char> buffer( frameSize );
+    Matrix<Complex<double>>* frames[2] = { &LFrame, &SFrame };
+    for( int k=0; k<2; ++k )
+    {
+        file.seekg( header.dataOffset + (k*numTimesteps+t)*frameSize );
+        file.read( buffer.data(), frameSize );
+        if( !file )
+            RuntimeError("Could not read frame ",t," of ",filename);
+        Matrix<Complex<double>>& frame = *frames[k];
+        frame.Resize( N0, N1 );
+        for( int j=0; j<N1; ++j )
+            for( int i=0; i<N0; ++i )
+            {
+                const char* entry = &buffer[(j+i*N1)*entrySize];
+                if( header.realSize == sizeof(double) )
+                {
+                    double pair[2];
+                    std::memcpy( pair, entry, sizeof(pair) );
+                    frame.Set( i, j, Complex<double>(pair[0],pair[1]) );
+                }
+                else
+                {
+                    float pair[2];
+                    std::memcpy( pair, entry, sizeof(pair) );
+                    frame.Set( i, j, Complex<double>(pair[0],pair[1]) );
+                }
+            }
+    }
+}
+
+enum LPSOutputMode
+{
+    // 2*numTimesteps files per plane, one per frame of L and S (WriteLPS)
+    LPS_OUTPUT_FRAMES,
+    // A single binary file per plane (WriteLPSContainer)
+    LPS_OUTPUT_CONTAINER,
+    // A single file per plane with L factored and S sparse 
+    // (WriteLPSCompressed)
+    LPS_OUTPUT_COMPRESSED,
+    LPSOutputMode_MAX
+};
+
+struct LPSOutputCtrl
+{
+    LPSOutputMode mode;
+    // The format of LPS_OUTPUT_FRAMES
+    FileFormat format;
+    // The stored precision and drop tolerance of LPS_OUTPUT_COMPRESSED
+    LPSValueType valueType;
+    double dropTol;
+
+    LPSOutputCtrl()
+    : mode(LPS_OUTPUT_FRAMES), format(ASCII_MATLAB), valueType(LPS_FLOAT32),
+      dropTol(1e-6)
+    { }
+};
+
+template<typename Real>
+inline void
+WriteLPS
+( const DistMatrix<Complex<Real>,VC,STAR>& L,
+  const DistMatrix<Complex<Real>,VC,STAR>& S,
+  Int N0, Int N1, Int plane, bool tv, const LPSOutputCtrl& ctrl )
+{
+    DEBUG_ONLY(CallStackEntry cse("WriteLPS"))
+    if( ctrl.mode == LPS_OUTPUT_CONTAINER )
+        WriteLPSContainer( L, S, N0, N1, plane, tv );
+    else if( ctrl.mode == LPS_OUTPUT_COMPRESSED )
+        WriteLPSCompressed
+        ( L, S, N0, N1, plane, tv, ctrl.valueType, ctrl.dropTol );
+    else
+        WriteLPS( L, S, N0, N1, plane, tv, ctrl.format );
+}
+
 } // namespace mri
 
 #endif // ifndef RTLPSMRI_WRITELPS_HPP
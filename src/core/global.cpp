@@ -18,12 +18,20 @@
    along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "rt-lps-mri.hpp"
+#include <algorithm>
+#include <map>
+#include <thread>
+#include <tuple>
 
 namespace { 
 bool mriInitializedElemental; 
+bool mriInitializedMpi = false;
 int numMriInits = 0;
 mri::Args* args = 0;
 DEBUG_ONLY(std::stack<std::string> callStack)
+// The thread which called Initialize, which is the only one (outside of 
+// its OpenMP teams) allowed to touch the call stack
+DEBUG_ONLY(std::thread::id callStackThread)
 
 bool initializedCoilPlans = false;
 int numCoils;
@@ -31,15 +39,176 @@ int numTimesteps;
 int numNonUniformPoints;
 int firstBandwidth;
 int secondBandwidth;
-fftw_plan fftwForward, fftwBackward;
-fftw_complex *g1, *g2;
+int firstFFTSize;
+int secondFFTSize;
+int cutoff;
+int numNFFTThreads;
+int numPlaneThreads = 1;
+// Each thread owns a pair of oversampled grids and the FFTW plans between them
+std::vector<fftw_plan> fftwForwards, fftwBackwards;
+std::vector<fftw_complex*> g1s, g2s;
 El::DistMatrix<double,El::STAR,El::STAR>* coilPaths;
+// The plan for timestep t and thread k is stored at index t + k*numTimesteps.
+// Only the plans of thread 0 own their precomputed data; the rest are shallow
+// copies which point at the workspace of their thread.
 std::vector<nfft_plan> coilPlans;
 
+mri::NFFTType nfftType = mri::PER_COIL_NFFT;
+int numPipelineChunks = 1;
+int coilBatchCapacity = 0;
+std::vector<fftw_complex*> coilBatchGrids;
+std::map<int,std::pair<fftw_plan,fftw_plan>> coilBatchPlans;
+#ifdef RTLPSMRI_HAVE_FFTWF
+std::map<int,std::pair<fftwf_plan,fftwf_plan>> coilBatchPlansSingle;
+#endif
+
+// Plans for the temporal FFTs, indexed by (n,howMany,ldim,sign)
+typedef std::tuple<int,int,int,int> TemporalKey;
+std::map<TemporalKey,fftw_plan> temporalPlans;
+#ifdef RTLPSMRI_HAVE_FFTWF
+std::map<TemporalKey,fftwf_plan> temporalPlansSingle;
+#endif
+
+// The MPI datatype and operation behind FusedAllReduce
+bool createdFusedReduction = false;
+MPI_Datatype fusedReductionType;
+MPI_Op fusedReductionOp;
+
+bool initializedGridding = false;
+std::vector<mri::GriddingMatrix> griddingMatrices;
+std::vector<int> griddingIndices;
+std::vector<double> deapodization;
+
 bool initializedAcquisition = false;
 El::DistMatrix<double,El::STAR,El::STAR>* densityComp;
 El::DistMatrix<El::Complex<double>,El::STAR,El::STAR>* sensitivity;
 El::DistMatrix<double,El::STAR,El::STAR>* sensitivityScalings;
+El::DistMatrix<float,El::STAR,El::STAR>* densityCompSingle;
+El::DistMatrix<El::Complex<float>,El::STAR,El::STAR>* sensitivitySingle;
+El::DistMatrix<float,El::STAR,El::STAR>* sensitivityScalingsSingle;
+
+bool initializedNormalKernels = false;
+El::DistMatrix<double,El::STAR,El::STAR>* normalKernels;
+std::vector<fftw_complex*> normalGrids;
+fftw_plan normalForward, normalBackward;
+
+// Select the global data of the requested precision
+El::DistMatrix<double,El::STAR,El::STAR>* DensityCompOf( double )
+{ return ::densityComp; }
+El::DistMatrix<float,El::STAR,El::STAR>* DensityCompOf( float )
+{ return ::densityCompSingle; }
+El::DistMatrix<El::Complex<double>,El::STAR,El::STAR>* SensitivityOf( double )
+{ return ::sensitivity; }
+El::DistMatrix<El::Complex<float>,El::STAR,El::STAR>* SensitivityOf( float )
+{ return ::sensitivitySingle; }
+El::DistMatrix<double,El::STAR,El::STAR>* SensitivityScalingsOf( double )
+{ return ::sensitivityScalings; }
+El::DistMatrix<float,El::STAR,El::STAR>* SensitivityScalingsOf( float )
+{ return ::sensitivityScalingsSingle; }
+std::map<int,std::pair<fftw_plan,fftw_plan>>& CoilBatchPlansOf( double )
+{ return ::coilBatchPlans; }
+#ifdef RTLPSMRI_HAVE_FFTWF
+std::map<int,std::pair<fftwf_plan,fftwf_plan>>& CoilBatchPlansOf( float )
+{ return ::coilBatchPlansSingle; }
+#endif
+std::map<TemporalKey,fftw_plan>& TemporalPlansOf( double )
+{ return ::temporalPlans; }
+#ifdef RTLPSMRI_HAVE_FFTWF
+std::map<TemporalKey,fftwf_plan>& TemporalPlansOf( float )
+{ return ::temporalPlansSingle; }
+#endif
+
+// Within an outermost parallel region of NumPlaneThreads() threads, each 
+// plane thread (and the NFFT threads nested within it) uses its own block of
+// the per-thread NFFT data
+int PlaneThreadOffset()
+{
+#ifdef RTLPSMRI_HAVE_OPENMP
+    if( ::numPlaneThreads > 1 && omp_get_level() > 0 )
+        return omp_get_ancestor_thread_num(1)*
+               (::numNFFTThreads/::numPlaneThreads);
+#endif
+    return 0;
+}
+
+void FreeTemporalPlans()
+{
+    for( auto& entry : ::temporalPlans )
+        fftw_destroy_plan( entry.second );
+    ::temporalPlans.clear();
+#ifdef RTLPSMRI_HAVE_FFTWF
+    for( auto& entry : ::temporalPlansSingle )
+        fftwf_destroy_plan( entry.second );
+    ::temporalPlansSingle.clear();
+#endif
+}
+
+// Sum the leading entries of each FusedReduction and take the maximum of 
+// the trailing ones
+void CombineFusedReductions
+( void* inBuf, void* inOutBuf, int* len, MPI_Datatype* type )
+{
+    const auto* in = static_cast<const mri::FusedReduction*>(inBuf);
+    auto* inOut = static_cast<mri::FusedReduction*>(inOutBuf);
+    for( int r=0; r<*len; ++r )
+    {
+        for( int k=0; k<mri::FusedReduction::NUM_SUMS; ++k )
+            inOut[r].sums[k] += in[r].sums[k];
+        for( int k=0; k<mri::FusedReduction::NUM_MAXES; ++k )
+            inOut[r].maxes[k] = std::max( inOut[r].maxes[k], in[r].maxes[k] );
+    }
+}
+
+void CreateFusedReduction()
+{
+    const int numEntries = 
+      mri::FusedReduction::NUM_SUMS + mri::FusedReduction::NUM_MAXES;
+    MPI_Type_contiguous( numEntries, MPI_DOUBLE, &::fusedReductionType );
+    MPI_Type_commit( &::fusedReductionType );
+    MPI_Op_create( CombineFusedReductions, 1, &::fusedReductionOp );
+    ::createdFusedReduction = true;
+}
+
+void FreeFusedReduction()
+{
+    if( ::createdFusedReduction )
+    {
+        MPI_Op_free( &::fusedReductionOp );
+        MPI_Type_free( &::fusedReductionType );
+        ::createdFusedReduction = false;
+    }
+}
+
+template<typename S,typename T>
+void ConvertLocal
+( const El::DistMatrix<S,El::STAR,El::STAR>& A, 
+        El::DistMatrix<T,El::STAR,El::STAR>& B )
+{
+    const int height = A.Height();
+    const int width = A.Width();
+    B.SetGrid( A.Grid() );
+    El::Zeros( B, height, width );
+    for( int j=0; j<width; ++j )
+    {
+        const S* ACol = A.LockedBuffer(0,j);
+        T* BCol = B.Buffer(0,j);
+        for( int i=0; i<height; ++i )
+            BCol[i] = T(ACol[i]);
+    }
+}
+
+// Move each column of A one to the left, dropping the first column and 
+// (if newCol is nonzero) filling the last column with newCol
+template<typename T>
+void ShiftColumns( El::DistMatrix<T,El::STAR,El::STAR>& A, const T* newCol )
+{
+    const int height = A.Height();
+    const int width = A.Width();
+    for( int j=0; j<width-1; ++j )
+        El::MemCopy( A.Buffer(0,j), A.LockedBuffer(0,j+1), height );
+    if( newCol != 0 && width > 0 )
+        El::MemCopy( A.Buffer(0,width-1), newCol, height );
+}
 }
 
 namespace mri {
@@ -100,8 +269,20 @@ void Initialize( int& argc, char**& argv )
 
     ::args = new Args( argc, argv );
     ::numMriInits = 1;
+    DEBUG_ONLY(::callStackThread = std::this_thread::get_id())
     if( !El::Initialized() )
     {
+        // Request full thread support so that planes can be reconstructed
+        // concurrently by several threads of a process (see 
+        // SetNumPlaneThreads)
+        int mpiInitialized;
+        MPI_Initialized( &mpiInitialized );
+        if( !mpiInitialized )
+        {
+            int provided;
+            MPI_Init_thread( &argc, &argv, MPI_THREAD_MULTIPLE, &provided );
+            ::mriInitializedMpi = true;
+        }
         El::Initialize( argc, argv );
         ::mriInitializedElemental = true;
     }
@@ -117,6 +298,9 @@ void Finalize()
     if( ::numMriInits <= 0 )
         throw std::logic_error("Finalized RT-LPS-MRI more than initialized");
     --::numMriInits;
+    // The custom MPI objects must be freed before MPI is finalized
+    if( ::numMriInits == 0 )
+        FreeFusedReduction();
     if( ::mriInitializedElemental )
         El::Finalize();
 
@@ -126,17 +310,66 @@ void Finalize()
             FinalizeAcquisition();
         else if( InitializedCoilPlans() )
             FinalizeCoilPlans();
+        FreeTemporalPlans();
         delete ::args;    
         ::args = 0;
+        if( ::mriInitializedMpi )
+        {
+            MPI_Finalize();
+            ::mriInitializedMpi = false;
+        }
     }
 }
 
+MPI_Datatype FusedReductionType()
+{
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp critical(rtlpsmri_fused_reduction)
+#endif
+    if( !::createdFusedReduction )
+        CreateFusedReduction();
+    return ::fusedReductionType;
+}
+
+MPI_Op FusedReductionOp()
+{
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp critical(rtlpsmri_fused_reduction)
+#endif
+    if( !::createdFusedReduction )
+        CreateFusedReduction();
+    return ::fusedReductionOp;
+}
+
 DEBUG_ONLY(
+    // Only the master thread at every level of nesting records its calls, 
+    // and background threads (e.g., those of PlanePrefetcher and 
+    // AsyncWriter) never do, since the call stack is not thread-safe
+    bool OnMasterThread()
+    {
+        if( std::this_thread::get_id() != ::callStackThread )
+            return false;
+#ifdef RTLPSMRI_HAVE_OPENMP
+        for( int level=1; level<=omp_get_level(); ++level )
+            if( omp_get_ancestor_thread_num(level) != 0 )
+                return false;
+#endif
+        return true;
+    }
+
     void PushCallStack( std::string s )
-    { ::callStack.push( s ); }
+    {
+        if( !OnMasterThread() )
+            return;
+        ::callStack.push( s );
+    }
 
     void PopCallStack()
-    { ::callStack.pop(); }
+    {
+        if( !OnMasterThread() )
+            return;
+        ::callStack.pop();
+    }
 
     void DumpCallStack()
     {
@@ -165,17 +398,228 @@ Args& GetArgs()
     return *::args;
 }
 
+namespace {
+
+// Copy NFFT3's precomputed windows (PRE_FULL_PSI) and deconvolution factors
+// (PRE_PHI_HUT) into the representation used by the native gridding engine
+void InitializeGriddingMatrix( int t )
+{
+    DEBUG_ONLY(CallStackEntry cse("InitializeGriddingMatrix"))
+    const int numNonUniform = ::numNonUniformPoints;
+    const nfft_plan& plan = ::coilPlans[t];
+    if( !(plan.nfft_flags & PRE_FULL_PSI) )
+        LogicError("Native gridding requires PRE_FULL_PSI");
+    std::vector<int> rowStarts(numNonUniform), rowSizes(numNonUniform);
+    for( int i=0, ix=0; i<numNonUniform; ++i )
+    {
+        rowStarts[i] = ix;
+        rowSizes[i] = plan.psi_index_f[i];
+        ix += rowSizes[i];
+    }
+
+    GriddingMatrix& A = ::griddingMatrices[t];
+    A.nodes.resize( numNonUniform );
+    for( int i=0; i<numNonUniform; ++i )
+        A.nodes[i] = i;
+    const int* psiIndexG = plan.psi_index_g;
+    std::stable_sort
+    ( A.nodes.begin(), A.nodes.end(), 
+      [&]( int i, int j ) 
+      { 
+          const int gi = ( rowSizes[i] ? psiIndexG[rowStarts[i]] : 0 );
+          const int gj = ( rowSizes[j] ? psiIndexG[rowStarts[j]] : 0 );
+          return gi < gj; 
+      } );
+
+    A.offsets.resize( numNonUniform+1 );
+    A.offsets[0] = 0;
+    for( int r=0; r<numNonUniform; ++r )
+        A.offsets[r+1] = A.offsets[r] + rowSizes[A.nodes[r]];
+    const int numEntries = A.offsets[numNonUniform];
+    A.indices.resize( numEntries );
+    A.weights.resize( numEntries );
+    for( int r=0; r<numNonUniform; ++r )
+    {
+        const int i = A.nodes[r];
+        for( int l=0; l<rowSizes[i]; ++l )
+        {
+            A.indices[A.offsets[r]+l] = psiIndexG[rowStarts[i]+l];
+            A.weights[A.offsets[r]+l] = plan.psi[rowStarts[i]+l];
+        }
+    }
+    A.singleWeights.assign( A.weights.begin(), A.weights.end() );
+}
+
+void InitializeGridding()
+{
+    DEBUG_ONLY(CallStackEntry cse("InitializeGridding"))
+    const int N0 = ::firstBandwidth;
+    const int N1 = ::secondBandwidth;
+    const int n0 = ::firstFFTSize;
+    const int n1 = ::secondFFTSize;
+    const int numTimesteps = ::numTimesteps;
+
+    ::griddingMatrices.resize( numTimesteps );
+    for( int t=0; t<numTimesteps; ++t )
+        InitializeGriddingMatrix( t );
+
+    // The deconvolution factors only depend upon the bandwidths, the FFT 
+    // sizes, and the cutoff, so they are shared by all of the timesteps
+    const nfft_plan& plan = ::coilPlans[0];
+    const double scale = 1./Sqrt(1.*N0*N1);
+    ::griddingIndices.resize( N0*N1 );
+    ::deapodization.resize( N0*N1 );
+    for( int a0=0; a0<N0; ++a0 )
+    {
+        const int i0 = ( a0 < N0/2 ? n0-N0/2+a0 : a0-N0/2 );
+        for( int a1=0; a1<N1; ++a1 )
+        {
+            const int i1 = ( a1 < N1/2 ? n1-N1/2+a1 : a1-N1/2 );
+            ::griddingIndices[a1+a0*N1] = i1 + i0*n1;
+            ::deapodization[a1+a0*N1] = 
+                scale*plan.c_phi_inv[0][a0]*plan.c_phi_inv[1][a1];
+        }
+    }
+
+    ::initializedGridding = true;
+}
+
+void FinalizeGridding()
+{
+    DEBUG_ONLY(CallStackEntry cse("FinalizeGridding"))
+    ::griddingMatrices.clear();
+    ::griddingIndices.clear();
+    ::deapodization.clear();
+    ::initializedGridding = false;
+}
+
+} // anonymous namespace
+
+void SetNFFTType( NFFTType type )
+{ 
+    DEBUG_ONLY(CallStackEntry cse("SetNFFTType"))
+    ::nfftType = type; 
+    if( type == NATIVE_NFFT && InitializedCoilPlans() && 
+        !InitializedGridding() )
+        InitializeGridding();
+}
+
+NFFTType GetNFFTType()
+{ return ::nfftType; }
+
+void SetNumPipelineChunks( int numChunks )
+{
+    DEBUG_ONLY(CallStackEntry cse("SetNumPipelineChunks"))
+    if( numChunks < 1 )
+        LogicError("The number of pipeline chunks must be positive");
+    ::numPipelineChunks = numChunks;
+}
+
+int NumPipelineChunks()
+{ return ::numPipelineChunks; }
+
+void SetNumPlaneThreads( int numPlaneThreads )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("SetNumPlaneThreads");
+        if( !InitializedCoilPlans() )
+            LogicError("Have not yet initialized coil plans");
+    )
+    if( numPlaneThreads < 1 )
+        LogicError("The number of plane threads must be positive");
+#ifdef RTLPSMRI_HAVE_OPENMP
+    if( numPlaneThreads > ::numNFFTThreads )
+        LogicError
+        ("Cannot split ",::numNFFTThreads," NFFT threads between ",
+         numPlaneThreads," plane threads");
+    if( numPlaneThreads > 1 )
+    {
+        // The NFFT threads are nested within the plane threads
+        omp_set_max_active_levels( std::max(omp_get_max_active_levels(),2) );
+
+        // The coil batches are never larger than the number of coils, and 
+        // reserving them now avoids reallocating them while in use
+        if( GetNFFTType() != PER_COIL_NFFT )
+            ReserveCoilBatches( ::numCoils );
+    }
+#else
+    if( numPlaneThreads > 1 )
+        LogicError("Plane threads require OpenMP");
+#endif
+    ::numPlaneThreads = numPlaneThreads;
+}
+
+int NumPlaneThreads()
+{ return ::numPlaneThreads; }
+
 bool InitializedCoilPlans()
 { return ::initializedCoilPlans; }
 
 bool InitializedAcquisition()
 { return ::initializedAcquisition; }
 
+bool InitializedNormalKernels()
+{ return ::initializedNormalKernels; }
+
+bool InitializedGridding()
+{ return ::initializedGridding; }
+
+namespace {
+
+// Initialize thread 0's plan for timestep t from column t of the paths
+void InitializeCoilPlan( int t )
+{
+    DEBUG_ONLY(CallStackEntry cse("InitializeCoilPlan"))
+    const int dim = 2;
+    int NN[dim] = { ::firstBandwidth, ::secondBandwidth };
+    int nn[dim] = { ::firstFFTSize, ::secondFFTSize };
+    unsigned nfftFlags = PRE_PHI_HUT| PRE_FULL_PSI| NFFT_SORT_NODES;
+    unsigned fftwFlags = FFTW_MEASURE| FFTW_DESTROY_INPUT;
+
+    nfft_plan& plan = ::coilPlans[t];
+    plan.x = ::coilPaths->Buffer(0,t);
+    plan.g1 = ::g1s[0];
+    plan.g2 = ::g2s[0];
+    plan.my_fftw_plan1 = ::fftwForwards[0];
+    plan.my_fftw_plan2 = ::fftwBackwards[0];
+    nfft_init_guru
+    ( &plan, dim, NN, ::numNonUniformPoints, nn, ::cutoff, 
+      nfftFlags, fftwFlags );
+    if( plan.nfft_flags & PRE_ONE_PSI )
+        nfft_precompute_one_psi( &plan );
+}
+
+// Point the plans of the remaining threads at the data of thread 0's plans
+void CopyCoilPlans()
+{
+    DEBUG_ONLY(CallStackEntry cse("CopyCoilPlans"))
+    const int numTimesteps = ::numTimesteps;
+    for( int k=1; k<::numNFFTThreads; ++k )
+    {
+        for( int t=0; t<numTimesteps; ++t )
+        {
+            nfft_plan& plan = ::coilPlans[t+k*numTimesteps];
+            plan = ::coilPlans[t];
+            plan.g1 = ::g1s[k];
+            plan.g2 = ::g2s[k];
+            plan.my_fftw_plan1 = ::fftwForwards[k];
+            plan.my_fftw_plan2 = ::fftwBackwards[k];
+        }
+    }
+}
+
+} // anonymous namespace
+
 // Each column of X corresponds to the Fourier-domain path for each timestep.
 // The trajectories are the same for each coil.
+//
+// Each of the numThreads threads is given its own oversampled grids and FFTW
+// plans so that the columns of the coil-aware transforms can be processed
+// concurrently. If numThreads is not positive, the maximum number of OpenMP 
+// threads is used.
 void InitializeCoilPlans
 ( const DistMatrix<double,STAR,STAR>& X, 
-  int numCoils, int N0, int N1, int n0, int n1, int m )
+  int numCoils, int N0, int N1, int n0, int n1, int m, int numThreads )
 {
     DEBUG_ONLY(
         CallStackEntry cse("InitializeCoilPlans");
@@ -191,47 +635,196 @@ void InitializeCoilPlans
     ::numNonUniformPoints = numNonUniform;
     ::firstBandwidth = N0;
     ::secondBandwidth = N1;
+    ::firstFFTSize = n0;
+    ::secondFFTSize = n1;
+    ::cutoff = m;
+#ifdef RTLPSMRI_HAVE_OPENMP
+    if( numThreads <= 0 )
+        numThreads = omp_get_max_threads();
+#else
+    numThreads = 1;
+#endif
+    ::numNFFTThreads = numThreads;
 
     ::coilPaths = new DistMatrix<double,STAR,STAR>( X );
 
-    int NN[dim] = { N0, N1 };
-    int nn[dim] = { n0, n1 };
     const int nTotal = n0*n1;
-
-    unsigned nfftFlags = PRE_PHI_HUT| PRE_FULL_PSI| NFFT_SORT_NODES;
     unsigned fftwFlags = FFTW_MEASURE| FFTW_DESTROY_INPUT;
 
-    ::g1 = (fftw_complex*)nfft_malloc( nTotal*sizeof(fftw_complex) );
-    ::g2 = (fftw_complex*)nfft_malloc( nTotal*sizeof(fftw_complex) );
-    ::fftwForward = 
-        fftw_plan_dft_2d( n0, n1, ::g1, ::g2, FFTW_FORWARD, fftwFlags );
-    ::fftwBackward = 
-        fftw_plan_dft_2d( n0, n1, ::g2, ::g1, FFTW_BACKWARD, fftwFlags );
+    // NOTE: Since FFTW accumulates wisdom, only the first set of plans should
+    //       require any substantial measurement
+    ::g1s.resize( numThreads );
+    ::g2s.resize( numThreads );
+    ::fftwForwards.resize( numThreads );
+    ::fftwBackwards.resize( numThreads );
+    for( int k=0; k<numThreads; ++k )
+    {
+        ::g1s[k] = (fftw_complex*)nfft_malloc( nTotal*sizeof(fftw_complex) );
+        ::g2s[k] = (fftw_complex*)nfft_malloc( nTotal*sizeof(fftw_complex) );
+        ::fftwForwards[k] = 
+            fftw_plan_dft_2d
+            ( n0, n1, ::g1s[k], ::g2s[k], FFTW_FORWARD, fftwFlags );
+        ::fftwBackwards[k] = 
+            fftw_plan_dft_2d
+            ( n0, n1, ::g2s[k], ::g1s[k], FFTW_BACKWARD, fftwFlags );
+    }
 
     ::coilPlans.clear();
-    ::coilPlans.resize( numTimesteps );
+    ::coilPlans.resize( numTimesteps*numThreads );
     for( int t=0; t<numTimesteps; ++t )
+        InitializeCoilPlan( t );
+    CopyCoilPlans();
+    if( ::nfftType == NATIVE_NFFT )
+        InitializeGridding();
+
+    ::initializedCoilPlans = true;
+}
+
+namespace {
+
+// Since the trajectory of each timestep is fixed, the composition of the 
+// adjoint NFFT, the density compensation, and the NFFT of each timestep is
+// the Toeplitz operator 
+//
+//    (A' W A u)(k) = sum_{k'} T(k-k') u(k'),
+//    T(d) = sum_j w_j exp(2 pi i d.x_j),
+//
+// where d ranges over (-N0,N0) x (-N1,N1). T can therefore be computed with 
+// a single adjoint NFFT of the density weights with twice the bandwidth, and
+// then embedded into a circulant matrix on a 2*N0 x 2*N1 grid. Since T(-d) is
+// the conjugate of T(d), the Fourier transform of the embedding is real.
+//
+// The kernels of timesteps [tBeg,tEnd) are written into the corresponding 
+// columns of the (already allocated) normalKernels.
+void ComputeNormalKernels( int tBeg, int tEnd )
+{
+    DEBUG_ONLY(CallStackEntry cse("ComputeNormalKernels"))
+    const int N0 = ::firstBandwidth;
+    const int N1 = ::secondBandwidth;
+    const int n0 = ::firstFFTSize;
+    const int n1 = ::secondFFTSize;
+    const int m = ::cutoff;
+    const int numNonUniform = ::numNonUniformPoints;
+    const int kernelSize = 4*N0*N1;
+
+    const int dim = 2;
+    int NN[dim] = { 2*N0, 2*N1 };
+    int nn[dim] = { 2*n0, 2*n1 };
+    unsigned nfftFlags = 
+        PRE_PHI_HUT| PRE_PSI| MALLOC_F_HAT| MALLOC_F| FFTW_INIT| 
+        FFT_OUT_OF_PLACE;
+    unsigned fftwFlags = FFTW_ESTIMATE| FFTW_DESTROY_INPUT;
+    nfft_plan plan;
+    plan.x = ::coilPaths->Buffer(0,0);
+    nfft_init_guru
+    ( &plan, dim, NN, numNonUniform, nn, m, nfftFlags, fftwFlags );
+
+    fftw_complex* kernel = 
+        (fftw_complex*)fftw_malloc( kernelSize*sizeof(fftw_complex) );
+    fftw_plan kernelPlan = 
+        fftw_plan_dft_2d
+        ( 2*N0, 2*N1, kernel, kernel, FFTW_FORWARD, FFTW_ESTIMATE );
+
+    // Fold the 1/sqrt(N0*N1) scalings of the NFFT and its adjoint, as well as
+    // the 1/(4*N0*N1) of the unnormalized FFT pair, into the kernels
+    const double scale = 1./(4.*N0*N1*N0*N1);
+    for( int t=tBeg; t<tEnd; ++t )
     {
-        nfft_plan& plan = ::coilPlans[t];
         plan.x = ::coilPaths->Buffer(0,t);
-        plan.g1 = ::g1;
-        plan.g2 = ::g2;
-        plan.my_fftw_plan1 = ::fftwForward;
-        plan.my_fftw_plan2 = ::fftwBackward;
-        nfft_init_guru
-        ( &plan, dim, NN, numNonUniform, nn, m, nfftFlags, fftwFlags );
         if( plan.nfft_flags & PRE_ONE_PSI )
             nfft_precompute_one_psi( &plan );
+        const double* density = ::densityComp->LockedBuffer(0,t);
+        for( int i=0; i<numNonUniform; ++i )
+        {
+            plan.f[i][0] = density[i];
+            plan.f[i][1] = 0;
+        }
+        nfft_adjoint( &plan );
+
+        // Entry (c0,c1) of the circulant embedding corresponds to the 
+        // difference d = (c0,c1) mod (2*N0,2*N1), where the (unused) entries
+        // with d0=-N0 or d1=-N1 are zeroed to preserve conjugate symmetry
+        for( int c0=0; c0<2*N0; ++c0 )
+        {
+            const int d0 = ( c0 < N0 ? c0 : c0-2*N0 );
+            for( int c1=0; c1<2*N1; ++c1 )
+            {
+                const int d1 = ( c1 < N1 ? c1 : c1-2*N1 );
+                fftw_complex& entry = kernel[c1+c0*2*N1];
+                if( c0 == N0 || c1 == N1 )
+                {
+                    entry[0] = entry[1] = 0;
+                }
+                else
+                {
+                    const fftw_complex& tau = 
+                        plan.f_hat[(d1+N1)+(d0+N0)*2*N1];
+                    entry[0] = tau[0];
+                    entry[1] = tau[1];
+                }
+            }
+        }
+        fftw_execute( kernelPlan );
+        double* kernelHat = ::normalKernels->Buffer(0,t);
+        for( int i=0; i<kernelSize; ++i )
+            kernelHat[i] = scale*kernel[i][0];
     }
+    fftw_destroy_plan( kernelPlan );
+    fftw_free( kernel );
+    nfft_finalize( &plan );
+}
 
-    ::initializedCoilPlans = true;
+void InitializeNormalKernels()
+{
+    DEBUG_ONLY(CallStackEntry cse("InitializeNormalKernels"))
+    const int N0 = ::firstBandwidth;
+    const int N1 = ::secondBandwidth;
+    const int numTimesteps = ::numTimesteps;
+    const int numThreads = ::numNFFTThreads;
+    const int kernelSize = 4*N0*N1;
+
+    ::normalKernels = new DistMatrix<double,STAR,STAR>( ::coilPaths->Grid() );
+    Zeros( *::normalKernels, kernelSize, numTimesteps );
+    ComputeNormalKernels( 0, numTimesteps );
+
+    ::normalGrids.resize( numThreads );
+    for( int k=0; k<numThreads; ++k )
+        ::normalGrids[k] = 
+            (fftw_complex*)fftw_malloc( kernelSize*sizeof(fftw_complex) );
+    ::normalForward = 
+        fftw_plan_dft_2d
+        ( 2*N0, 2*N1, ::normalGrids[0], ::normalGrids[0], FFTW_FORWARD, 
+          FFTW_MEASURE );
+    ::normalBackward = 
+        fftw_plan_dft_2d
+        ( 2*N0, 2*N1, ::normalGrids[0], ::normalGrids[0], FFTW_BACKWARD, 
+          FFTW_MEASURE );
+
+    ::initializedNormalKernels = true;
+}
+
+void FinalizeNormalKernels()
+{
+    DEBUG_ONLY(CallStackEntry cse("FinalizeNormalKernels"))
+    fftw_destroy_plan( ::normalBackward );
+    fftw_destroy_plan( ::normalForward );
+    for( auto grid : ::normalGrids )
+        fftw_free( grid );
+    ::normalGrids.clear();
+    delete ::normalKernels;
+    ::initializedNormalKernels = false;
 }
 
+} // anonymous namespace
+
+// If normalKernels is true, then the kernels needed to apply the normal 
+// operator via Toeplitz embeddings (see NormalAcquisition) are precomputed
 void InitializeAcquisition
 ( const DistMatrix<double,         STAR,STAR>& dens, 
   const DistMatrix<Complex<double>,STAR,STAR>& sens,
   const DistMatrix<double,         STAR,STAR>& X, 
-  int numCoils, int N0, int N1, int n0, int n1, int m )
+  int numCoils, int N0, int N1, int n0, int n1, int m, int numThreads,
+  bool normalKernels )
 {
     DEBUG_ONLY(
         CallStackEntry cse("InitializeAcquisition");
@@ -242,7 +835,7 @@ void InitializeAcquisition
         if( dens.Height() != X.Height()/2 || dens.Width() != X.Width() )
             LogicError("Density composition matrix of the wrong size");
     )
-    InitializeCoilPlans( X, numCoils, N0, N1, n0, n1, m );
+    InitializeCoilPlans( X, numCoils, N0, N1, n0, n1, m, numThreads );
 
     ::densityComp = new DistMatrix<double,STAR,STAR>( dens );
 
@@ -270,6 +863,16 @@ void InitializeAcquisition
         }
     }
 
+    ::densityCompSingle = new DistMatrix<float,STAR,STAR>;
+    ::sensitivitySingle = new DistMatrix<Complex<float>,STAR,STAR>;
+    ::sensitivityScalingsSingle = new DistMatrix<float,STAR,STAR>;
+    ConvertLocal( *::densityComp, *::densityCompSingle );
+    ConvertLocal( *::sensitivity, *::sensitivitySingle );
+    ConvertLocal( *::sensitivityScalings, *::sensitivityScalingsSingle );
+
+    if( normalKernels )
+        InitializeNormalKernels();
+
     ::initializedAcquisition = true;
 }
 
@@ -286,10 +889,40 @@ void FinalizeCoilPlans()
     ::coilPlans.clear();
     delete ::coilPaths;
 
-    fftw_destroy_plan( ::fftwBackward );
-    fftw_destroy_plan( ::fftwForward );
-    nfft_free( ::g2 );
-    nfft_free( ::g1 );
+    const int numThreads = ::numNFFTThreads;
+    for( int k=0; k<numThreads; ++k )
+    {
+        fftw_destroy_plan( ::fftwBackwards[k] );
+        fftw_destroy_plan( ::fftwForwards[k] );
+        nfft_free( ::g2s[k] );
+        nfft_free( ::g1s[k] );
+    }
+    ::fftwBackwards.clear();
+    ::fftwForwards.clear();
+    ::g2s.clear();
+    ::g1s.clear();
+
+    for( auto& entry : ::coilBatchPlans )
+    {
+        fftw_destroy_plan( entry.second.second );
+        fftw_destroy_plan( entry.second.first );
+    }
+    ::coilBatchPlans.clear();
+#ifdef RTLPSMRI_HAVE_FFTWF
+    for( auto& entry : ::coilBatchPlansSingle )
+    {
+        fftwf_destroy_plan( entry.second.second );
+        fftwf_destroy_plan( entry.second.first );
+    }
+    ::coilBatchPlansSingle.clear();
+#endif
+    for( auto grid : ::coilBatchGrids )
+        nfft_free( grid );
+    ::coilBatchGrids.clear();
+    ::coilBatchCapacity = 0;
+
+    if( InitializedGridding() )
+        FinalizeGridding();
 
     ::initializedCoilPlans = false;
 }
@@ -302,12 +935,68 @@ void FinalizeAcquisition()
             LogicError("Have not yet initialized acquisition operator");
     )
     ::initializedAcquisition = false;
+    if( InitializedNormalKernels() )
+        FinalizeNormalKernels();
     delete ::densityComp;
     delete ::sensitivity;
     delete ::sensitivityScalings;
+    delete ::densityCompSingle;
+    delete ::sensitivitySingle;
+    delete ::sensitivityScalingsSingle;
     FinalizeCoilPlans();
 }
 
+// Slide the acquisition operator forward by one timestep: the first timestep
+// is dropped, the remaining timesteps move down by one, and the last timestep
+// is given the path (2*numNonUniform x 1) and density compensation 
+// (numNonUniform x 1) of the new frame. The NFFT plans, gridding matrices, 
+// and Toeplitz kernels of the retained timesteps are reused, so that only 
+// those of the new timestep are precomputed.
+void SlideAcquisition
+( const DistMatrix<double,STAR,STAR>& path,
+  const DistMatrix<double,STAR,STAR>& dens )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("SlideAcquisition");
+        if( !InitializedAcquisition() )
+            LogicError("Have not yet initialized acquisition operator");
+        if( path.Height() != 2*NumNonUniformPoints() || path.Width() != 1 )
+            LogicError("New path of the wrong size");
+        if( dens.Height() != NumNonUniformPoints() || dens.Width() != 1 )
+            LogicError("New density compensation of the wrong size");
+    )
+    const int numTimesteps = NumTimesteps();
+
+    // Release the precomputed data of the oldest timestep and rotate the 
+    // remaining plans of thread 0 down, along with their paths
+    nfft_finalize( &::coilPlans[0] );
+    std::rotate
+    ( ::coilPlans.begin(), ::coilPlans.begin()+1, 
+      ::coilPlans.begin()+numTimesteps );
+    ShiftColumns( *::coilPaths, path.LockedBuffer() );
+    for( int t=0; t<numTimesteps-1; ++t )
+        ::coilPlans[t].x = ::coilPaths->Buffer(0,t);
+    InitializeCoilPlan( numTimesteps-1 );
+    CopyCoilPlans();
+
+    if( InitializedGridding() )
+    {
+        std::rotate
+        ( ::griddingMatrices.begin(), ::griddingMatrices.begin()+1,
+          ::griddingMatrices.end() );
+        InitializeGriddingMatrix( numTimesteps-1 );
+    }
+
+    ShiftColumns( *::densityComp, dens.LockedBuffer() );
+    ConvertLocal( *::densityComp, *::densityCompSingle );
+
+    if( InitializedNormalKernels() )
+    {
+        ShiftColumns( *::normalKernels, (const double*)0 );
+        ComputeNormalKernels( numTimesteps-1, numTimesteps );
+    }
+}
+
 int NumCoils()
 {
     DEBUG_ONLY(
@@ -358,14 +1047,214 @@ int SecondBandwidth()
     return ::secondBandwidth; 
 }
 
-nfft_plan& CoilPlan( int path )
+int FirstFFTSize()
+{ 
+    DEBUG_ONLY(
+        CallStackEntry cse("FirstFFTSize");
+        if( !InitializedCoilPlans() )
+            LogicError("Have not yet initialized coil plans");
+    )
+    return ::firstFFTSize; 
+}
+
+int SecondFFTSize()
+{ 
+    DEBUG_ONLY(
+        CallStackEntry cse("SecondFFTSize");
+        if( !InitializedCoilPlans() )
+            LogicError("Have not yet initialized coil plans");
+    )
+    return ::secondFFTSize; 
+}
+
+int NumNFFTThreads()
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("NumNFFTThreads");
+        if( !InitializedCoilPlans() )
+            LogicError("Have not yet initialized coil plans");
+    )
+#ifdef RTLPSMRI_HAVE_OPENMP
+    if( ::numPlaneThreads > 1 && omp_get_level() > 0 )
+        return ::numNFFTThreads / ::numPlaneThreads;
+#endif
+    return ::numNFFTThreads;
+}
+
+nfft_plan& CoilPlan( int path, int thread )
 { 
+    thread += PlaneThreadOffset();
     DEBUG_ONLY(
         CallStackEntry cse("CoilPlan");
         if( !InitializedCoilPlans() )
             LogicError("Have not yet initialized coil plans");
+        if( thread < 0 || thread >= ::numNFFTThreads )
+            LogicError("Invalid NFFT thread index");
     )
-    return ::coilPlans[path]; 
+    return ::coilPlans[path+thread*::numTimesteps]; 
+}
+
+void ReserveCoilBatches( int batchSize )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("ReserveCoilBatches");
+        if( !InitializedCoilPlans() )
+            LogicError("Have not yet initialized coil plans");
+    )
+    if( batchSize <= ::coilBatchCapacity )
+        return;
+
+    const int nTotal = ::firstFFTSize*::secondFFTSize;
+    const int numThreads = ::numNFFTThreads;
+    for( auto grid : ::coilBatchGrids )
+        nfft_free( grid );
+    ::coilBatchGrids.resize( numThreads );
+    for( int k=0; k<numThreads; ++k )
+        ::coilBatchGrids[k] = 
+          (fftw_complex*)nfft_malloc( nTotal*batchSize*sizeof(fftw_complex) );
+    ::coilBatchCapacity = batchSize;
+}
+
+template<typename Real>
+typename FFTW<Real>::complex* CoilBatchGrid( int thread )
+{
+    thread += PlaneThreadOffset();
+    DEBUG_ONLY(
+        CallStackEntry cse("CoilBatchGrid");
+        if( thread < 0 || thread >= (int)::coilBatchGrids.size() )
+            LogicError("Coil batches were not reserved for this thread");
+    )
+    return reinterpret_cast<typename FFTW<Real>::complex*>
+           (::coilBatchGrids[thread]);
+}
+
+// The plans are formed on a temporary buffer (with the same alignment as the
+// grids returned by CoilBatchGrid) and are meant to be executed in place via
+// fftw_execute_dft.
+template<typename Real>
+typename FFTW<Real>::plan CoilBatchPlan( int batchSize, int sign )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("CoilBatchPlan");
+        if( !InitializedCoilPlans() )
+            LogicError("Have not yet initialized coil plans");
+    )
+    typedef FFTW<Real> fft;
+    typename fft::plan plan;
+    auto& plans = CoilBatchPlansOf( Real(0) );
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp critical(rtlpsmri_fftw_planner)
+#endif
+    {
+        auto it = plans.find( batchSize );
+        if( it == plans.end() )
+        {
+            const int dim = 2;
+            int nn[dim] = { ::firstFFTSize, ::secondFFTSize };
+            const int nTotal = nn[0]*nn[1];
+            unsigned fftwFlags = FFTW_MEASURE| FFTW_DESTROY_INPUT;
+            auto* buf = (typename fft::complex*)
+                nfft_malloc( nTotal*batchSize*sizeof(typename fft::complex) );
+            auto forward = 
+                fft::plan_many_dft
+                ( dim, nn, batchSize, 
+                  buf, NULL, batchSize, 1, 
+                  buf, NULL, batchSize, 1, FFTW_FORWARD, fftwFlags );
+            auto backward = 
+                fft::plan_many_dft
+                ( dim, nn, batchSize, 
+                  buf, NULL, batchSize, 1, 
+                  buf, NULL, batchSize, 1, FFTW_BACKWARD, fftwFlags );
+            nfft_free( buf );
+            it = plans.insert
+                 ( std::make_pair
+                   (batchSize,std::make_pair(forward,backward)) ).first;
+        }
+        plan = ( sign == FFTW_FORWARD ? it->second.first : it->second.second );
+    }
+    return plan;
+}
+
+template<typename Real>
+typename FFTW<Real>::plan 
+TemporalPlan( int n, int howMany, int ldim, int sign )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("TemporalPlan");
+        if( howMany > ldim )
+            LogicError("Rows of the transforms would overlap");
+    )
+    typedef FFTW<Real> fft;
+    typename fft::plan plan;
+    auto& plans = TemporalPlansOf( Real(0) );
+#ifdef RTLPSMRI_HAVE_OPENMP
+    #pragma omp critical(rtlpsmri_fftw_planner)
+#endif
+    {
+        const TemporalKey key( n, howMany, ldim, sign );
+        auto it = plans.find( key );
+        if( it == plans.end() )
+        {
+            // Plan on a temporary buffer so that no data is overwritten
+            unsigned fftwFlags = FFTW_MEASURE| FFTW_UNALIGNED;
+            const int bufSize = (n-1)*ldim + howMany;
+            auto* buf = (typename fft::complex*)
+                fft::malloc( bufSize*sizeof(typename fft::complex) );
+            plan = 
+                fft::plan_many_dft
+                ( 1, &n, howMany, 
+                  buf, NULL, ldim, 1, 
+                  buf, NULL, ldim, 1, sign, fftwFlags );
+            fft::free( buf );
+            plans.insert( std::make_pair(key,plan) );
+        }
+        else
+            plan = it->second;
+    }
+    return plan;
+}
+
+template fftw_complex* CoilBatchGrid<double>( int thread );
+template fftw_plan CoilBatchPlan<double>( int batchSize, int sign );
+template fftw_plan TemporalPlan<double>
+( int n, int howMany, int ldim, int sign );
+#ifdef RTLPSMRI_HAVE_FFTWF
+template fftwf_complex* CoilBatchGrid<float>( int thread );
+template fftwf_plan CoilBatchPlan<float>( int batchSize, int sign );
+template fftwf_plan TemporalPlan<float>
+( int n, int howMany, int ldim, int sign );
+#endif
+
+const GriddingMatrix& Gridding( int path )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("Gridding");
+        if( !InitializedGridding() )
+            LogicError("Have not yet initialized gridding matrices");
+        if( path < 0 || path >= ::numTimesteps )
+            LogicError("Invalid path index");
+    )
+    return ::griddingMatrices[path];
+}
+
+const std::vector<int>& GriddingIndices()
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("GriddingIndices");
+        if( !InitializedGridding() )
+            LogicError("Have not yet initialized gridding matrices");
+    )
+    return ::griddingIndices;
+}
+
+const std::vector<double>& Deapodization()
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("Deapodization");
+        if( !InitializedGridding() )
+            LogicError("Have not yet initialized gridding matrices");
+    )
+    return ::deapodization;
 }
 
 const DistMatrix<double,STAR,STAR>& CoilPaths()
@@ -378,34 +1267,80 @@ const DistMatrix<double,STAR,STAR>& CoilPaths()
     return *::coilPaths;
 }
 
-const DistMatrix<double,STAR,STAR>& DensityComp()
+template<typename Real>
+const DistMatrix<Real,STAR,STAR>& DensityComp()
 {
     DEBUG_ONLY(
         CallStackEntry cse("DensityComp");
         if( !InitializedAcquisition() )
             LogicError("Have not yet initialized acquisition operator");
     )
-    return *::densityComp;
+    return *DensityCompOf( Real(0) );
 }
 
-const DistMatrix<El::Complex<double>,STAR,STAR>& Sensitivity()
+template<typename Real>
+const DistMatrix<El::Complex<Real>,STAR,STAR>& Sensitivity()
 {
     DEBUG_ONLY(
         CallStackEntry cse("Sensitivity");
         if( !InitializedAcquisition() )
             LogicError("Have not yet initialized acquisition operator");
     )
-    return *::sensitivity;
+    return *SensitivityOf( Real(0) );
 }
 
-const DistMatrix<double,STAR,STAR>& SensitivityScalings()
+template<typename Real>
+const DistMatrix<Real,STAR,STAR>& SensitivityScalings()
 {
     DEBUG_ONLY(
         CallStackEntry cse("SensitivityScalings");
         if( !InitializedAcquisition() )
             LogicError("Have not yet initialized acquisition operator");
     )
-    return *::sensitivityScalings;
+    return *SensitivityScalingsOf( Real(0) );
+}
+
+#define PROTO(Real) \
+  template const DistMatrix<Real,STAR,STAR>& DensityComp<Real>(); \
+  template const DistMatrix<Complex<Real>,STAR,STAR>& Sensitivity<Real>(); \
+  template const DistMatrix<Real,STAR,STAR>& SensitivityScalings<Real>();
+
+PROTO(float)
+PROTO(double)
+
+#undef PROTO
+
+const DistMatrix<double,STAR,STAR>& NormalKernels()
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("NormalKernels");
+        if( !InitializedNormalKernels() )
+            LogicError("Have not yet initialized normal kernels");
+    )
+    return *::normalKernels;
+}
+
+fftw_complex* NormalGrid( int thread )
+{
+    thread += PlaneThreadOffset();
+    DEBUG_ONLY(
+        CallStackEntry cse("NormalGrid");
+        if( !InitializedNormalKernels() )
+            LogicError("Have not yet initialized normal kernels");
+        if( thread < 0 || thread >= (int)::normalGrids.size() )
+            LogicError("Invalid thread index");
+    )
+    return ::normalGrids[thread];
+}
+
+fftw_plan NormalPlan( int sign )
+{
+    DEBUG_ONLY(
+        CallStackEntry cse("NormalPlan");
+        if( !InitializedNormalKernels() )
+            LogicError("Have not yet initialized normal kernels");
+    )
+    return ( sign == FFTW_FORWARD ? ::normalForward : ::normalBackward );
 }
 
 } // namespace mri
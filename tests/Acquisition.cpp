@@ -35,11 +35,28 @@ main( int argc, char* argv[] )
         const int n0 = Input("--n0","FFT size in x direction",16);
         const int n1 = Input("--n1","FFT size in y direction",16);
         const int m = Input("--m","cutoff parameter",2);
+        const int nfftThreads = 
+            Input("--nfftThreads","threads for local NFFTs (0 for max)",1);
+        const int nfftTypeInt = 
+            Input
+            ("--nfftType","0: per-coil, 1: coil-batched, 2: native",0);
+        const int pipelineChunks = 
+            Input
+            ("--pipelineChunks","timestep chunks for overlapping comm.",1);
+        const bool toeplitz = 
+            Input("--toeplitz","apply E'E via Toeplitz embeddings?",false);
+        const bool single = 
+            Input("--single","compare against single precision?",false);
         const bool print = Input("--print","print matrices?",false);
         const bool display = Input("--display","display matrices?",false);
         ProcessInput();
         PrintInputReport();
 
+        if( nfftTypeInt < 0 || nfftTypeInt >= NFFTType_MAX )
+            LogicError("NFFT type integer must be in [0,",NFFTType_MAX,")");
+        SetNFFTType( static_cast<NFFTType>(nfftTypeInt) );
+        SetNumPipelineChunks( pipelineChunks );
+
         // Sample from [0,1] and then have the top half of the matrix sorted
         // downwards, and the bottom-half upwards. 
         DistMatrix<double,STAR,STAR> densityComp;
@@ -81,7 +98,8 @@ main( int argc, char* argv[] )
 
         // Initialize acquisition operator and its adjoint
         InitializeAcquisition
-        ( densityComp, sensitivity, paths, nc, N0, N1, n0, n1, m );
+        ( densityComp, sensitivity, paths, nc, N0, N1, n0, n1, m, 
+          nfftThreads, toeplitz );
 
         // Apply the adjoint of the acquisition operator
         DistMatrix<Complex<double>,VC,STAR> M;
@@ -98,6 +116,106 @@ main( int argc, char* argv[] )
             Print( R, "R := E M = E E' D" );
         if( display )
             Display( R, "R := E M = E E' D" );
+
+        if( pipelineChunks > 1 )
+        {
+            // Compare against the bulk-synchronous operators
+            SetNumPipelineChunks( 1 );
+            DistMatrix<Complex<double>,VC,STAR> MBulk;
+            DistMatrix<Complex<double>,STAR,VR> RBulk;
+            AdjointAcquisition( data, MBulk );
+            Acquisition( M, RBulk );
+            SetNumPipelineChunks( pipelineChunks );
+            const double frobM = FrobeniusNorm( MBulk );
+            const double frobR = FrobeniusNorm( RBulk );
+            Axpy( Complex<double>(-1), M, MBulk );
+            Axpy( Complex<double>(-1), R, RBulk );
+            const double frobMError = FrobeniusNorm( MBulk );
+            const double frobRError = FrobeniusNorm( RBulk );
+            if( mpi::WorldRank() == 0 )
+                std::cout << "pipelined relative errors: \n"
+                          << "  E' D: " << frobMError/frobM << "\n"
+                          << "  E M:  " << frobRError/frobR << std::endl;
+        }
+
+        // Compare the fused scatter against the redundant scatter followed 
+        // by the sensitivity scaling
+        {
+            DistMatrix<Complex<double>,STAR,VR> scattered, scatteredFused;
+            AcquisitionWorkspace<double> work;
+            acquisition::Scatter( M, scattered );
+            acquisition::ScaleBySensitivities( scattered );
+            acquisition::ScatterAndScale( M, scatteredFused, work );
+            const double frobScattered = FrobeniusNorm( scattered );
+            Axpy( Complex<double>(-1), scattered, scatteredFused );
+            const double frobError = FrobeniusNorm( scatteredFused );
+            if( mpi::WorldRank() == 0 )
+                std::cout << "|| ScatterAndScale - Scatter ||_F / "
+                             "|| Scatter ||_F = " 
+                          << frobError/frobScattered << std::endl;
+        }
+
+        // Compare the fused coil contraction against prescaling, 
+        // redistributing, and then contracting
+        {
+            DistMatrix<Complex<double>,STAR,VR> FHat;
+            DistMatrix<Complex<double>,VC,STAR> images, imagesFused;
+            AcquisitionWorkspace<double> work;
+            acquisition::AdjointNFFT( data, FHat );
+            acquisition::PrescaleAndContract( FHat, imagesFused, work );
+            acquisition::ContractionPrescaling( FHat );
+            acquisition::CoilContraction( FHat, images );
+            const double frobImages = FrobeniusNorm( images );
+            Axpy( Complex<double>(-1), images, imagesFused );
+            const double frobError = FrobeniusNorm( imagesFused );
+            if( mpi::WorldRank() == 0 )
+                std::cout << "|| PrescaleAndContract - CoilContraction ||_F / "
+                             "|| CoilContraction ||_F = " 
+                          << frobError/frobImages << std::endl;
+        }
+
+        if( toeplitz )
+        {
+            // Compare E'E M applied via the Toeplitz embeddings against
+            // applying the adjoint acquisition to R = E M
+            DistMatrix<Complex<double>,VC,STAR> N, NToeplitz;
+            AdjointAcquisition( R, N );
+            NormalAcquisition( M, NToeplitz );
+            const double frobN = FrobeniusNorm( N );
+            Axpy( Complex<double>(-1), N, NToeplitz );
+            const double frobError = FrobeniusNorm( NToeplitz );
+            if( mpi::WorldRank() == 0 )
+                std::cout << "|| E'E M - E'(E M) ||_F / || E'(E M) ||_F = "
+                          << frobError/frobN << std::endl;
+        }
+#ifdef RTLPSMRI_HAVE_FFTWF
+        if( single )
+        {
+            // Compare E' D and E M against their single-precision analogues
+            DistMatrix<Complex<float>,STAR,VR> dataSingle, RSingle;
+            DistMatrix<Complex<float>,VC,STAR> MSingle;
+            DistMatrix<Complex<double>,STAR,VR> RConverted;
+            DistMatrix<Complex<double>,VC,STAR> MConverted;
+            Convert( data, dataSingle );
+            AdjointAcquisition( dataSingle, MSingle );
+            Acquisition( MSingle, RSingle );
+            Convert( MSingle, MConverted );
+            Convert( RSingle, RConverted );
+            const double frobM = FrobeniusNorm( M );
+            const double frobR = FrobeniusNorm( R );
+            Axpy( Complex<double>(-1), M, MConverted );
+            Axpy( Complex<double>(-1), R, RConverted );
+            const double frobMError = FrobeniusNorm( MConverted );
+            const double frobRError = FrobeniusNorm( RConverted );
+            if( mpi::WorldRank() == 0 )
+                std::cout << "single-precision relative errors: \n"
+                          << "  E' D: " << frobMError/frobM << "\n"
+                          << "  E M:  " << frobRError/frobR << std::endl;
+        }
+#else
+        if( single )
+            LogicError("Single precision requires FFTW3's float interface");
+#endif
     }
     catch( std::exception& e ) { ReportException(e); }
 
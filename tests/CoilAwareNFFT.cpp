@@ -35,11 +35,20 @@ main( int argc, char* argv[] )
         const int n0 = Input("--n0","FFT size in x direction",16);
         const int n1 = Input("--n1","FFT size in y direction",16);
         const int m = Input("--m","cutoff parameter",2);
+        const int nfftThreads = 
+            Input("--nfftThreads","threads for local NFFTs (0 for max)",1);
+        const int nfftTypeInt = 
+            Input
+            ("--nfftType","0: per-coil, 1: coil-batched, 2: native",0);
         const bool print = Input("--print","print matrices?",false);
         const bool display = Input("--display","display matrices?",false);
         ProcessInput();
         PrintInputReport();
 
+        if( nfftTypeInt < 0 || nfftTypeInt >= NFFTType_MAX )
+            LogicError("NFFT type integer must be in [0,",NFFTType_MAX,")");
+        SetNFFTType( static_cast<NFFTType>(nfftTypeInt) );
+
         DistMatrix<double,STAR,STAR> paths;
         DistMatrix<Complex<double>,STAR,VR> F, FDirect, FHat, FHatDirect;
 
@@ -48,7 +57,7 @@ main( int argc, char* argv[] )
         Uniform( paths, 2*nnu, nt, 0., 0.5 );
 
         // Initialize the coil plans
-        InitializeCoilPlans( paths, nc, N0, N1, n0, n1, m );
+        InitializeCoilPlans( paths, nc, N0, N1, n0, n1, m, nfftThreads );
 
         // Generate a random source vector
         Uniform( FHat, N0*N1, nc*nt );
@@ -63,7 +72,10 @@ main( int argc, char* argv[] )
             Display( FHat, "FHat" );
         }
 
-        CoilAwareNFFT2D( FHat, F );
+        El::Timer timer("");
+        timer.Start();
+        acquisition::NFFT( FHat, F );
+        const double forwardTime = timer.Stop();
         if( print )
             Print( F, "F after forward" );
         if( display )
@@ -75,7 +87,9 @@ main( int argc, char* argv[] )
         if( display )
             Display( FDirect, "F after direct forward" );
 
-        CoilAwareAdjointNFFT2D( F, FHat );
+        timer.Start();
+        acquisition::AdjointNFFT( F, FHat );
+        const double adjointTime = timer.Stop();
         if( print )
             Print( FHat, "FHat after adjoint" );
         if( display )
@@ -103,6 +117,9 @@ main( int argc, char* argv[] )
                       << "|| EHat ||_F = " << frobEHat << "\n"
                       << "|| EHat ||_F / || FHat ||_F = " 
                       << frobEHat/frobFHatDir << "\n"
+                      << "\n"
+                      << "forward time: " << forwardTime << " seconds\n"
+                      << "adjoint time: " << adjointTime << " seconds\n"
                       << std::endl;
         }
     }
@@ -0,0 +1,168 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "rt-lps-mri.hpp"
+using namespace mri;
+
+typedef double Real;
+typedef Complex<Real> F;
+
+// Writes a random low-rank L and sparse S with WriteLPSContainer (in double
+// and single precision) and with WriteLPSCompressed for every value type 
+// (with both TV and the temporal FFT as the sparsifying transform), reads 
+// every frame back with ReadLPSContainerFrame or ReadLPSCompressedFrame, and
+// reports the relative errors
+int 
+main( int argc, char* argv[] )
+{
+    Initialize( argc, argv );
+    const int commRank = mpi::WorldRank();
+
+    try
+    {
+        const int nc = Input("--nc","number of coils",16);
+        const int nt = Input("--nt","number of timesteps",10);
+        const int N0 = Input("--N0","bandwidth in x direction",6);
+        const int N1 = Input("--N1","bandwidth in y direction",6);
+        const int nnu = Input("--nnu","number of non-uniform nodes",36);
+        const int n0 = Input("--n0","FFT size in x direction",16);
+        const int n1 = Input("--n1","FFT size in y direction",16);
+        const int m = Input("--m","cutoff parameter",2);
+        const int rank = Input("--rank","rank of L",3);
+        const double density = 
+            Input("--density","fraction of nonzeros in S",0.1);
+        const double scale = Input("--scale","scale of L and S",1e6);
+        const double dropTol = Input("--dropTol","drop tolerance for S",0.);
+        ProcessInput();
+        PrintInputReport();
+
+        // The temporal FFTs require the coil plans
+        DistMatrix<double,STAR,STAR> paths;
+        Uniform( paths, 2*nnu, nt, 0., 0.5 );
+        InitializeCoilPlans( paths, nc, N0, N1, n0, n1, m );
+
+        // L := scale A B'
+        DistMatrix<F,VC,STAR> A, L;
+        DistMatrix<F,STAR,STAR> B;
+        Uniform( A, N0*N1, rank );
+        Uniform( B, nt, rank );
+        L.AlignWith( A );
+        L.Resize( N0*N1, nt );
+        El::LocalGemm( NORMAL, ADJOINT, F(scale), A, B, F(0), L );
+
+        // S := scale times a random matrix with roughly density*N0*N1*nt 
+        // nonzeros
+        DistMatrix<F,VC,STAR> S;
+        S.AlignWith( L );
+        Uniform( S, N0*N1, nt );
+        for( int j=0; j<nt; ++j )
+            for( int iLoc=0; iLoc<S.LocalHeight(); ++iLoc )
+            {
+                // |value|^2 is uniform over [0,1]
+                const F value = S.GetLocal(iLoc,j);
+                const bool keep = std::norm(value) < density;
+                S.SetLocal( iLoc, j, ( keep ? scale*value : F(0) ) );
+            }
+
+        const DistMatrix<F,STAR,STAR> LRep( L ), SRep( S );
+        const Real frobL = FrobeniusNorm( L );
+        const Real frobS = FrobeniusNorm( S );
+        // Both files are read back by the root, which compares frame t 
+        // against the replicated copies of L and S
+        auto frameErrors = 
+          [&]( int t, const Matrix<F>& LFrame, const Matrix<F>& SFrame,
+               double& errorLSq, double& errorSSq )
+        {
+            for( int j=0; j<N1; ++j )
+                for( int i=0; i<N0; ++i )
+                {
+                    const int p = j + i*N1;
+                    errorLSq += std::norm(LFrame.Get(i,j)-LRep.GetLocal(p,t));
+                    errorSSq += std::norm(SFrame.Get(i,j)-SRep.GetLocal(p,t));
+                }
+        };
+        auto report = 
+          [&]( std::string name, double errorLSq, double errorSSq )
+        {
+            std::cout << name << ":\n"
+                      << "  || L-L~ ||_F / || L ||_F = " 
+                      << Sqrt(errorLSq)/frobL << "\n"
+                      << "  || S-S~ ||_F / || S ||_F = " 
+                      << Sqrt(errorSSq)/frobS << "\n" << std::endl;
+        };
+
+        // The container stores the frames as is, which should be exact in 
+        // double precision
+        DistMatrix<Complex<float>,VC,STAR> LSingle, SSingle;
+        Convert( L, LSingle );
+        Convert( S, SSingle );
+        for( int single=0; single<2; ++single )
+        {
+            if( single )
+                WriteLPSContainer( LSingle, SSingle, N0, N1, 0 );
+            else
+                WriteLPSContainer( L, S, N0, N1, 0 );
+            mpi::Barrier( mpi::COMM_WORLD );
+            if( commRank != 0 )
+                continue;
+
+            Matrix<F> LFrame, SFrame;
+            double errorLSq=0, errorSSq=0;
+            for( int t=0; t<nt; ++t )
+            {
+                ReadLPSContainerFrame( "LPS-0-tv.bin", t, LFrame, SFrame );
+                frameErrors( t, LFrame, SFrame, errorLSq, errorSSq );
+            }
+            report
+            ( ( single ? "container, float32" : "container, float64" ),
+              errorLSq, errorSSq );
+        }
+
+        const char* typeNames[] = { "float64", "float32", "float16" };
+        for( int tv=1; tv>=0; --tv )
+        {
+            for( int type=0; type<LPSValueType_MAX; ++type )
+            {
+                const auto valueType = static_cast<LPSValueType>(type);
+                WriteLPSCompressed
+                ( L, S, N0, N1, 0, tv, valueType, dropTol );
+                mpi::Barrier( mpi::COMM_WORLD );
+                if( commRank != 0 )
+                    continue;
+
+                std::ostringstream os;
+                os << "LPSC-0" << ( tv ? "-tv" : "-temporal" ) << ".bin";
+                Matrix<F> LFrame, SFrame;
+                double errorLSq=0, errorSSq=0;
+                for( int t=0; t<nt; ++t )
+                {
+                    ReadLPSCompressedFrame( os.str(), t, LFrame, SFrame );
+                    frameErrors( t, LFrame, SFrame, errorLSq, errorSSq );
+                }
+                report
+                ( std::string( tv ? "TV, " : "temporal FFT, " )+
+                  typeNames[type], errorLSq, errorSSq );
+            }
+        }
+    }
+    catch( std::exception& e ) { ReportException(e); }
+
+    Finalize();
+    return 0;
+}
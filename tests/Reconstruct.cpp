@@ -18,9 +18,164 @@
    along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "rt-lps-mri.hpp"
+#include <memory>
 using namespace mri;
 using std::string;
 
+// The LPS temporaries, along with the solution of the last plane, are reused
+// for each plane processed on a given grid
+template<typename Real>
+struct PlaneState
+{
+    LPSWorkspace<Real> work;
+    DistMatrix<Complex<Real>,VC,STAR> L, S;
+    bool haveNeighbor;
+
+    PlaneState( const Grid& grid )
+    : work(grid), L(grid), S(grid), haveNeighbor(false)
+    { }
+
+    void SetGrid( const Grid& grid )
+    {
+        work.SetGrid( grid );
+        L.SetGrid( grid );
+        S.SetGrid( grid );
+        haveNeighbor = false;
+    }
+};
+
+// Each thread of plane-level parallelism (or the process as a whole, if 
+// there is only one) reconstructs its planes over its own grid, using its own
+// data and L+S state. The grids must be created by a single thread.
+struct PlaneWorker
+{
+    int lastPlane;
+    Grid selfGrid;
+    DistMatrix<Complex<double>,STAR,VR> data;
+    PlaneState<double> state;
+#ifdef RTLPSMRI_HAVE_FFTWF
+    PlaneState<float> stateSingle;
+#endif
+    // Reads the next plane of this worker over selfGrid in the background
+    std::unique_ptr<PlanePrefetcher> prefetcher;
+    // Writes the output of this worker over selfGrid in the background
+    std::unique_ptr<AsyncWriter> writer;
+
+    PlaneWorker()
+    : lastPlane(-1), selfGrid(mpi::COMM_SELF), data(selfGrid), state(selfGrid)
+#ifdef RTLPSMRI_HAVE_FFTWF
+    , stateSingle(selfGrid)
+#endif
+    { }
+
+    void SetGrid( const Grid& grid )
+    {
+        data.SetGrid( grid );
+        state.SetGrid( grid );
+#ifdef RTLPSMRI_HAVE_FFTWF
+        stateSingle.SetGrid( grid );
+#endif
+    }
+
+    void ForgetNeighbor()
+    {
+        state.haveNeighbor = false;
+#ifdef RTLPSMRI_HAVE_FFTWF
+        stateSingle.haveNeighbor = false;
+#endif
+    }
+};
+
+inline int
+PlaneThread()
+{
+#ifdef RTLPSMRI_HAVE_OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+inline int
+NumActivePlaneThreads()
+{
+#ifdef RTLPSMRI_HAVE_OPENMP
+    return omp_get_num_threads();
+#else
+    return 1;
+#endif
+}
+
+// The data is always loaded in double precision, and then converted to the
+// precision of the reconstruction. If warmPlanes is true, the plane is 
+// seeded from the last plane solved on the same grid. If writer is non-null,
+// L and S are written in the background.
+template<typename Real>
+void
+SolvePlane
+( const DistMatrix<Complex<double>,STAR,VR>& data, 
+  PlaneState<Real>& state,
+  int N0, int N1, int plane, const LPSCtrl& ctrl, bool warmPlanes,
+  bool write, const LPSOutputCtrl& output, AsyncWriter* writer )
+{
+    DistMatrix<Complex<Real>,STAR,VR> D( data.Grid() );
+    Convert( data, D );
+    LPSCtrl planeCtrl = ctrl;
+    if( warmPlanes && state.haveNeighbor && 
+        &state.L.Grid() == &data.Grid() )
+    {
+        SeedFromNeighbor( D, state.L, state.S, state.work, ctrl.progress );
+        planeCtrl.warmStart = true;
+    }
+    const int numIts = LPS( D, state.L, state.S, state.work, planeCtrl );
+    state.haveNeighbor = true;
+    if( data.Grid().Rank() == 0 )
+        std::cout << "Plane " << plane << " took " << numIts 
+                  << " iterations" << std::endl;
+    if( write )
+    {
+        if( writer )
+            writer->WriteLPS
+            ( state.L, state.S, N0, N1, plane, ctrl.tv, output );
+        else
+            WriteLPS( state.L, state.S, N0, N1, plane, ctrl.tv, output );
+    }
+}
+
+// Alternatively, several planes can be stacked side by side in the data and
+// reconstructed jointly with BatchedLPS
+template<typename Real>
+void
+SolveStackedPlanes
+( const DistMatrix<Complex<double>,STAR,VR>& data, 
+  PlaneState<Real>& state,
+  int N0, int N1, int firstPlane, int numPlanes, const LPSCtrl& ctrl, 
+  bool write, const LPSOutputCtrl& output )
+{
+    DistMatrix<Complex<Real>,STAR,VR> D( data.Grid() );
+    Convert( data, D );
+    const int numIts = 
+        BatchedLPS( D, state.L, state.S, state.work, ctrl, numPlanes );
+    state.haveNeighbor = false;
+    if( data.Grid().Rank() == 0 )
+        std::cout << "Planes " << firstPlane << " through " 
+                  << firstPlane+numPlanes-1 << " took " << numIts 
+                  << " iterations" << std::endl;
+    if( write )
+    {
+        const int nt = NumTimesteps();
+        DistMatrix<Complex<Real>,VC,STAR> LPlane( data.Grid() ),
+                                          SPlane( data.Grid() );
+        for( int k=0; k<numPlanes; ++k )
+        {
+            El::LockedView( LPlane, state.L, 0, k*nt, state.L.Height(), nt );
+            El::LockedView( SPlane, state.S, 0, k*nt, state.S.Height(), nt );
+            const int plane = firstPlane + k;
+            WriteLPS( LPlane, SPlane, N0, N1, plane, ctrl.tv, output );
+        }
+    }
+}
+
 int 
 main( int argc, char* argv[] )
 {
@@ -29,6 +184,9 @@ main( int argc, char* argv[] )
     const int commRank = mpi::Rank( comm );
     const int commSize = mpi::Size( comm );
 
+    // The workers outlive the try block so that, if anything throws, their 
+    // background writes can still be flushed (and their errors reported)
+    std::vector<std::unique_ptr<PlaneWorker>> workers;
     try
     {
         const int np = Input("--np","number of planes to process",38);
@@ -40,6 +198,16 @@ main( int argc, char* argv[] )
         const int n0 = Input("--n0","FFT size in x direction",16);
         const int n1 = Input("--n1","FFT size in y direction",16);
         const int m = Input("--m","cutoff parameter",2);
+        const int nfftThreads = 
+            Input("--nfftThreads","threads for local NFFTs (0 for max)",1);
+        const int nfftTypeInt = 
+            Input
+            ("--nfftType","0: per-coil, 1: coil-batched, 2: native",0);
+        const int pipelineChunks = 
+            Input
+            ("--pipelineChunks","timestep chunks for overlapping comm.",1);
+        const bool toeplitz = 
+            Input("--toeplitz","apply E'E via Toeplitz embeddings?",false);
         const bool tv = Input("--tv","TV clipping for sparsity",true);
         const double lambdaL = Input("--lambdaL","low-rank scale",0.025);
         const double lambdaSRel = Input("--lambdaSRel","sparse rel scale",0.5);
@@ -47,6 +215,34 @@ main( int argc, char* argv[] )
         const int maxIts = Input("--maxIts","max L+S iterations",100);
         const bool tryTSQR = Input("--tryTSQR","try Tall-Skinny QR?",false);
         const bool progress = Input("--progress","print L+S progress",true);
+        const int solverInt = 
+            Input("--solver","0: proximal gradient, 1: accelerated",0);
+        const bool restart = 
+            Input("--restart","adaptive restart of accelerated solver",true);
+        const bool partialSVT = 
+            Input
+            ("--partialSVT","only compute leading singular triplets?",false);
+        const int svtOversample = 
+            Input("--svtOversample","oversampling for partial SVT",5);
+        const bool warmPlanes = 
+            Input("--warmPlanes","seed planes from their neighbours?",false);
+        const int planeThreads = 
+            Input("--planeThreads","planes solved concurrently per process",1);
+        const bool dynamic = 
+            Input("--dynamic","dynamically schedule the planes?",false);
+        const int teamSize = 
+            Input("--teamSize","processes per tail plane if dynamic",1);
+        const bool batchRemainder = 
+            Input
+            ("--batchRemainder","jointly solve the remaining planes?",false);
+        bool prefetch = 
+            Input("--prefetch","read the next plane in the background?",false);
+        bool asyncWrite = 
+            Input("--asyncWrite","write the output in the background?",false);
+        const int writeQueue = 
+            Input("--writeQueue","max. pending background writes",2);
+        const bool single = 
+            Input("--single","single-precision reconstruction?",false);
         const string sensName = 
             Input("--sens","sens. filename",string("sensitivity.bin"));
         const string densName = 
@@ -55,8 +251,18 @@ main( int argc, char* argv[] )
             Input("--path","paths filename",string("paths.bin"));
         const string dataBase = 
             Input("--data","data base filename",string("data"));
+        const int sampleTypeInt = 
+            Input("--sampleType","data: 0: complex f64, 1: f32, 2: int16",0);
+        const string scalesName = 
+            Input("--scales","per-plane data scales file",string(""));
         const bool display = Input("--display","display matrices?",false);
         const bool write = Input("--write","write matrices?",true);
+        const int outputInt = 
+            Input("--output","0: frames, 1: container, 2: compressed",0);
+        const int valueTypeInt = 
+            Input("--valueType","compressed values: 0: f64, 1: f32, 2: f16",1);
+        const double dropTol = 
+            Input("--dropTol","relative drop tolerance for compressed S",1e-6);
 #ifdef HAVE_QT5
         const int formatInt = Input("--format","format to store matrices",7);
 #else
@@ -65,9 +271,91 @@ main( int argc, char* argv[] )
         ProcessInput();
         PrintInputReport();
 
+        if( nfftTypeInt < 0 || nfftTypeInt >= NFFTType_MAX )
+            LogicError("NFFT type integer must be in [0,",NFFTType_MAX,")");
+        SetNFFTType( static_cast<NFFTType>(nfftTypeInt) );
+        SetNumPipelineChunks( pipelineChunks );
+
+        if( solverInt < 0 || solverInt >= LPSSolver_MAX )
+            LogicError("Solver integer must be in [0,",LPSSolver_MAX,")");
+        LPSCtrl ctrl;
+        ctrl.tv = tv;
+        ctrl.lambdaL = lambdaL;
+        ctrl.lambdaSRelMaxM = lambdaSRel;
+        ctrl.relTol = relTol;
+        ctrl.maxIts = maxIts;
+        ctrl.tryTSQR = tryTSQR;
+        ctrl.progress = progress;
+        ctrl.solver = static_cast<LPSSolver>(solverInt);
+        ctrl.adaptiveRestart = restart;
+        ctrl.partialSVT = partialSVT;
+        ctrl.svtOversample = svtOversample;
+
         if( formatInt < 1 || formatInt >= FileFormat_MAX )
             LogicError("Format integer must be in [1,",FileFormat_MAX,")");
         const auto format = static_cast<El::FileFormat>(formatInt);
+        if( outputInt < 0 || outputInt >= LPSOutputMode_MAX )
+            LogicError("Output integer must be in [0,",LPSOutputMode_MAX,")");
+        if( valueTypeInt < 0 || valueTypeInt >= LPSValueType_MAX )
+            LogicError
+            ("Value type integer must be in [0,",LPSValueType_MAX,")");
+        if( sampleTypeInt < 0 || sampleTypeInt >= KSpaceSampleType_MAX )
+            LogicError
+            ("Sample type integer must be in [0,",KSpaceSampleType_MAX,")");
+        const auto sampleType = static_cast<KSpaceSampleType>(sampleTypeInt);
+        LPSOutputCtrl output;
+        output.mode = static_cast<LPSOutputMode>(outputInt);
+        output.format = format;
+        output.valueType = static_cast<LPSValueType>(valueTypeInt);
+        output.dropTol = dropTol;
+
+#ifndef RTLPSMRI_HAVE_FFTWF
+        if( single )
+            LogicError("Single precision requires FFTW3's float interface");
+#endif
+        if( planeThreads > 1 )
+        {
+            int provided;
+            MPI_Query_thread( &provided );
+            if( provided < MPI_THREAD_MULTIPLE )
+                LogicError("Plane threads require MPI_THREAD_MULTIPLE");
+            if( display )
+                LogicError("Cannot display matrices from plane threads");
+#ifndef EL_RELEASE
+            // Elemental's debug call stack is not thread-safe, and every 
+            // plane thread calls into Elemental
+            LogicError("Plane threads require a release build of Elemental");
+#endif
+        }
+        if( prefetch || asyncWrite )
+        {
+            int provided;
+            MPI_Query_thread( &provided );
+            if( provided < MPI_THREAD_MULTIPLE )
+            {
+                if( commRank == 0 )
+                    std::cout << "Disabling background reads and writes since"
+                                 " MPI does not provide MPI_THREAD_MULTIPLE" 
+                              << std::endl;
+                prefetch = false;
+                asyncWrite = false;
+            }
+#ifndef EL_RELEASE
+            // Elemental's debug call stack is not thread-safe, and the
+            // background threads call into Elemental
+            if( commRank == 0 )
+                std::cout << "Disabling background reads and writes since"
+                             " Elemental is a debug build" << std::endl;
+            prefetch = false;
+            asyncWrite = false;
+#endif
+        }
+        if( batchRemainder && ctrl.solver != LPS_PROXIMAL_GRADIENT )
+            LogicError("Joint solves require the proximal-gradient solver");
+#ifndef RTLPSMRI_HAVE_MPI3
+        if( dynamic )
+            LogicError("Dynamic plane scheduling requires MPI-3");
+#endif
 
         // Load and possibly display and write the plane-independent data
         mpi::Barrier( comm );
@@ -82,6 +370,15 @@ main( int argc, char* argv[] )
         LoadPaths( nnu, nt, pathsName, paths );
         LoadDensity( nnu, nt, densName, densityComp );
         LoadSensitivity( N0, N1, nc, sensName, sensitivity );
+        std::vector<double> scales;
+        if( scalesName != "" )
+        {
+            DistMatrix<double,STAR,STAR> scalesMat( np, 1 );
+            ReadReplicated( scalesMat, scalesName );
+            scales.resize( np );
+            for( int plane=0; plane<np; ++plane )
+                scales[plane] = scalesMat.GetLocal( plane, 0 );
+        }
         mpi::Barrier( comm );
         if( commRank == 0 )
             std::cout << "DONE. " << mpi::Time()-startLoad << " seconds" 
@@ -107,99 +404,322 @@ main( int argc, char* argv[] )
             std::cout << "Initializing acquisition operator...";
             std::cout.flush();
         }
+        // Each plane thread receives its own set of NFFT threads
         InitializeAcquisition
-        ( densityComp, sensitivity, paths, nc, N0, N1, n0, n1, m );
+        ( densityComp, sensitivity, paths, nc, N0, N1, n0, n1, m, 
+          ( nfftThreads > 0 ? nfftThreads*planeThreads : 0 ), toeplitz );
+        SetNumPlaneThreads( planeThreads );
         mpi::Barrier( comm );
         if( commRank == 0 )
             std::cout << "DONE. " << mpi::Time()-startInit << " seconds"
                       << std::endl;
 
-        // Exploit the available trivial plane parallelism
-        mpi::Barrier( comm );
-        if( commRank == 0 )
-            std::cout << "Starting trivially parallel work..." << std::endl;
-        const double trivialStart = mpi::Time();
-        const int numSeqRounds = np / commSize;
-        Grid selfGrid( mpi::COMM_SELF );
-        DistMatrix<Complex<double>,STAR,VR> data(selfGrid);
-        DistMatrix<Complex<double>,VC,STAR> L(selfGrid), S(selfGrid);
-        for( Int round=0; round<numSeqRounds; ++round )
+        workers.resize( planeThreads );
+        for( auto& worker : workers )
+        {
+            worker.reset( new PlaneWorker );
+            if( prefetch )
+                worker->prefetcher.reset
+                ( new PlanePrefetcher
+                  ( worker->selfGrid, nnu, nc, nt, dataBase, sampleType, 
+                    scales ) );
+            if( write && asyncWrite )
+                worker->writer.reset
+                ( new AsyncWriter( worker->selfGrid, writeQueue ) );
+        }
+
+        // Possibly display and write the data for a plane (in the 
+        // background if writer is non-null)
+        auto reportPlane = 
+          [&]( const DistMatrix<Complex<double>,STAR,VR>& data, int plane,
+               AsyncWriter* writer )
         {
-            const int plane = commRank + round*commSize;
-            std::ostringstream os, binOs;
+            std::ostringstream os;
             os << dataBase << "-" << plane;
-            LoadData( nnu, nc, nt, os.str()+".bin", data );
             if( display )
                 Display( data, os.str() );
-            if( write )
+            if( write && writer )
+                writer->Write( data, os.str(), format );
+            else if( write )
                 Write( data, os.str(), format );
+        };
 
-            LPS
-            ( data, L, S, tv, lambdaL, lambdaSRel, relTol, maxIts, tryTSQR, 
-              progress );
-            if( write )
-                WriteLPS( L, S, N0, N1, plane, tv, format );
-        }
-        mpi::Barrier( comm );
-        if( commRank == 0 )
-            std::cout << "Finished trivially parallel section: " 
-                      << mpi::Time()-trivialStart << " seconds" << std::endl;
+        // Load (and possibly display and write) the data for a plane
+        auto loadPlane = 
+          [&]( DistMatrix<Complex<double>,STAR,VR>& data, int plane, 
+               AsyncWriter* writer )
+        {
+            std::ostringstream os;
+            os << dataBase << "-" << plane;
+            const double scale = ( scales.empty() ? 1. : scales[plane] );
+            LoadData
+            ( nnu, nc, nt, os.str()+".bin", data, sampleType, scale );
+            reportPlane( data, plane, writer );
+        };
 
-        // Process the remaining planes using subteams
-        mpi::Barrier( comm );
-        if( commRank == 0 )
-            std::cout << "Starting parallel work..." << std::endl;
-        const double parallelStart = mpi::Time(); 
-        const int numSeqPlanes = numSeqRounds*commSize; 
-        const int numParPlanes = np - numSeqPlanes;
-        if( numParPlanes > 0 )
+        // Load the data for a plane and then reconstruct it over the current
+        // grid of the worker. When the worker is on its own grid, the data 
+        // may already have been prefetched, and the read of nextPlane (if it
+        // is not -1) is started before the reconstruction.
+        auto processPlane = [&]( PlaneWorker& w, int plane, int nextPlane )
         {
-            // Split the communicator
-            int color, key;
-            const int mainTeamSize = commSize / numParPlanes;
-            if( commRank < mainTeamSize*(numParPlanes-1) )
+            // A plane can only be seeded from the plane directly before it
+            if( plane != w.lastPlane+1 )
+                w.ForgetNeighbor();
+            w.lastPlane = plane;
+
+            // The background stages only serve the worker's own grid
+            const bool onSelfGrid = &w.data.Grid() == &w.selfGrid;
+            AsyncWriter* writer = ( onSelfGrid ? w.writer.get() : 0 );
+            const DistMatrix<Complex<double>,STAR,VR>* data = &w.data;
+            if( w.prefetcher && onSelfGrid )
             {
-                color = commRank / mainTeamSize;
-                key = commRank % mainTeamSize;
-            } 
+                data = &w.prefetcher->Get( plane, nextPlane );
+                reportPlane( *data, plane, writer );
+            }
             else
+                loadPlane( w.data, plane, writer );
+
+            if( single )
             {
-                color = numParPlanes-1;
-                key = commRank - mainTeamSize*(numParPlanes-1);
-            } 
-            mpi::Comm subComm;
-            mpi::Split( comm, color, key, subComm );
-            Grid subGrid( subComm );
-            data.SetGrid( subGrid );
-            L.SetGrid( subGrid );
-            S.SetGrid( subGrid );
-
-            const int plane = numSeqPlanes + color;
-            std::ostringstream os, binOs;
-            os << dataBase << "-" << plane;
-            LoadData( nnu, nc, nt, os.str()+".bin", data );
-            if( display )
-                Display( data, os.str() );
-            if( write )
-                Write( data, os.str(), format );
+#ifdef RTLPSMRI_HAVE_FFTWF
+                SolvePlane<float>
+                ( *data, w.stateSingle, N0, N1, plane, ctrl, warmPlanes, 
+                  write, output, writer );
+#endif
+            }
+            else
+                SolvePlane<double>
+                ( *data, w.state, N0, N1, plane, ctrl, warmPlanes, 
+                  write, output, writer );
+        };
+
+        if( dynamic )
+        {
+#ifdef RTLPSMRI_HAVE_MPI3
+            mpi::Barrier( comm );
+            if( commRank == 0 )
+                std::cout << "Starting dynamically scheduled work..." 
+                          << std::endl;
+            const double dynamicStart = mpi::Time();
+            PlaneScheduler scheduler( comm, np, teamSize );
+
+            // The plane threads draw planes until the single-process planes
+            // are exhausted
+            bool exhausted = false;
+#ifdef RTLPSMRI_HAVE_OPENMP
+            #pragma omp parallel num_threads(planeThreads) if(planeThreads>1)
+#endif
+            {
+                PlaneWorker& w = *workers[PlaneThread()];
+                auto drawPlane = [&]()
+                {
+                    int plane = -1;
+#ifdef RTLPSMRI_HAVE_OPENMP
+                    #pragma omp critical(reconstruct_plane_scheduler)
+#endif
+                    if( !exhausted )
+                    {
+                        plane = scheduler.NextPlane();
+                        exhausted = ( plane == -1 );
+                    }
+                    return plane;
+                };
+                // When prefetching, the next plane is claimed as soon as the
+                // current one starts so that it can be read in the meantime
+                int plane = drawPlane();
+                while( plane != -1 )
+                {
+                    const int nextPlane = ( w.prefetcher ? drawPlane() : -1 );
+                    processPlane( w, plane, nextPlane );
+                    plane = ( w.prefetcher ? nextPlane : drawPlane() );
+                }
+            }
 
+            // Help with one of the tail planes
+            mpi::Comm teamComm;
+            const int teamPlane = scheduler.JoinTeam( teamComm );
+            if( teamPlane != -1 )
+            {
+                PlaneWorker& w = *workers[0];
+                {
+                    Grid teamGrid( teamComm );
+                    w.SetGrid( teamGrid );
+                    processPlane( w, teamPlane, -1 );
+
+                    // Release the team grid before it is destroyed
+                    w.SetGrid( w.selfGrid );
+                }
+                mpi::Free( teamComm );
+            }
             mpi::Barrier( comm );
-            const double lpsStart = mpi::Time();
-            LPS
-            ( data, L, S, tv, lambdaL, lambdaSRel, relTol, maxIts, tryTSQR, 
-              progress );
+            if( commRank == 0 )
+                std::cout << "Finished dynamically scheduled work: "
+                          << mpi::Time()-dynamicStart << " seconds" 
+                          << std::endl;
+#endif
+        }
+        else
+        {
+            // Exploit the available trivial plane parallelism
             mpi::Barrier( comm );
             if( commRank == 0 )
-                std::cout << "  Parallel LPS's took " << mpi::Time()-lpsStart 
-                          << " seconds" << std::endl;
-            if( write )
-                WriteLPS( L, S, N0, N1, plane, tv, format );
+                std::cout << "Starting trivially parallel work..." 
+                          << std::endl;
+            const double trivialStart = mpi::Time();
+            const int numSeqRounds = np / commSize;
+            // When warm-starting from neighbouring planes, each process is 
+            // given a contiguous block of planes
+            auto planeOfRound = [&]( int round )
+            {
+                return ( warmPlanes ? commRank*numSeqRounds + round 
+                                    : commRank + round*commSize );
+            };
+            // NOTE: Each plane thread is given a contiguous block of rounds,
+            //       as with a static schedule, which keeps its planes 
+            //       contiguous when warm-starting from neighbouring planes 
+            //       and tells it which plane to prefetch next
+#ifdef RTLPSMRI_HAVE_OPENMP
+            #pragma omp parallel num_threads(planeThreads) if(planeThreads>1)
+#endif
+            {
+                const int thread = PlaneThread();
+                const int numThreads = NumActivePlaneThreads();
+                const int roundBeg = (thread*numSeqRounds)/numThreads;
+                const int roundEnd = ((thread+1)*numSeqRounds)/numThreads;
+                PlaneWorker& w = *workers[thread];
+                for( int round=roundBeg; round<roundEnd; ++round )
+                {
+                    const int nextPlane = 
+                      ( round+1 < roundEnd ? planeOfRound(round+1) : -1 );
+                    processPlane( w, planeOfRound(round), nextPlane );
+                }
+            }
+            mpi::Barrier( comm );
+            if( commRank == 0 )
+                std::cout << "Finished trivially parallel section: " 
+                          << mpi::Time()-trivialStart << " seconds" 
+                          << std::endl;
+
+            // Process the remaining planes using subteams
+            mpi::Barrier( comm );
+            if( commRank == 0 )
+                std::cout << "Starting parallel work..." << std::endl;
+            const double parallelStart = mpi::Time(); 
+            const int numSeqPlanes = numSeqRounds*commSize; 
+            const int numParPlanes = np - numSeqPlanes;
+            if( batchRemainder && numParPlanes > 1 )
+            {
+                // Stack the remaining planes and solve them jointly over the
+                // full grid, rather than each over a fraction of it
+                PlaneWorker& w = *workers[0];
+                {
+                    Grid grid( comm );
+                    w.SetGrid( grid );
+                    const int planeWidth = nc*nt;
+                    DistMatrix<Complex<double>,STAR,VR> 
+                        planeData( grid ), block( grid );
+                    w.data.Resize( nnu, numParPlanes*planeWidth );
+                    for( int k=0; k<numParPlanes; ++k )
+                    {
+                        loadPlane( planeData, numSeqPlanes+k, 0 );
+                        El::View
+                        ( block, w.data, 0, k*planeWidth, nnu, planeWidth );
+                        block = planeData;
+                    }
+
+                    mpi::Barrier( comm );
+                    const double lpsStart = mpi::Time();
+                    if( single )
+                    {
+#ifdef RTLPSMRI_HAVE_FFTWF
+                        SolveStackedPlanes<float>
+                        ( w.data, w.stateSingle, N0, N1, numSeqPlanes, 
+                          numParPlanes, ctrl, write, output );
+#endif
+                    }
+                    else
+                        SolveStackedPlanes<double>
+                        ( w.data, w.state, N0, N1, numSeqPlanes, 
+                          numParPlanes, ctrl, write, output );
+                    mpi::Barrier( comm );
+                    if( commRank == 0 )
+                        std::cout << "  Joint LPS (and writes) took " 
+                                  << mpi::Time()-lpsStart << " seconds" 
+                                  << std::endl;
+
+                    // Release the grid before it is destroyed
+                    w.SetGrid( w.selfGrid );
+                }
+                w.lastPlane = -1;
+            }
+            else if( numParPlanes > 0 )
+            {
+                // Split the communicator
+                int color, key;
+                const int mainTeamSize = commSize / numParPlanes;
+                if( commRank < mainTeamSize*(numParPlanes-1) )
+                {
+                    color = commRank / mainTeamSize;
+                    key = commRank % mainTeamSize;
+                } 
+                else
+                {
+                    color = numParPlanes-1;
+                    key = commRank - mainTeamSize*(numParPlanes-1);
+                } 
+                mpi::Comm subComm;
+                mpi::Split( comm, color, key, subComm );
+                PlaneWorker& w = *workers[0];
+                {
+                    Grid subGrid( subComm );
+                    w.SetGrid( subGrid );
+
+                    mpi::Barrier( comm );
+                    const double lpsStart = mpi::Time();
+                    processPlane( w, numSeqPlanes + color, -1 );
+                    mpi::Barrier( comm );
+                    if( commRank == 0 )
+                        std::cout << "  Parallel LPS's (and writes) took " 
+                                  << mpi::Time()-lpsStart << " seconds" 
+                                  << std::endl;
+
+                    // Release the subgrid before it is destroyed
+                    w.SetGrid( w.selfGrid );
+                }
+                mpi::Free( subComm );
+            }
+            if( commRank == 0 )
+                std::cout << "Finished parallel section: " 
+                          << mpi::Time()-parallelStart << " seconds" 
+                          << std::endl;
         }
+
+        // Finish the background writes (and report any of their errors)
+        mpi::Barrier( comm );
+        const double flushStart = mpi::Time();
+        for( auto& worker : workers )
+            if( worker->writer )
+                worker->writer->Flush();
+        mpi::Barrier( comm );
         if( commRank == 0 )
-            std::cout << "Finished parallel section: " 
-                      << mpi::Time()-parallelStart << " seconds" << std::endl;
+            std::cout << "Finished background writes: " 
+                      << mpi::Time()-flushStart << " seconds" << std::endl;
+    }
+    catch( std::exception& e ) 
+    { 
+        ReportException(e); 
+        for( auto& worker : workers )
+        {
+            if( worker && worker->writer )
+            {
+                try { worker->writer->Flush(); }
+                catch( std::exception& flushError ) 
+                { ReportException(flushError); }
+            }
+        }
     }
-    catch( std::exception& e ) { ReportException(e); }
+    workers.clear();
 
     Finalize();
     return 0;
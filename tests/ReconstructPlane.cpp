@@ -21,6 +21,23 @@
 using namespace mri;
 using std::string;
 
+// The data is always loaded in double precision, and then converted to the
+// precision of the reconstruction
+template<typename Real>
+void
+SolvePlane
+( const DistMatrix<Complex<double>,STAR,VR>& data, 
+  int N0, int N1, int plane, const LPSCtrl& ctrl, 
+  bool write, const LPSOutputCtrl& output )
+{
+    DistMatrix<Complex<Real>,STAR,VR> D( data.Grid() );
+    Convert( data, D );
+    DistMatrix<Complex<Real>,VC,STAR> L( data.Grid() ), S( data.Grid() );
+    LPS( D, L, S, ctrl );
+    if( write )
+        WriteLPS( L, S, N0, N1, plane, ctrl.tv, output );
+}
+
 int 
 main( int argc, char* argv[] )
 {
@@ -38,6 +55,16 @@ main( int argc, char* argv[] )
         const int n0 = Input("--n0","FFT size in x direction",16);
         const int n1 = Input("--n1","FFT size in y direction",16);
         const int m = Input("--m","cutoff parameter",2);
+        const int nfftThreads = 
+            Input("--nfftThreads","threads for local NFFTs (0 for max)",1);
+        const int nfftTypeInt = 
+            Input
+            ("--nfftType","0: per-coil, 1: coil-batched, 2: native",0);
+        const int pipelineChunks = 
+            Input
+            ("--pipelineChunks","timestep chunks for overlapping comm.",1);
+        const bool toeplitz = 
+            Input("--toeplitz","apply E'E via Toeplitz embeddings?",false);
         const bool tv = Input("--tv","TV clipping for sparsity",true);
         const double lambdaL = Input("--lambdaL","low-rank scale",0.025);
         const double lambdaSRel = Input("--lambdaSRel","sparse rel scale",0.5);
@@ -45,6 +72,17 @@ main( int argc, char* argv[] )
         const int maxIts = Input("--maxIts","max L+S iterations",100);
         const bool tryTSQR = Input("--tryTSQR","try Tall-Skinny QR?",false);
         const bool progress = Input("--progress","print L+S progress",true);
+        const int solverInt = 
+            Input("--solver","0: proximal gradient, 1: accelerated",0);
+        const bool restart = 
+            Input("--restart","adaptive restart of accelerated solver",true);
+        const bool partialSVT = 
+            Input
+            ("--partialSVT","only compute leading singular triplets?",false);
+        const int svtOversample = 
+            Input("--svtOversample","oversampling for partial SVT",5);
+        const bool single = 
+            Input("--single","single-precision reconstruction?",false);
         const string sensName = 
             Input("--sens","sens. filename",string("sensitivity.bin"));
         const string densName = 
@@ -53,8 +91,17 @@ main( int argc, char* argv[] )
             Input("--path","paths filename",string("paths.bin"));
         const string dataName = 
             Input("--data","data filename",string("data.bin"));
+        const int sampleTypeInt = 
+            Input("--sampleType","data: 0: complex f64, 1: f32, 2: int16",0);
+        const double scale = Input("--scale","data scale factor",1.);
         const bool display = Input("--display","display matrices?",false);
         const bool write = Input("--write","write matrices?",true);
+        const int outputInt = 
+            Input("--output","0: frames, 1: container, 2: compressed",0);
+        const int valueTypeInt = 
+            Input("--valueType","compressed values: 0: f64, 1: f32, 2: f16",1);
+        const double dropTol = 
+            Input("--dropTol","relative drop tolerance for compressed S",1e-6);
 #ifdef HAVE_QT5
         const int formatInt = Input("--format","format to store matrices",5);
 #else
@@ -63,9 +110,48 @@ main( int argc, char* argv[] )
         ProcessInput();
         PrintInputReport();
 
+        if( nfftTypeInt < 0 || nfftTypeInt >= NFFTType_MAX )
+            LogicError("NFFT type integer must be in [0,",NFFTType_MAX,")");
+        SetNFFTType( static_cast<NFFTType>(nfftTypeInt) );
+        SetNumPipelineChunks( pipelineChunks );
+
+        if( solverInt < 0 || solverInt >= LPSSolver_MAX )
+            LogicError("Solver integer must be in [0,",LPSSolver_MAX,")");
+        LPSCtrl ctrl;
+        ctrl.tv = tv;
+        ctrl.lambdaL = lambdaL;
+        ctrl.lambdaSRelMaxM = lambdaSRel;
+        ctrl.relTol = relTol;
+        ctrl.maxIts = maxIts;
+        ctrl.tryTSQR = tryTSQR;
+        ctrl.progress = progress;
+        ctrl.solver = static_cast<LPSSolver>(solverInt);
+        ctrl.adaptiveRestart = restart;
+        ctrl.partialSVT = partialSVT;
+        ctrl.svtOversample = svtOversample;
+
         if( formatInt < 1 || formatInt >= FileFormat_MAX )
             LogicError("Format integer must be in [1,",FileFormat_MAX,")");
         const auto format = static_cast<El::FileFormat>(formatInt);
+        if( outputInt < 0 || outputInt >= LPSOutputMode_MAX )
+            LogicError("Output integer must be in [0,",LPSOutputMode_MAX,")");
+        if( valueTypeInt < 0 || valueTypeInt >= LPSValueType_MAX )
+            LogicError
+            ("Value type integer must be in [0,",LPSValueType_MAX,")");
+        if( sampleTypeInt < 0 || sampleTypeInt >= KSpaceSampleType_MAX )
+            LogicError
+            ("Sample type integer must be in [0,",KSpaceSampleType_MAX,")");
+        const auto sampleType = static_cast<KSpaceSampleType>(sampleTypeInt);
+        LPSOutputCtrl output;
+        output.mode = static_cast<LPSOutputMode>(outputInt);
+        output.format = format;
+        output.valueType = static_cast<LPSValueType>(valueTypeInt);
+        output.dropTol = dropTol;
+
+#ifndef RTLPSMRI_HAVE_FFTWF
+        if( single )
+            LogicError("Single precision requires FFTW3's float interface");
+#endif
 
         mpi::Barrier( comm );
         const double loadStart = mpi::Time();
@@ -85,7 +171,7 @@ main( int argc, char* argv[] )
         LoadPaths( nnu, nt, pathsName, paths );
 
         DistMatrix<Complex<double>,STAR,VR> data;
-        LoadData( nnu, nc, nt, dataName, data );
+        LoadData( nnu, nc, nt, dataName, data, sampleType, scale );
 
         mpi::Barrier( comm );
         if( commRank == 0 )
@@ -116,7 +202,8 @@ main( int argc, char* argv[] )
             std::cout.flush();
         }
         InitializeAcquisition
-        ( densityComp, sensitivity, paths, nc, N0, N1, n0, n1, m );
+        ( densityComp, sensitivity, paths, nc, N0, N1, n0, n1, m, 
+          nfftThreads, toeplitz );
         mpi::Barrier( comm );
         if( commRank == 0 )
             std::cout << "DONE. " << mpi::Time()-startInit << " seconds"
@@ -126,20 +213,23 @@ main( int argc, char* argv[] )
         const double startLPS = mpi::Time();
         if( commRank == 0 )
         {
-            std::cout << "Starting L+S decomposition...";
+            std::cout << "Starting L+S decomposition (and writes)...";
             std::cout.flush();
         }
-        DistMatrix<Complex<double>,VC,STAR> L, S;
-        LPS
-        ( data, L, S, tv, lambdaL, lambdaSRel, relTol, maxIts, 
-          tryTSQR, progress );
+        if( single )
+        {
+#ifdef RTLPSMRI_HAVE_FFTWF
+            SolvePlane<float>
+            ( data, N0, N1, 0, ctrl, write, output );
+#endif
+        }
+        else
+            SolvePlane<double>
+            ( data, N0, N1, 0, ctrl, write, output );
         mpi::Barrier( comm );
         if( commRank == 0 )
             std::cout << "DONE. " << mpi::Time()-startLPS << " seconds"
                       << std::endl;
-
-        if( write )
-            WriteLPS( L, S, N0, N1, 0, tv, format );
     }
     catch( std::exception& e ) { ReportException(e); }
 
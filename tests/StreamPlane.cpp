@@ -0,0 +1,258 @@
+/*
+   Copyright (c) 2013-2014, Jack Poulson, Ricardo Otazo, and Emmanuel Candes
+   All rights reserved.
+ 
+   This file is part of Real-Time Low-rank Plus Sparse MRI (RT-LPS-MRI).
+
+   RT-LPS-MRI is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   RT-LPS-MRI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with RT-LPS-MRI.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "rt-lps-mri.hpp"
+using namespace mri;
+using std::string;
+
+// Simulate the real-time arrival of the frames of a single plane: the first
+// 'window' frames are reconstructed as usual, and then each of the remaining
+// frames is appended to a sliding window (dropping the oldest frame) and 
+// followed by a few warm-started L+S iterations
+template<typename Real>
+void
+StreamPlane
+( const DistMatrix<Complex<double>,STAR,VR>& data, 
+  const DistMatrix<double,STAR,STAR>& paths,
+  const DistMatrix<double,STAR,STAR>& densityComp,
+  int numFrames, int window, int frameIts, int N0, int N1, 
+  const LPSCtrl& ctrl, bool write, const LPSOutputCtrl& output )
+{
+    const int numCoils = NumCoils();
+    const int numNonUniform = NumNonUniformPoints();
+    const bool amRoot = data.Grid().Rank() == 0;
+
+    DistMatrix<Complex<double>,STAR,VR> window0(data.Grid());
+    LockedView( window0, data, 0, 0, numNonUniform, numCoils*window );
+    DistMatrix<Complex<Real>,STAR,VR> D(data.Grid());
+    Convert( window0, D );
+
+    StreamingLPS<Real> stream( data.Grid() );
+    const double initStart = mpi::Time();
+    const int initIts = stream.Initialize( D, ctrl );
+    if( amRoot )
+        std::cout << "Initial window: " << initIts << " iterations in "
+                  << mpi::Time()-initStart << " seconds" << std::endl;
+
+    DistMatrix<Complex<double>,STAR,VR> frameView(data.Grid());
+    DistMatrix<Complex<Real>,STAR,VR> frame(data.Grid());
+    DistMatrix<double,STAR,STAR> path(paths.Grid()), dens(paths.Grid());
+    double maxLatency = 0;
+    for( int t=window; t<numFrames; ++t )
+    {
+        LockedView( frameView, data, 0, t*numCoils, numNonUniform, numCoils );
+        Convert( frameView, frame );
+        LockedView( path, paths, 0, t, 2*numNonUniform, 1 );
+        LockedView( dens, densityComp, 0, t, numNonUniform, 1 );
+
+        mpi::Barrier( data.Grid().Comm() );
+        const double frameStart = mpi::Time();
+        const int numIts = stream.AddFrame( frame, path, dens, frameIts );
+        mpi::Barrier( data.Grid().Comm() );
+        const double latency = mpi::Time()-frameStart;
+        maxLatency = std::max( maxLatency, latency );
+        if( amRoot )
+            std::cout << "Frame " << t << ": " << numIts << " iterations in "
+                      << latency << " seconds" << std::endl;
+    }
+    if( amRoot )
+        std::cout << "Maximum per-frame latency: " << maxLatency 
+                  << " seconds" << std::endl;
+
+    if( write )
+        WriteLPS( stream.L(), stream.S(), N0, N1, 0, ctrl.tv, output );
+}
+
+int 
+main( int argc, char* argv[] )
+{
+    Initialize( argc, argv );
+    mpi::Comm comm = mpi::COMM_WORLD;
+    const int commRank = mpi::Rank( comm );
+
+    try
+    {
+        const int nc = Input("--nc","number of coils",16);
+        const int nt = Input("--nt","number of timesteps",10);
+        const int window = Input("--window","timesteps in sliding window",5);
+        const int frameIts = Input("--frameIts","L+S iterations per frame",3);
+        const int N0 = Input("--N0","bandwidth in x direction",6);
+        const int N1 = Input("--N1","bandwidth in y direction",6);
+        const int nnu  = Input("--nnu","number of non-uniform nodes",36);
+        const int n0 = Input("--n0","FFT size in x direction",16);
+        const int n1 = Input("--n1","FFT size in y direction",16);
+        const int m = Input("--m","cutoff parameter",2);
+        const int nfftThreads = 
+            Input("--nfftThreads","threads for local NFFTs (0 for max)",1);
+        const int nfftTypeInt = 
+            Input
+            ("--nfftType","0: per-coil, 1: coil-batched, 2: native",0);
+        const bool toeplitz = 
+            Input("--toeplitz","apply E'E via Toeplitz embeddings?",false);
+        const bool tv = Input("--tv","TV clipping for sparsity",true);
+        const double lambdaL = Input("--lambdaL","low-rank scale",0.025);
+        const double lambdaSRel = Input("--lambdaSRel","sparse rel scale",0.5);
+        const double relTol = Input("--relTol","relative L+S tolerance",0.0025);
+        const int maxIts = Input("--maxIts","max L+S iterations",100);
+        const bool tryTSQR = Input("--tryTSQR","try Tall-Skinny QR?",false);
+        const bool progress = Input("--progress","print L+S progress",false);
+        const int solverInt = 
+            Input("--solver","0: proximal gradient, 1: accelerated",0);
+        const bool restart = 
+            Input("--restart","adaptive restart of accelerated solver",true);
+        const bool partialSVT = 
+            Input
+            ("--partialSVT","only compute leading singular triplets?",false);
+        const int svtOversample = 
+            Input("--svtOversample","oversampling for partial SVT",5);
+        const bool single = 
+            Input("--single","single-precision reconstruction?",false);
+        const string sensName = 
+            Input("--sens","sens. filename",string("sensitivity.bin"));
+        const string densName = 
+            Input("--dens","density filename",string("density.bin"));
+        const string pathsName = 
+            Input("--path","paths filename",string("paths.bin"));
+        const string dataName = 
+            Input("--data","data filename",string("data.bin"));
+        const int sampleTypeInt = 
+            Input("--sampleType","data: 0: complex f64, 1: f32, 2: int16",0);
+        const double scale = Input("--scale","data scale factor",1.);
+        const bool write = Input("--write","write matrices?",true);
+        const int outputInt = 
+            Input("--output","0: frames, 1: container, 2: compressed",0);
+        const int valueTypeInt = 
+            Input("--valueType","compressed values: 0: f64, 1: f32, 2: f16",1);
+        const double dropTol = 
+            Input("--dropTol","relative drop tolerance for compressed S",1e-6);
+#ifdef HAVE_QT5
+        const int formatInt = Input("--format","format to store matrices",5);
+#else
+        const int formatInt = Input("--format","format to store matrices",1);
+#endif
+        ProcessInput();
+        PrintInputReport();
+
+        if( window < 2 || window > nt )
+            LogicError("The window must contain between 2 and nt timesteps");
+
+        if( nfftTypeInt < 0 || nfftTypeInt >= NFFTType_MAX )
+            LogicError("NFFT type integer must be in [0,",NFFTType_MAX,")");
+        SetNFFTType( static_cast<NFFTType>(nfftTypeInt) );
+
+        if( solverInt < 0 || solverInt >= LPSSolver_MAX )
+            LogicError("Solver integer must be in [0,",LPSSolver_MAX,")");
+        LPSCtrl ctrl;
+        ctrl.tv = tv;
+        ctrl.lambdaL = lambdaL;
+        ctrl.lambdaSRelMaxM = lambdaSRel;
+        ctrl.relTol = relTol;
+        ctrl.maxIts = maxIts;
+        ctrl.tryTSQR = tryTSQR;
+        ctrl.progress = progress;
+        ctrl.solver = static_cast<LPSSolver>(solverInt);
+        ctrl.adaptiveRestart = restart;
+        ctrl.partialSVT = partialSVT;
+        ctrl.svtOversample = svtOversample;
+
+        if( formatInt < 1 || formatInt >= FileFormat_MAX )
+            LogicError("Format integer must be in [1,",FileFormat_MAX,")");
+        const auto format = static_cast<El::FileFormat>(formatInt);
+        if( outputInt < 0 || outputInt >= LPSOutputMode_MAX )
+            LogicError("Output integer must be in [0,",LPSOutputMode_MAX,")");
+        if( valueTypeInt < 0 || valueTypeInt >= LPSValueType_MAX )
+            LogicError
+            ("Value type integer must be in [0,",LPSValueType_MAX,")");
+        if( sampleTypeInt < 0 || sampleTypeInt >= KSpaceSampleType_MAX )
+            LogicError
+            ("Sample type integer must be in [0,",KSpaceSampleType_MAX,")");
+        const auto sampleType = static_cast<KSpaceSampleType>(sampleTypeInt);
+        LPSOutputCtrl output;
+        output.mode = static_cast<LPSOutputMode>(outputInt);
+        output.format = format;
+        output.valueType = static_cast<LPSValueType>(valueTypeInt);
+        output.dropTol = dropTol;
+
+#ifndef RTLPSMRI_HAVE_FFTWF
+        if( single )
+            LogicError("Single precision requires FFTW3's float interface");
+#endif
+
+        mpi::Barrier( comm );
+        const double loadStart = mpi::Time();
+        if( commRank == 0 )
+        {
+            std::cout << "Loading files...";
+            std::cout.flush();
+        }
+
+        DistMatrix<double,STAR,STAR> densityComp;
+        LoadDensity( nnu, nt, densName, densityComp );
+
+        DistMatrix<Complex<double>,STAR,STAR> sensitivity;
+        LoadSensitivity( N0, N1, nc, sensName, sensitivity );
+
+        DistMatrix<double,STAR,STAR> paths;
+        LoadPaths( nnu, nt, pathsName, paths );
+
+        DistMatrix<Complex<double>,STAR,VR> data;
+        LoadData( nnu, nc, nt, dataName, data, sampleType, scale );
+
+        mpi::Barrier( comm );
+        if( commRank == 0 )
+            std::cout << "DONE. " << mpi::Time()-loadStart << " seconds" 
+                      << std::endl;
+
+        // Initialize the acquisition operator with the first window
+        mpi::Barrier( comm );
+        const double startInit = mpi::Time();
+        if( commRank == 0 )
+        {
+            std::cout << "Initializing acquisition operator...";
+            std::cout.flush();
+        }
+        DistMatrix<double,STAR,STAR> densityWindow, pathsWindow;
+        LockedView( densityWindow, densityComp, 0, 0, nnu, window );
+        LockedView( pathsWindow, paths, 0, 0, 2*nnu, window );
+        InitializeAcquisition
+        ( densityWindow, sensitivity, pathsWindow, nc, N0, N1, n0, n1, m, 
+          nfftThreads, toeplitz );
+        mpi::Barrier( comm );
+        if( commRank == 0 )
+            std::cout << "DONE. " << mpi::Time()-startInit << " seconds"
+                      << std::endl;
+
+        if( single )
+        {
+#ifdef RTLPSMRI_HAVE_FFTWF
+            StreamPlane<float>
+            ( data, paths, densityComp, nt, window, frameIts, N0, N1, ctrl, 
+              write, output );
+#endif
+        }
+        else
+            StreamPlane<double>
+            ( data, paths, densityComp, nt, window, frameIts, N0, N1, ctrl, 
+              write, output );
+    }
+    catch( std::exception& e ) { ReportException(e); }
+
+    Finalize();
+    return 0;
+}
@@ -38,6 +38,8 @@ main( int argc, char* argv[] )
         const int n0 = Input("--n0","FFT size in x direction",16);
         const int n1 = Input("--n1","FFT size in y direction",16);
         const int m = Input("--m","cutoff parameter",2);
+        const int nfftThreads = 
+            Input("--nfftThreads","threads for local FFTs (0 for max)",1);
         const bool print = Input("--print","print matrices?",false);
         const bool display = Input("--display","display matrices?",false);
         ProcessInput();
@@ -46,7 +48,7 @@ main( int argc, char* argv[] )
         // Initialize the coil plans
         DistMatrix<double,STAR,STAR> paths;
         Uniform( paths, 2*nnu, nt, 0., 0.5 );
-        InitializeCoilPlans( paths, nc, N0, N1, n0, n1, m );
+        InitializeCoilPlans( paths, nc, N0, N1, n0, n1, m, nfftThreads );
 
         // Generate a random matrix to apply the temporal FFT's to
         DistMatrix<F,VC,STAR> A;
@@ -59,7 +61,10 @@ main( int argc, char* argv[] )
             Display( A, "A" );
 
         // Apply the forward FFT
+        El::Timer timer("");
+        timer.Start();
         TemporalFFT( A );
+        const double forwardTime = timer.Stop();
         const Real frobFA = FrobeniusNorm( A );
         if( print )
             Print( A, "F(A)" );
@@ -67,7 +72,9 @@ main( int argc, char* argv[] )
             Display( A, "F(A)" );
 
         // Apply the backward FFT
+        timer.Start();
         TemporalAdjointFFT( A );
+        const double adjointTime = timer.Stop();
         const Real frobFAdjFA = FrobeniusNorm( A );
         if( print )
             Print( A, "F'(F(A))" );
@@ -84,7 +91,10 @@ main( int argc, char* argv[] )
                       << "|| F'(F(A)) ||_F = " << frobFAdjFA << "\n"
                       << "|| F'(F(A))-A ||_F = " << frobE << "\n"
                       << "|| F'(F(A))-A ||_F / || A ||_F = " << frobE/frobA 
-                      << "\n" << std::endl;
+                      << "\n"
+                      << "forward time: " << forwardTime << " seconds\n"
+                      << "adjoint time: " << adjointTime << " seconds\n"
+                      << std::endl;
         }
     }
     catch( std::exception& e ) { ReportException(e); }